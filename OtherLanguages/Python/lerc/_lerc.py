@@ -185,6 +185,26 @@ def getLercShape(npArr, nValuesPerPixel):
 
     return (nBands, nRows, nCols)
 
+# numpy shape of a decoded Lerc blob, the inverse of getLercShape()
+
+def getNpShape(nBands, nRows, nCols, nValuesPerPixel):
+    if nBands == 1:
+        if nValuesPerPixel == 1:
+            return (nRows, nCols)
+        else:
+            return (nRows, nCols, nValuesPerPixel)
+    else:
+        if nValuesPerPixel == 1:
+            return (nBands, nRows, nCols)
+        else:
+            return (nBands, nRows, nCols, nValuesPerPixel)
+
+# view any C contiguous buffer (bytes, bytearray, memoryview, numpy array, ...) as a 1D byte array, without a copy;
+# pass npBytes.ctypes.data to the Lerc dll, and keep npBytes alive while doing so
+
+def _asBytes(buf):
+    return np.frombuffer(buf, 'B')
+
 #-------------------------------------------------------------------------------
 
 # Lerc version 3.0
@@ -276,40 +296,47 @@ def findDataRange_ma(npmaArr):
 
 lercDll.lerc_computeCompressedSize.restype = ct.c_uint
 lercDll.lerc_computeCompressedSize.argtypes = (ct.c_void_p, ct.c_uint, ct.c_int, ct.c_int, ct.c_int,
-                                               ct.c_int, ct.c_int, ct.c_char_p, ct.c_double, ct.POINTER(ct.c_uint))
+                                               ct.c_int, ct.c_int, ct.c_void_p, ct.c_double, ct.POINTER(ct.c_uint))
 
 lercDll.lerc_encode.restype = ct.c_uint
 lercDll.lerc_encode.argtypes = (ct.c_void_p, ct.c_uint, ct.c_int, ct.c_int, ct.c_int, ct.c_int, ct.c_int,
-                                ct.c_char_p, ct.c_double, ct.c_char_p, ct.c_uint, ct.POINTER(ct.c_uint))
+                                ct.c_void_p, ct.c_double, ct.c_char_p, ct.c_uint, ct.POINTER(ct.c_uint))
 
 lercDll.lerc_getBlobInfo.restype = ct.c_uint
-lercDll.lerc_getBlobInfo.argtypes = (ct.c_char_p, ct.c_uint, ct.POINTER(ct.c_uint),
+lercDll.lerc_getBlobInfo.argtypes = (ct.c_void_p, ct.c_uint, ct.POINTER(ct.c_uint),
                                      ct.POINTER(ct.c_double), ct.c_int, ct.c_int)
 
 lercDll.lerc_getDataRanges.restype = ct.c_uint
-lercDll.lerc_getDataRanges.argtypes = (ct.c_char_p, ct.c_uint, ct.c_int, ct.c_int,
+lercDll.lerc_getDataRanges.argtypes = (ct.c_void_p, ct.c_uint, ct.c_int, ct.c_int,
                                        ct.POINTER(ct.c_double), ct.POINTER(ct.c_double))
 
 lercDll.lerc_decode.restype = ct.c_uint
-lercDll.lerc_decode.argtypes = (ct.c_char_p, ct.c_uint, ct.c_int, ct.c_char_p, ct.c_int,
+lercDll.lerc_decode.argtypes = (ct.c_void_p, ct.c_uint, ct.c_int, ct.c_void_p, ct.c_int,
                                 ct.c_int, ct.c_int, ct.c_int, ct.c_uint, ct.c_void_p)
 
 # the new _4D functions
 
 lercDll.lerc_computeCompressedSize_4D.restype = ct.c_uint
 lercDll.lerc_computeCompressedSize_4D.argtypes = (ct.c_void_p, ct.c_uint, ct.c_int, ct.c_int, ct.c_int,
-                                                  ct.c_int, ct.c_int, ct.c_char_p, ct.c_double,
-                                                  ct.POINTER(ct.c_uint), ct.c_char_p, ct.POINTER(ct.c_double))
+                                                  ct.c_int, ct.c_int, ct.c_void_p, ct.c_double,
+                                                  ct.POINTER(ct.c_uint), ct.c_void_p, ct.POINTER(ct.c_double))
 
 lercDll.lerc_encode_4D.restype = ct.c_uint
 lercDll.lerc_encode_4D.argtypes = (ct.c_void_p, ct.c_uint, ct.c_int, ct.c_int, ct.c_int, ct.c_int,
-                                   ct.c_int, ct.c_char_p, ct.c_double, ct.c_char_p, ct.c_uint,
-                                   ct.POINTER(ct.c_uint), ct.c_char_p, ct.POINTER(ct.c_double))
+                                   ct.c_int, ct.c_void_p, ct.c_double, ct.c_char_p, ct.c_uint,
+                                   ct.POINTER(ct.c_uint), ct.c_void_p, ct.POINTER(ct.c_double))
 
 lercDll.lerc_decode_4D.restype = ct.c_uint
-lercDll.lerc_decode_4D.argtypes = (ct.c_char_p, ct.c_uint, ct.c_int, ct.c_char_p, ct.c_int,
+lercDll.lerc_decode_4D.argtypes = (ct.c_void_p, ct.c_uint, ct.c_int, ct.c_void_p, ct.c_int,
                                    ct.c_int, ct.c_int, ct.c_int, ct.c_uint,
-                                   ct.c_void_p, ct.c_char_p, ct.POINTER(ct.c_double))
+                                   ct.c_void_p, ct.c_void_p, ct.POINTER(ct.c_double))
+
+# many tiles in one call, the pointer array args are passed as c_void_p
+
+lercDll.lerc_decodeBatch.restype = ct.c_uint
+lercDll.lerc_decodeBatch.argtypes = (ct.c_int, ct.c_void_p, ct.c_void_p, ct.c_int, ct.c_void_p,
+                                     ct.c_int, ct.c_int, ct.c_int, ct.c_int, ct.c_uint,
+                                     ct.c_void_p, ct.c_void_p, ct.c_void_p, ct.c_void_p, ct.c_int)
 
 #-------------------------------------------------------------------------------
 
@@ -374,11 +401,8 @@ def _encode_Ext(npArr, nValuesPerPixel, npValidMask, maxZErr, nBytesHint, npmaNo
                 noDataArr[m] = npmaNoData[m]
                 npHasNoData[m] = 1
 
-        hasNoData = npHasNoData.tobytes('C')
-        cpHasNoData = ct.cast(hasNoData, ct.c_char_p)
-
-        tempArr = noDataArr.tobytes('C')
-        cpNoData = ct.cast(tempArr, ct.POINTER(ct.c_double))
+        cpHasNoData = npHasNoData.ctypes.data
+        cpNoData = noDataArr.ctypes.data_as(ct.POINTER(ct.c_double))
 
     else:
         cpHasNoData = None
@@ -394,13 +418,16 @@ def _encode_Ext(npArr, nValuesPerPixel, npValidMask, maxZErr, nBytesHint, npmaNo
         if cpHasNoData:
             print('has noData value')
     
-    byteArr = npArr.tobytes('C')  # C order
-    cpData = ct.cast(byteArr, ct.c_void_p)
+    npData = np.ascontiguousarray(npArr)  # C order, no copy if it is already
+    cpData = npData.ctypes.data
 
     if npValidMask is not None:
-        npValidBytes = npValidMask.astype('B')
-        validArr = npValidBytes.tobytes('C')
-        cpValidArr = ct.cast(validArr, ct.c_char_p)
+        npValidBytes = np.ascontiguousarray(npValidMask)
+        if npValidBytes.dtype == np.bool_ or npValidBytes.dtype == np.uint8:
+            npValidBytes = npValidBytes.view('B')  # no copy
+        else:
+            npValidBytes = npValidBytes.astype('B')
+        cpValidArr = npValidBytes.ctypes.data
     else:
         cpValidArr = None
 
@@ -538,12 +565,13 @@ def _getLercBlobInfo_Ext(lercBlob, nSupportNoData, printInfo):
     
     dataRange = ['zMin', 'zMax', 'maxZErrorUsed']
 
-    nBytes = len(lercBlob)
+    npBytes = _asBytes(lercBlob)
+    nBytes = npBytes.size
     len0 = len(info)
     len1 = len(dataRange)
     p0 = ct.cast((ct.c_uint * len0)(), ct.POINTER(ct.c_uint))
     p1 = ct.cast((ct.c_double * len1)(), ct.POINTER(ct.c_double))
-    cpBytes = ct.cast(lercBlob, ct.c_char_p)
+    cpBytes = npBytes.ctypes.data
     
     result = lercDll.lerc_getBlobInfo(cpBytes, nBytes, p0, p1, len0, len1)
     if result > 0:
@@ -586,10 +614,11 @@ def _getLercBlobInfo_Ext(lercBlob, nSupportNoData, printInfo):
 def getLercDataRanges(lercBlob, nDepth, nBands, printInfo = False):
     global lercDll
 
-    nBytes = len(lercBlob)
+    npBytes = _asBytes(lercBlob)
+    nBytes = npBytes.size
     len0 = nDepth * nBands;
 
-    cpBytes = ct.cast(lercBlob, ct.c_char_p)
+    cpBytes = npBytes.ctypes.data
 
     mins = ct.create_string_buffer(len0 * 8)
     maxs = ct.create_string_buffer(len0 * 8)
@@ -622,13 +651,22 @@ def getLercDataRanges(lercBlob, nDepth, nBands, printInfo = False):
 
 #-------------------------------------------------------------------------------
 
-def decode(lercBlob, printInfo = False):
-    return _decode_Ext(lercBlob, 0, printInfo)
+# lercBlob can be bytes or any other C contiguous buffer such as bytearray, memoryview, or a numpy byte array.
+#
+# out can be None, or a preallocated C contiguous and writeable numpy array of the blob's data type and size
+# to decode into, e.g., one slice of a larger array that holds many tiles. Then the npArr returned is out.
+# Invalid pixels are 0 in a new npArr. In out, Lerc1 blobs leave them as they were.
+#
+# The Lerc dll is called through ctypes.CDLL which releases the GIL during each call, so Python threads
+# can decode in parallel.
+
+def decode(lercBlob, printInfo = False, out = None):
+    return _decode_Ext(lercBlob, 0, printInfo, out)
 
-def decode_4D(lercBlob, printInfo = False):
-    return _decode_Ext(lercBlob, 1, printInfo)
+def decode_4D(lercBlob, printInfo = False, out = None):
+    return _decode_Ext(lercBlob, 1, printInfo, out)
 
-def _decode_Ext(lercBlob, nSupportNoData, printInfo):
+def _decode_Ext(lercBlob, nSupportNoData, printInfo, out = None):
     global lercDll
 
     fctErr = 'Error in _decode_Ext(): '
@@ -649,44 +687,42 @@ def _decode_Ext(lercBlob, nSupportNoData, printInfo):
     npDtype = npDtArr[dataType]
 
     # convert Lerc shape to np shape
-    if nBands == 1:
-        if nValuesPerPixel == 1:
-            shape = (nRows, nCols)
-        elif nValuesPerPixel > 1:
-            shape = (nRows, nCols, nValuesPerPixel)
-    elif nBands > 1:
-        if nValuesPerPixel == 1:
-            shape = (nBands, nRows, nCols)
-        elif nValuesPerPixel > 1:
-            shape = (nBands, nRows, nCols, nValuesPerPixel)
-
-    # create empty buffer for decoded data
-    dataSize = [1, 1, 2, 2, 4, 4, 4, 8]
-    nBytes = nBands * nRows * nCols * nValuesPerPixel * dataSize[dataType]
-    dataBuf = ct.create_string_buffer(nBytes)
-    cpData = ct.cast(dataBuf, ct.c_void_p)
-    cpBytes = ct.cast(lercBlob, ct.c_char_p)
-
-    # create empty buffer for valid pixels masks, if needed
+    shape = getNpShape(nBands, nRows, nCols, nValuesPerPixel)
+
+    # decode into out, or into a new array; Lerc1 decode writes the valid pixels only, so start from 0
+    if out is not None:
+        if (not isinstance(out, np.ndarray) or out.dtype != np.dtype(npDtype) or out.size != np.prod(shape)
+            or not out.flags.c_contiguous or not out.flags.writeable):
+            print(fctErr, 'out must be a C contiguous, writeable numpy array of data type', npDtype, 'and size', np.prod(shape))
+            return 2    # 2 == LercNS::ErrCode::WrongParam
+        npArr = out
+    else:
+        npArr = np.zeros(shape, npDtype)
+
+    cpData = npArr.ctypes.data
+    npBytes = _asBytes(lercBlob)
+    cpBytes = npBytes.ctypes.data
+
+    # create array for valid pixels masks, if needed
     cpValidArr = None
     if nMasks > 0:
-        validBuf = ct.create_string_buffer(nMasks * nRows * nCols)
-        cpValidArr = ct.cast(validBuf, ct.c_char_p)
+        npValidBytes = np.empty((nMasks, nRows, nCols) if nMasks > 1 else (nRows, nCols), 'B')
+        cpValidArr = npValidBytes.ctypes.data
 
-    # create empty buffer for noData arrays, if needed
+    # create arrays for noData values, if needed
     cpHasNoDataArr = None
     cpNoDataArr = None
     if (nUsesNoData):
-        hasNoDataBuf = ct.create_string_buffer(nBands)
-        noDataBuf = ct.create_string_buffer(nBands * 8)
-        cpHasNoDataArr = ct.cast(hasNoDataBuf, ct.c_char_p)
-        cpNoDataArr = ct.cast(noDataBuf, ct.POINTER(ct.c_double))
+        npHasNoData = np.zeros(nBands, 'B')
+        npNoData = np.zeros(nBands, 'd')
+        cpHasNoDataArr = npHasNoData.ctypes.data
+        cpNoDataArr = npNoData.ctypes.data_as(ct.POINTER(ct.c_double))
 
     # call decode
     if printInfo:
         start = timer()
 
-    result = lercDll.lerc_decode_4D(cpBytes, len(lercBlob), nMasks, cpValidArr, nValuesPerPixel,
+    result = lercDll.lerc_decode_4D(cpBytes, npBytes.size, nMasks, cpValidArr, nValuesPerPixel,
                                     nCols, nRows, nBands, dataType, cpData, cpHasNoDataArr, cpNoDataArr)
 
     if result > 0:
@@ -698,25 +734,13 @@ def _decode_Ext(lercBlob, nSupportNoData, printInfo):
         print('time lerc_decode() = ', (end - start))
 
     # return result, np data array, and np valid pixels array if there
-    npArr = np.frombuffer(dataBuf, npDtype)
-    npArr.shape = shape
-
     npValidMask = None
     if nMasks > 0:
-        npValidBytes = np.frombuffer(validBuf, dtype='B')
-        if nMasks == 1:
-            npValidBytes.shape = (nRows, nCols)
-        else:
-            npValidBytes.shape = (nMasks, nRows, nCols)
-        npValidMask = (npValidBytes != 0)
+        npValidMask = npValidBytes.view(np.bool_)    # decode writes 0 or 1, no copy
 
     npmaNoData = None
     if (nUsesNoData):
-        npHasNoData = np.frombuffer(hasNoDataBuf, dtype='B')
-        npHasNoData.shape = (nBands)
         npHasNoDataMask = (npHasNoData == 0)
-        npNoData = np.frombuffer(noDataBuf, 'd')
-        npNoData.shape = (nBands)
         npmaNoData = np.ma.array(npNoData, mask = npHasNoDataMask)
 
     if not nSupportNoData:    # old version, up to Lerc version 3.0
@@ -726,9 +750,90 @@ def _decode_Ext(lercBlob, nSupportNoData, printInfo):
 
 #-------------------------------------------------------------------------------
 
+# Decode many Lerc blobs of the same data type and shape in one call, such as the chunks of a dataset,
+# into one stacked array of shape (nBlobs, ) + shape of one decoded blob.
+#
+# Only the first blob header is read in Python. All blobs are decoded by lerc_decodeBatch() on up to
+# threads threads (0 - as many as there are cores), with the GIL released. lerc_decodeBatch() checks the
+# header of each blob against the first one: a blob of another data type, nValuesPerPixel, nCols, nRows,
+# or nBands fails with Failed == 1 and is not decoded. The number of masks may differ, as all bands get a mask.
+#
+# out can be None, or a preallocated C contiguous and writeable numpy array of the blobs' data type
+# and of nBlobs times the size of one blob, to decode into.
+#
+# Returns (result, npArr, npValidMask, npStatus), or only result if the call fails before decoding.
+# npValidMask is of type bool and shape (nBlobs, nRows, nCols) if nBands == 1, else (nBlobs, nBands, nRows, nCols).
+# npStatus holds the error code per blob, 0 for success. Blobs that use a noData value fail with
+# HasNoData == 5, same as decode(); decode them using decode_4D(). result is 0 if all blobs are ok, else
+# the error code of the first blob that failed. The data and mask of a blob that failed are all 0 / False.
+# Invalid pixels are 0, except in out for Lerc1 blobs, same as for decode().
+
+def decode_many(lercBlobs, out = None, threads = 0, printInfo = False):
+    global lercDll
+
+    fctErr = 'Error in decode_many(): '
+
+    nBlobs = len(lercBlobs)
+    if nBlobs == 0 or threads < 0:
+        print(fctErr, 'need at least 1 Lerc blob, and threads >= 0.')
+        return 2    # 2 == LercNS::ErrCode::WrongParam
+
+    (result, version, dataType, nValuesPerPixel, nCols, nRows, nBands, nValidPixels, blobSize,
+     nMasks, zMin, zMax, maxZErrUsed, nUsesNoData) = getLercBlobInfo_4D(lercBlobs[0], printInfo)
+    if result > 0:
+        print(fctErr, 'getLercBlobInfo() failed with error code = ', result)
+        return result
+
+    npDtArr = ['b', 'B', 'h', 'H', 'i', 'I', 'f', 'd']
+    npDtype = npDtArr[dataType]
+    shape = (nBlobs,) + getNpShape(nBands, nRows, nCols, nValuesPerPixel)
+
+    if out is not None:
+        if (not isinstance(out, np.ndarray) or out.dtype != np.dtype(npDtype) or out.size != np.prod(shape)
+            or not out.flags.c_contiguous or not out.flags.writeable):
+            print(fctErr, 'out must be a C contiguous, writeable numpy array of data type', npDtype, 'and size', np.prod(shape))
+            return 2    # 2 == LercNS::ErrCode::WrongParam
+        npArr = out
+    else:
+        npArr = np.zeros(shape, npDtype)
+
+    # masks for all bands, as the blobs may differ in their number of masks
+    maskShape = (nBlobs, nRows, nCols) if nBands == 1 else (nBlobs, nBands, nRows, nCols)
+    npValidBytes = np.zeros(maskShape, 'B')
+
+    # pointer arrays, keep the byte views alive until decode returns
+    npBlobs = [_asBytes(blob) for blob in lercBlobs]
+    npBlobPtrs = np.array([b.ctypes.data for b in npBlobs], np.uintp)
+    npBlobSizes = np.array([b.size for b in npBlobs], np.uint32)
+    npDataPtrs = npArr.ctypes.data + np.arange(nBlobs, dtype = np.uintp) * np.uintp(npArr.nbytes // nBlobs)
+    npMaskPtrs = npValidBytes.ctypes.data + np.arange(nBlobs, dtype = np.uintp) * np.uintp(npValidBytes.nbytes // nBlobs)
+    npStatus = np.zeros(nBlobs, np.uint32)
+
+    if printInfo:
+        start = timer()
+
+    result = lercDll.lerc_decodeBatch(nBlobs, npBlobPtrs.ctypes.data, npBlobSizes.ctypes.data, nBands,
+                                      npMaskPtrs.ctypes.data, nValuesPerPixel, nCols, nRows, nBands, dataType,
+                                      npDataPtrs.ctypes.data, None, None, npStatus.ctypes.data, threads)
+    if result > 0:
+        print(fctErr, 'lercDll.lerc_decodeBatch() failed with error code = ', result,
+              'for', np.count_nonzero(npStatus), 'of', nBlobs, 'blobs')
+        # a blob can fail half way, don't leave its partly decoded data
+        npFailed = npStatus != 0
+        npArr[npFailed] = 0
+        npValidBytes[npFailed] = 0
+
+    if printInfo:
+        end = timer()
+        print('time lerc_decodeBatch() = ', (end - start))
+
+    return (result, npArr, npValidBytes.view(np.bool_), npStatus)
+
+#-------------------------------------------------------------------------------
+
 # return data as a masked array; convenient but slower
 
-def decode_ma(lercBlob, printInfo = False):
+def decode_ma(lercBlob, printInfo = False, out = None):
 
     fctErr = 'Error in decode_ma(): '
 
@@ -738,7 +843,7 @@ def decode_ma(lercBlob, printInfo = False):
         print(fctErr, 'getLercBlobInfo() failed with error code = ', result)
         return result
 
-    (result, npArr, npValidMask, npmaNoData) = _decode_Ext(lercBlob, 1, printInfo)
+    (result, npArr, npValidMask, npmaNoData) = _decode_Ext(lercBlob, 1, printInfo, out)
     if result > 0:
         print(fctErr, '_decode_Ext() failed with error code = ', result)
         return result
@@ -996,6 +1101,60 @@ def test():
     print('number of invalid values, orig = ', cntInvalid, ', in masked array = ',
           np.ma.count_masked(npmaArrDec))
 
+    print('\n -------- decode test 4 -------- ')
+
+    # Lerc1 blob with a mask, decode() writes only the valid pixels, the invalid ones must be 0
+
+    fn = os.path.join(os.path.dirname(os.path.abspath(__file__)), '../../../testData/world.lerc1')
+    if not os.path.exists(fn):
+        print('skipped, test blob not found: ', fn)
+    else:
+        bytesRead = open(fn, 'rb').read()
+
+        (result, npArrDec, npValidMaskDec) = decode(bytesRead, False)
+        if result > 0:
+            print(fctErr, 'decode() failed with error code = ', result)
+            return result
+
+        cntInvalid = np.count_nonzero(~npValidMaskDec)
+        cntNonZero = np.count_nonzero(npArrDec[~npValidMaskDec])
+        print('number of invalid pixels = ', cntInvalid, ', not 0 = ', cntNonZero)
+        if cntInvalid == 0 or cntNonZero > 0:
+            print(fctErr, 'invalid pixels of the Lerc1 blob are not 0')
+            return 1
+
+    print('\n -------- decode test 5 -------- ')
+
+    # decode_many() of 4 blobs into an out array that is not 0, the 2nd blob is cut short, the 3rd is of
+    # another data type, the 4th has one more band; all 3 must fail, their data and mask must be all 0
+
+    fn = os.path.join(os.path.dirname(os.path.abspath(__file__)), '../../../testData/bluemarble_256_256_3_byte.lerc2')
+    if not os.path.exists(fn):
+        print('skipped, test blob not found: ', fn)
+    else:
+        bytesRead = open(fn, 'rb').read()
+
+        (result, npArrDec, npValidMaskDec) = decode(bytesRead, False)
+        if result > 0:
+            print(fctErr, 'decode() failed with error code = ', result)
+            return result
+
+        (result, numBytesWritten, blobInt16) = encode(npArrDec.astype(np.int16), 1, False, None, 0, 1)
+        if result == 0:
+            (result, numBytesWritten, blobMoreBands) = encode(np.concatenate([npArrDec, npArrDec[:1]]), 1, False, None, 0, 1)
+        if result > 0:
+            print(fctErr, 'encode() failed with error code = ', result)
+            return result
+
+        lercBlobs = [bytesRead, bytesRead[:len(bytesRead) - 100], blobInt16, blobMoreBands]
+        npOut = np.full((len(lercBlobs),) + npArrDec.shape, 77, npArrDec.dtype)
+        (resultMany, npArrMany, npValidMaskMany, npStatus) = decode_many(lercBlobs, npOut)
+        print('decode_many() status per blob = ', npStatus)
+        if (resultMany == 0 or npStatus[0] != 0 or np.count_nonzero(npStatus[1:]) != 3 or npStatus[2] != 1 or npStatus[3] != 1
+            or not np.array_equal(npArrMany[0], npArrDec)
+            or np.count_nonzero(npArrMany[1:]) > 0 or np.count_nonzero(npValidMaskMany[1:]) > 0):
+            print(fctErr, 'decode_many() of a good Lerc blob and of broken or different ones failed')
+            return 1
 
     if False:
         print('\n -------- decode test on ~100 different Lerc blobs -------- ')
@@ -141,15 +141,25 @@ const pixelTypeInfoMap: PixelTypeInfo[] = [
 
 let loadPromise: Promise<void> | null = null;
 let loaded = false;
+let loadedLocateFile: ((wasmFileName: string, scriptDir: string) => string) | null = null;
 export function load(
   options: {
     locateFile?: (wasmFileName: string, scriptDir: string) => string;
+    maxWorkers?: number;
+    workerUrl?: string;
   } = {}
 ): Promise<void> {
   if (loadPromise) {
     return loadPromise;
   }
+  maxDecodeWorkers = options.maxWorkers ?? 0;
+  decodeWorkerUrl = options.workerUrl ?? null;
   const locateFile = options.locateFile || ((wasmFileName: string, scriptDir: string) => `${scriptDir}${wasmFileName}`);
+  return loadWasm(locateFile);
+}
+
+function loadWasm(locateFile: (wasmFileName: string, scriptDir: string) => string): Promise<void> {
+  loadedLocateFile = locateFile;
   loadPromise = lercWasm({ locateFile }).then((lercFactory) => {
     initLercLib(lercFactory);
     loaded = true;
@@ -182,21 +192,43 @@ function normalizeByteLength(n: number): number {
 }
 
 function copyBytesFromWasm(wasmHeapU8: Uint8Array, ptr_data: number, data: Uint8Array): void {
-  data.set(wasmHeapU8.slice(ptr_data, ptr_data + data.length));
+  data.set(wasmHeapU8.subarray(ptr_data, ptr_data + data.length));
 }
 
+// a scratch block up to this size is always kept, a larger one only while the calls need at least a quarter of it
+const maxRetainedScratchByteLength = 1 << 20;
+
 function initLercLib(lercFactory: LercFactory): void {
-  const { _malloc, _free, memory, _lerc_getBlobInfo, _lerc_getDataRanges, _lerc_decode_4D } = lercFactory;
+  const { _malloc, _free, _lerc_getBlobInfo, _lerc_getDataRanges, _lerc_decode_4D } = lercFactory;
+  // emscripten builds from the CMake lerc_wasm target export the memory as wasmMemory
+  const memory = lercFactory.memory ?? lercFactory.wasmMemory!;
   // test case for dynamic memory growing from the initial 16MB: landsat_6band_8bit.24
   let heapU8: Uint8Array;
+  // one scratch block for all calls, so repeated decodes of tiles don't malloc / free. It grows as needed,
+  // and shrinks again after a large image
+  let scratchPtr = 0;
+  let scratchByteLength = 0;
+  // the number of times the scratch block was allocated, its contents are lost each time
+  let scratchAllocCount = 0;
   // avoid pointer for detached memory, malloc once:
   const mallocMultiple = (byteLengths: number[]): number[] => {
     const lens = byteLengths.map((len) => normalizeByteLength(len));
     const byteLength = lens.reduce((a, b) => a + b);
-    const ret = _malloc(byteLength);
+    const shrink = scratchByteLength > maxRetainedScratchByteLength && byteLength < scratchByteLength / 4;
+    if (byteLength > scratchByteLength || shrink) {
+      if (scratchPtr) {
+        _free(scratchPtr);
+      }
+      scratchPtr = _malloc(byteLength);
+      scratchByteLength = scratchPtr ? byteLength : 0;
+      scratchAllocCount++;
+      if (!scratchPtr) {
+        throw new Error(`lerc: cannot allocate ${byteLength} bytes`);
+      }
+    }
     heapU8 = new Uint8Array(memory.buffer);
     let prev = lens[0];
-    lens[0] = ret;
+    lens[0] = scratchPtr;
     // pointers for each allocated block
     for (let i = 1; i < lens.length; i++) {
       const next = lens[i];
@@ -213,13 +245,10 @@ function initLercLib(lercFactory: LercFactory): void {
     const rangeArr = new Uint8Array(rangeArrSize * 8);
     const [ptr, ptr_info, ptr_range] = mallocMultiple([blob.length, infoArr.length, rangeArr.length]);
     heapU8.set(blob, ptr);
-    heapU8.set(infoArr, ptr_info);
-    heapU8.set(rangeArr, ptr_range);
 
     // decode
     let hr = _lerc_getBlobInfo(ptr, blob.length, ptr_info, ptr_range, infoArrSize, rangeArrSize);
     if (hr) {
-      _free(ptr);
       throw new Error(`lerc-getBlobInfo: error code is ${hr}`);
     }
 
@@ -262,12 +291,10 @@ function initLercLib(lercFactory: LercFactory): void {
     };
 
     if (bandCountWithNoData && depthCount > 1) {
-      _free(ptr);
       return headerInfo;
     }
 
     if (depthCount === 1 && bandCount === 1) {
-      _free(ptr);
       // lerc1 data could reach here, needs special handling of min/max values
       const minValue = isAllNoData ? 0 : statsArr[0];
       const maxValue = isAllNoData ? 0 : statsArr[1];
@@ -276,31 +303,17 @@ function initLercLib(lercFactory: LercFactory): void {
     }
 
     // get data ranges for nband / ndim blob
-    // to reuse blob ptr we need to handle dynamic memory allocation
+    // the blob stays in place unless the scratch block is allocated again, maybe at the same address
     const numStatsBytes = depthCount * bandCount * 8;
     const bandStatsMinArr = new Uint8Array(numStatsBytes);
     const bandStatsMaxArr = new Uint8Array(numStatsBytes);
-    let ptr_blob = ptr;
-    let ptr_min = 0;
-    let ptr_max = 0;
-    let blob_freed = false;
-    if (heapU8.byteLength < ptr + numStatsBytes * 2) {
-      _free(ptr);
-      blob_freed = true;
-      [ptr_blob, ptr_min, ptr_max] = mallocMultiple([blob.length, numStatsBytes, numStatsBytes]);
+    const scratchAllocCountPrev = scratchAllocCount;
+    const [ptr_blob, ptr_min, ptr_max] = mallocMultiple([blob.length, numStatsBytes, numStatsBytes]);
+    if (scratchAllocCount !== scratchAllocCountPrev) {
       heapU8.set(blob, ptr_blob);
-    } else {
-      [ptr_min, ptr_max] = mallocMultiple([numStatsBytes, numStatsBytes]);
     }
-    heapU8.set(bandStatsMinArr, ptr_min);
-    heapU8.set(bandStatsMaxArr, ptr_max);
     hr = _lerc_getDataRanges(ptr_blob, blob.length, depthCount, bandCount, ptr_min, ptr_max);
     if (hr) {
-      _free(ptr_blob);
-      if (!blob_freed) {
-        // we have two pointers in two wasm function calls
-        _free(ptr_min);
-      }
       throw new Error(`lerc-getDataRanges: error code is ${hr}`);
     }
     heapU8 = new Uint8Array(memory.buffer);
@@ -330,11 +343,6 @@ function initLercLib(lercFactory: LercFactory): void {
         });
       }
     }
-    _free(ptr_blob);
-    if (!blob_freed) {
-      // we have two pointers in two wasm function calls
-      _free(ptr_min);
-    }
     return headerInfo;
   };
   lercLib.decode = (blob: Uint8Array, blobInfo: LercHeaderInfo) => {
@@ -367,10 +375,10 @@ function initLercLib(lercFactory: LercFactory): void {
       noDataArr.length
     ]);
     heapU8.set(blob, ptr);
-    heapU8.set(maskData, ptr_mask);
-    heapU8.set(data, ptr_data);
-    heapU8.set(useNoDataArr, ptr_useNoData);
-    heapU8.set(noDataArr, ptr_noData);
+    if (maskCount > 0) {
+      // the scratch block is reused, and lerc1 leaves invalid pixels as they are
+      heapU8.fill(0, ptr_data, ptr_data + data.length);
+    }
 
     const hr = _lerc_decode_4D(
       ptr,
@@ -387,12 +395,12 @@ function initLercLib(lercFactory: LercFactory): void {
       ptr_noData
     );
     if (hr) {
-      _free(ptr);
       throw new Error(`lerc-decode: error code is ${hr}`);
     }
     heapU8 = new Uint8Array(memory.buffer);
     copyBytesFromWasm(heapU8, ptr_data, data);
-    copyBytesFromWasm(heapU8, ptr_mask, maskData);
+    // only the masks that are there are written, the others stay 0
+    copyBytesFromWasm(heapU8, ptr_mask, maskData.subarray(0, numPixels * maskCount));
     let noDataValues: (number | null)[] | null = null;
     if (bandCountWithNoData) {
       copyBytesFromWasm(heapU8, ptr_useNoData, useNoDataArr);
@@ -404,7 +412,6 @@ function initLercLib(lercFactory: LercFactory): void {
       }
     }
 
-    _free(ptr);
     return {
       data,
       maskData,
@@ -545,6 +552,158 @@ export function decode(input: ArrayBuffer | Uint8Array, options: DecodeOptions =
   };
 }
 
+interface DecodeAsyncOptions extends DecodeOptions {
+  transferInput?: boolean;
+}
+
+interface DecodeWorker {
+  worker: Worker;
+  numPending: number;
+}
+
+interface DecodeTask {
+  decodeWorker: DecodeWorker;
+  resolve: (result: LercData) => void;
+  reject: (error: Error) => void;
+}
+
+const decodeWorkerName = "lerc-decode-worker";
+let decodeWorkers: DecodeWorker[] | null = null;
+let maxDecodeWorkers = 0;
+let decodeWorkerUrl: string | null = null;
+let nextDecodeTaskId = 0;
+const decodeTasks = new Map<number, DecodeTask>();
+
+// the buffers of all typed arrays in the result, once each, to move them instead of copying
+function getTransferables(result: LercData): ArrayBuffer[] {
+  const buffers = new Set<ArrayBuffer>();
+  const add = (arr: ArrayBufferView | null | undefined) => {
+    if (arr && arr.buffer instanceof ArrayBuffer) {
+      buffers.add(arr.buffer);
+    }
+  };
+  result.pixels.forEach(add);
+  add(result.mask);
+  result.bandMasks?.forEach(add);
+  result.statistics.forEach((bandStats) => {
+    add(bandStats.depthStats?.minValues);
+    add(bandStats.depthStats?.maxValues);
+  });
+  return [...buffers];
+}
+
+function rejectDecodeTasks(decodeWorker: DecodeWorker | null, message: string): void {
+  decodeTasks.forEach((task, id) => {
+    if (!decodeWorker || task.decodeWorker === decodeWorker) {
+      decodeTasks.delete(id);
+      task.reject(new Error(message));
+    }
+  });
+}
+
+function startDecodeWorker(scriptUrl: string, fileUrls: Record<string, string>): DecodeWorker {
+  const decodeWorker: DecodeWorker = {
+    worker: new Worker(scriptUrl, { type: "module", name: decodeWorkerName }),
+    numPending: 0
+  };
+  decodeWorker.worker.onmessage = (event: MessageEvent) => {
+    const { id, result, error } = event.data;
+    const task = decodeTasks.get(id);
+    if (!task) {
+      return;
+    }
+    decodeTasks.delete(id);
+    decodeWorker.numPending--;
+    if (error) {
+      task.reject(new Error(error));
+    } else {
+      task.resolve(result);
+    }
+  };
+  decodeWorker.worker.onerror = (event: ErrorEvent) => {
+    // a worker that failed to start or crashed is dropped, getDecodeWorkers() starts a new one on the next call
+    decodeWorker.worker.terminate();
+    decodeWorkers = decodeWorkers && decodeWorkers.filter((w) => w !== decodeWorker);
+    rejectDecodeTasks(decodeWorker, `lerc-worker: ${event.message}`);
+  };
+  decodeWorker.worker.postMessage({ type: "load", fileUrls });
+  return decodeWorker;
+}
+
+function getDecodeWorkers(): DecodeWorker[] {
+  const hardwareConcurrency = globalThis.navigator?.hardwareConcurrency ?? 2;
+  const numWorkers = maxDecodeWorkers > 0 ? maxDecodeWorkers : Math.max(1, Math.min(4, hardwareConcurrency - 1));
+  if (decodeWorkers && decodeWorkers.length >= numWorkers) {
+    return decodeWorkers;
+  }
+
+  // the workers run this script and load the wasm file found here
+  const scriptUrl = decodeWorkerUrl ?? import.meta.url;
+  const scriptDir = new URL(".", import.meta.url).href;
+  const fileUrls: Record<string, string> = {};
+  for (const fileName of ["lerc-wasm.wasm"]) {
+    fileUrls[fileName] = new URL(loadedLocateFile!(fileName, scriptDir), globalThis.location?.href ?? scriptUrl).href;
+  }
+
+  // start the pool, or replace the workers that failed
+  const workers = decodeWorkers ?? [];
+  while (workers.length < numWorkers) {
+    workers.push(startDecodeWorker(scriptUrl, fileUrls));
+  }
+  decodeWorkers = workers;
+  return workers;
+}
+
+/**
+ * Decoding a LERC1/LERC2 byte stream on a pool of web workers, same result as decode().
+ *
+ * The input buffer is moved to the worker, so it is detached (empty) afterwards, unless options.transferInput is false.
+ * The result arrays are moved back without copying.
+ * Where there are no web workers (node) it decodes on the calling thread.
+ *
+ * @alias module:Lerc
+ * @param {ArrayBuffer | Uint8Array} input The LERC input byte stream
+ * @param {object} [options] The decode() options, and:
+ * @param {boolean} [options.transferInput] If false, the input is copied to the worker instead of moved, default true.
+ * @returns {Promise<LercData>}
+ **/
+export async function decodeAsync(
+  input: ArrayBuffer | Uint8Array,
+  options: DecodeAsyncOptions = {}
+): Promise<LercData> {
+  if (!loaded) {
+    await load();
+  }
+  if (typeof Worker === "undefined") {
+    return decode(input, options);
+  }
+
+  const { transferInput = true, inputOffset = 0, ...decodeOptions } = options;
+  const bytes = input instanceof Uint8Array ? input : new Uint8Array(input);
+  const blob = transferInput ? bytes.subarray(inputOffset) : bytes.slice(inputOffset);
+  const transfer = blob.buffer instanceof ArrayBuffer ? [blob.buffer] : [];
+
+  const workers = getDecodeWorkers();
+  const decodeWorker = workers.reduce((a, b) => (b.numPending < a.numPending ? b : a));
+  const id = nextDecodeTaskId++;
+  decodeWorker.numPending++;
+  return new Promise<LercData>((resolve, reject) => {
+    decodeTasks.set(id, { decodeWorker, resolve, reject });
+    decodeWorker.worker.postMessage({ type: "decode", id, blob, options: decodeOptions }, transfer);
+  });
+}
+
+/**
+ * Terminate the web workers of decodeAsync(), pending decodes are rejected. They are started again on the next call.
+ *
+ * @alias module:Lerc
+ **/
+export function terminateWorkers(): void {
+  decodeWorkers?.forEach(({ worker }) => worker.terminate());
+  decodeWorkers = null;
+  rejectDecodeTasks(null, "lerc-worker: terminated");
+}
+
 /**
  * Get the header information of a LERC1/LERC2 byte stream.
  *
@@ -577,3 +736,35 @@ export function getBandCount(input: ArrayBuffer | Uint8Array, options: { inputOf
   const info = getBlobInfo(input, options);
   return info.bandCount;
 }
+
+// in a worker of the decodeAsync() pool, this script serves the decode requests
+interface DecodeWorkerScope {
+  name?: string;
+  document?: unknown;
+  postMessage: (message: unknown, transfer?: Transferable[]) => void;
+  onmessage: ((event: MessageEvent) => void) | null;
+}
+
+function serveDecodeRequests(scope: DecodeWorkerScope): void {
+  let workerLoad: Promise<void> = Promise.resolve();
+  scope.onmessage = async (event: MessageEvent) => {
+    const message = event.data;
+    if (message.type === "load") {
+      const fileUrls: Record<string, string> = message.fileUrls;
+      workerLoad = loadWasm((fileName, scriptDir) => fileUrls[fileName] ?? `${scriptDir}${fileName}`);
+      return;
+    }
+    try {
+      await workerLoad;
+      const result = decode(message.blob, message.options);
+      scope.postMessage({ id: message.id, result }, getTransferables(result));
+    } catch (error) {
+      scope.postMessage({ id: message.id, error: error instanceof Error ? error.message : String(error) });
+    }
+  };
+}
+
+const workerScope = globalThis as unknown as DecodeWorkerScope;
+if (workerScope.name === decodeWorkerName && workerScope.document === undefined) {
+  serveDecodeRequests(workerScope);
+}
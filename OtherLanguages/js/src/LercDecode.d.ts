@@ -61,8 +61,13 @@ export interface LercData {
  * Load the LERC wasm module.
  *
  * @param options Use the options to specify a function to locate the wasm file, if not located in the same directory as the script.
+ * maxWorkers and workerUrl are for the workers of decodeAsync(), workerUrl is needed if this script gets bundled.
  */
-export function load(options?: { locateFile?: (wasmFileName: string, scriptDir: string) => string }): Promise<void>;
+export function load(options?: {
+  locateFile?: (wasmFileName: string, scriptDir: string) => string;
+  maxWorkers?: number;
+  workerUrl?: string;
+}): Promise<void>;
 
 export function isLoaded(): boolean;
 
@@ -77,6 +82,22 @@ export function isLoaded(): boolean;
  */
 export function decode(input: ArrayBuffer | Uint8Array, options?: DecodeOptions): LercData;
 
+export interface DecodeAsyncOptions extends DecodeOptions {
+  transferInput?: boolean;
+}
+
+/**
+ * Decode a LERC byte stream on a pool of web workers, same result as decode().
+ * The input buffer is moved to the worker and detached, unless options.transferInput is false.
+ * The result arrays are moved back without copying.
+ */
+export function decodeAsync(input: ArrayBuffer | Uint8Array, options?: DecodeAsyncOptions): Promise<LercData>;
+
+/**
+ * Terminate the web workers of decodeAsync(), pending decodes are rejected.
+ */
+export function terminateWorkers(): void;
+
 export function getBlobInfo(input: ArrayBuffer | Uint8Array, options?: { inputOffset?: number }): LercHeaderInfo;
 
 /**
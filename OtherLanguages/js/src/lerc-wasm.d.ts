@@ -1,5 +1,6 @@
 export interface LercFactory {
-  memory: { buffer: ArrayBuffer };
+  memory?: { buffer: ArrayBuffer };
+  wasmMemory?: { buffer: ArrayBuffer };
   _malloc: (ptr: number) => number;
   _free: (ptr: number) => number;
   _lerc_getBlobInfo: (
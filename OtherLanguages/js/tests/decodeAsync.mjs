@@ -0,0 +1,103 @@
+import * as Lerc from "../dist/LercDecode.es.js";
+import fs from "fs";
+import { installWorkerShim, shimWorkers } from "./worker-shim.mjs";
+
+// decodeAsync() on web workers, run on node worker_threads through the shim
+installWorkerShim();
+
+const blobUrl = new URL("../../../testData/california_400_400_1_float.lerc2", import.meta.url);
+
+function readBlob() {
+  return new Uint8Array(fs.readFileSync(blobUrl));
+}
+
+function sameResult(a, b) {
+  return (
+    a.width === b.width &&
+    a.height === b.height &&
+    a.pixelType === b.pixelType &&
+    a.validPixelCount === b.validPixelCount &&
+    a.pixels.length === b.pixels.length &&
+    a.pixels.every((band, i) => band.join(",") === b.pixels[i].join(",")) &&
+    String(a.mask) === String(b.mask)
+  );
+}
+
+function waitFor(condition) {
+  return new Promise((resolve, reject) => {
+    const t0 = Date.now();
+    const poll = () => {
+      if (condition()) {
+        resolve();
+      } else if (Date.now() - t0 > 10000) {
+        reject(new Error("timeout"));
+      } else {
+        setTimeout(poll, 10);
+      }
+    };
+    poll();
+  });
+}
+
+async function decodeAsyncTests() {
+  await Lerc.load({ maxWorkers: 2 });
+  const expected = Lerc.decode(readBlob());
+
+  // message protocol: results from the workers, spread over both
+  const inputs = [readBlob(), readBlob(), readBlob(), readBlob()];
+  const results = await Promise.all(inputs.map((input) => Lerc.decodeAsync(input, { transferInput: false })));
+  log(
+    results.every((result) => sameResult(result, expected)) && shimWorkers.length === 2,
+    "decodeAsync results from 2 workers"
+  );
+  log(
+    inputs.every((input) => input.byteLength > 0),
+    "decodeAsync transferInput false keeps the input"
+  );
+
+  // transfer lists: the input is moved to the worker, the result arrays are moved back
+  const input = readBlob();
+  const result = await Lerc.decodeAsync(input);
+  log(input.byteLength === 0 && sameResult(result, expected), "decodeAsync moves the input");
+
+  // errors from the worker reject the one decode
+  let error = null;
+  await Lerc.decodeAsync(new Uint8Array(100)).catch((e) => (error = e));
+  const resultAfterError = await Lerc.decodeAsync(readBlob());
+  log(error instanceof Error && sameResult(resultAfterError, expected), "decodeAsync rejects a bad blob");
+
+  // a crashed worker is replaced on the next call
+  const crashed = shimWorkers[0];
+  crashed.crash();
+  await waitFor(() => crashed.terminated);
+  const resultsAfterCrash = await Promise.all([readBlob(), readBlob()].map((blob) => Lerc.decodeAsync(blob)));
+  const alive = shimWorkers.filter((w) => !w.terminated);
+  log(
+    resultsAfterCrash.every((r) => sameResult(r, expected)) && shimWorkers.length === 3 && alive.length === 2,
+    "decodeAsync replaces a crashed worker"
+  );
+
+  // terminateWorkers() rejects pending decodes, the next call starts new workers
+  const pending = Lerc.decodeAsync(readBlob());
+  Lerc.terminateWorkers();
+  error = null;
+  await pending.catch((e) => (error = e));
+  const terminated = shimWorkers.every((w) => w.terminated);
+  const resultAfterTerminate = await Lerc.decodeAsync(readBlob());
+  log(
+    error instanceof Error && terminated && sameResult(resultAfterTerminate, expected) && shimWorkers.length === 5,
+    "decodeAsync after terminateWorkers"
+  );
+
+  Lerc.terminateWorkers();
+}
+
+function log(pass, message) {
+  if (pass) {
+    console.log("\x1b[32m%s\x1b[0m", `$PASS ${message}`);
+  } else {
+    console.error("\x1b[41m%s\x1b[0m", `$FAIL ${message}`);
+  }
+}
+
+decodeAsyncTests();
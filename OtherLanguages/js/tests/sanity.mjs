@@ -37,6 +37,30 @@ const sanity = () =>
       pass = pass && bipResult2.pixels[0].slice(0, 6).join(",") === "13,57,68,14,59,80";
     }
     log(pass, "4D sanity");
+
+    // a large constant image, then a small one, which gets a smaller scratch block in wasm
+    const dataConst =
+      "76,101,114,99,50,32,6,0,0,0,136,109,198,23,0,4,0,0,0,4,0,0,1,0,0,0,0,0,16,0,8,0,0,0,94,0,0,0,6,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,248,63,0,0,0,0,0,0,248,63,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0"
+        .split(",")
+        .map((x) => Number(x));
+    const largeResult = Lerc.decode(dataConst);
+    const smallResult = Lerc.decode(data4D);
+    log(
+      largeResult.width === 1024 &&
+        largeResult.height === 1024 &&
+        largeResult.pixels[0].every((x) => x === 1.5) &&
+        smallResult.pixels[0].join(",") === result.pixels[0].join(","),
+      "decode after a large image"
+    );
+
+    // same result from the worker pool, or the calling thread where there are no web workers
+    return Lerc.decodeAsync(new Uint8Array(data4D)).then((asyncResult) => {
+      const same =
+        asyncResult.width === result.width &&
+        asyncResult.height === result.height &&
+        asyncResult.pixels[0].join(",") === result.pixels[0].join(",");
+      log(same, "decodeAsync sanity");
+    });
   });
 
 function log(pass, message) {
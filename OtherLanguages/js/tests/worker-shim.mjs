@@ -0,0 +1,59 @@
+// Web Worker on top of node worker_threads, so decodeAsync() can be tested in node.
+// In the main thread, installWorkerShim() sets globalThis.Worker. In a worker thread, this file is the entry
+// point: it sets up the worker global scope the script expects (name, postMessage, onmessage), then imports it.
+import { Worker as NodeWorker, isMainThread, parentPort, workerData } from "worker_threads";
+
+// all workers started, in order, also the terminated ones
+export const shimWorkers = [];
+
+export function installWorkerShim() {
+  globalThis.Worker = class Worker {
+    constructor(url, options = {}) {
+      this.onmessage = null;
+      this.onerror = null;
+      this.terminated = false;
+      this.nodeWorker = new NodeWorker(new URL(import.meta.url), {
+        workerData: { url: String(url), name: options.name }
+      });
+      this.nodeWorker.on("message", (data) => this.onmessage?.({ data }));
+      this.nodeWorker.on("error", (error) => this.onerror?.({ message: error.message }));
+      shimWorkers.push(this);
+    }
+
+    postMessage(message, transfer) {
+      this.nodeWorker.postMessage(message, transfer);
+    }
+
+    terminate() {
+      this.terminated = true;
+      this.nodeWorker.terminate();
+    }
+
+    // test only, the worker throws outside of its message handler, as if it crashed
+    crash() {
+      this.nodeWorker.postMessage({ type: "shim-crash" });
+    }
+  };
+}
+
+if (!isMainThread && workerData?.url) {
+  globalThis.name = workerData.name;
+  globalThis.postMessage = (message, transfer) => parentPort.postMessage(message, transfer);
+
+  // messages that come in before the script has set onmessage
+  const queue = [];
+  parentPort.on("message", (data) => {
+    if (data?.type === "shim-crash") {
+      setTimeout(() => {
+        throw new Error("shim crash");
+      });
+    } else if (globalThis.onmessage) {
+      globalThis.onmessage({ data });
+    } else {
+      queue.push(data);
+    }
+  });
+
+  await import(workerData.url);
+  queue.splice(0).forEach((data) => globalThis.onmessage?.({ data }));
+}
@@ -0,0 +1,683 @@
+/*
+Copyright 2015 - 2026 Esri
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+A local copy of the license and additional notices are located with the
+source distribution at:
+
+http://github.com/Esri/lerc/
+
+Contributors:  Thomas Maurer
+*/
+
+// lerc_bench:  encode / decode speed and compression ratio over a fixed matrix of
+// data types x nDepth x nBands x mask density x maxZErr, on synthetic images from a fixed seed
+// and on the Lerc blobs in testData. Writes one JSON document, to compare between releases.
+//
+// usage:  lerc_bench [-o out.json] [-d testDataDir] [-s imageSize] [-t minSecondsPerTiming] [-f nameFilter]
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../LercLib/include/Lerc_c_api.h"
+#include "../LercLib/include/Lerc_types.h"
+
+#ifndef LERC_BENCH_TEST_DATA_DIR
+#define LERC_BENCH_TEST_DATA_DIR "testData"
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+typedef unsigned char Byte;
+typedef unsigned int uint32;
+enum lerc_DataType { dt_char = 0, dt_uchar, dt_short, dt_ushort, dt_int, dt_uint, dt_float, dt_double };
+
+//-----------------------------------------------------------------------------
+
+struct Options
+{
+  string outFile;
+  string testDataDir = LERC_BENCH_TEST_DATA_DIR;
+  string filter;
+  int imageSize = 512;
+  double minSeconds = 0.2;    // repeat each timing at least this long
+  int minRuns = 3;
+};
+
+struct BenchCase
+{
+  string name, source;
+  int dt = dt_float;
+  int nDepth = 1, nCols = 0, nRows = 0, nBands = 1, nMasks = 0;
+  double invalidFraction = 0;
+  bool bNoData = false;
+  double maxZErr = 0;
+  vector<Byte> data, validBytes, usesNoData;
+  vector<double> noDataValues;
+};
+
+struct Timing
+{
+  double minSec = 0, medianSec = 0;
+  int runs = 0;
+};
+
+struct BenchResult
+{
+  size_t rawBytes = 0, blobBytes = 0;
+  Timing encode, decode;
+  double maxErr = 0;
+  bool bOk = false;
+  string error;
+};
+
+//-----------------------------------------------------------------------------
+//    helper functions
+//-----------------------------------------------------------------------------
+
+static int DataTypeSize(int dt)
+{
+  static const int size[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+  return (dt >= 0 && dt <= dt_double) ? size[dt] : 0;
+}
+
+static const char* DataTypeName(int dt)
+{
+  static const char* name[] = { "char", "uchar", "short", "ushort", "int", "uint", "float", "double" };
+  return (dt >= 0 && dt <= dt_double) ? name[dt] : "undefined";
+}
+
+// deterministic, same numbers on all platforms
+static uint32 Rand(uint32& state)
+{
+  state = state * 1103515245u + 12345u;
+  return (state >> 8) & 0xFFFFFF;
+}
+
+template<class F>
+static Timing TimeIt(const Options& opt, F&& func)
+{
+  vector<double> secVec;
+  double total = 0;
+
+  while ((int)secVec.size() < opt.minRuns || total < opt.minSeconds)
+  {
+    auto t0 = steady_clock::now();
+    if (!func())
+      return Timing();
+    double sec = duration<double>(steady_clock::now() - t0).count();
+    secVec.push_back(sec);
+    total += sec;
+  }
+
+  sort(secVec.begin(), secVec.end());
+
+  Timing t;
+  t.minSec = secVec.front();
+  t.medianSec = secVec[secVec.size() / 2];
+  t.runs = (int)secVec.size();
+  return t;
+}
+
+//-----------------------------------------------------------------------------
+//    synthetic images
+//-----------------------------------------------------------------------------
+
+// smooth surface plus noise, scaled into the range of the data type
+template<class T>
+static void FillSynthetic(BenchCase& bc, uint32 seed)
+{
+  const size_t nValues = (size_t)bc.nDepth * bc.nCols * bc.nRows * bc.nBands;
+  bc.data.resize(nValues * sizeof(T));
+  T* p = (T*)&bc.data[0];
+
+  const bool bInt = bc.dt < dt_float;
+  const double lo = bc.dt == dt_char ? -128 : bc.dt == dt_short ? -32768 : bc.dt == dt_int ? -1e9 : 0;
+  const double hi = bc.dt == dt_char ? 127 : bc.dt == dt_uchar ? 255 : bc.dt == dt_short ? 32767
+    : bc.dt == dt_ushort ? 65535 : bc.dt == dt_int ? 1e9 : bc.dt == dt_uint ? 2e9 : 1e6;
+  const double amp = bInt ? std::min(1000.0, (hi - lo) / 4) : 1000;
+  const double mid = (bc.dt == dt_char || bc.dt == dt_short || bc.dt == dt_int) ? 0 : amp * 2;
+
+  uint32 state = seed;
+
+  for (int iBand = 0; iBand < bc.nBands; iBand++)
+    for (int i = 0; i < bc.nRows; i++)
+      for (int j = 0; j < bc.nCols; j++)
+        for (int m = 0; m < bc.nDepth; m++)
+        {
+          double z = mid + amp * 0.5 * (sin(i * 0.013 + iBand) + cos(j * 0.021 + m));
+          z += bInt ? (double)(Rand(state) % 8) : (Rand(state) % 1000) * 0.0137;
+          z = std::max(lo, std::min(hi, bInt ? floor(z) : z));
+          *p++ = (T)z;
+        }
+
+  if (bc.bNoData)    // sprinkle noData over all values, so for nDepth > 1 some pixels are mixed
+  {
+    const double noData = -9999;
+    p = (T*)&bc.data[0];
+    for (size_t k = 0; k < nValues; k++)
+      if (Rand(state) % 32 == 0)
+        p[k] = (T)noData;
+
+    bc.usesNoData.assign(bc.nBands, 1);
+    bc.noDataValues.assign(bc.nBands, noData);
+  }
+}
+
+static void MakeMask(BenchCase& bc, uint32 seed)
+{
+  bc.validBytes.clear();
+  bc.nMasks = 0;
+
+  if (bc.invalidFraction <= 0)
+    return;
+
+  // one mask for all bands, invalid pixels in short runs like around the edges of real data
+  const size_t nPix = (size_t)bc.nCols * bc.nRows;
+  const uint32 threshold = (uint32)(bc.invalidFraction * 0xFFFFFF / 4);
+  uint32 state = seed;
+
+  bc.validBytes.assign(nPix, 1);
+  for (size_t k = 0; k < nPix; k++)
+    if (Rand(state) < threshold)
+      for (size_t n = k; n < std::min(nPix, k + 4); n++)
+        bc.validBytes[n] = 0;
+
+  bc.nMasks = 1;
+}
+
+static void MakeSyntheticCase(BenchCase& bc, uint32 seed)
+{
+  switch (bc.dt)
+  {
+    case dt_char:   FillSynthetic<signed char>(bc, seed);  break;
+    case dt_uchar:  FillSynthetic<Byte>(bc, seed);  break;
+    case dt_short:  FillSynthetic<short>(bc, seed);  break;
+    case dt_ushort: FillSynthetic<unsigned short>(bc, seed);  break;
+    case dt_int:    FillSynthetic<int>(bc, seed);  break;
+    case dt_uint:   FillSynthetic<unsigned int>(bc, seed);  break;
+    case dt_float:  FillSynthetic<float>(bc, seed);  break;
+    case dt_double: FillSynthetic<double>(bc, seed);  break;
+  }
+
+  MakeMask(bc, seed + 1);
+}
+
+static void AddSyntheticCases(const Options& opt, vector<BenchCase>& caseVec)
+{
+  // nDepth x nBands
+  const int shapes[][2] = { { 1, 1 }, { 3, 1 }, { 1, 3 } };
+  const double invalidFractions[] = { 0, 0.1, 0.5 };
+
+  for (int dt = dt_char; dt <= dt_double; dt++)
+    for (const auto& shape : shapes)
+      for (double invalidFraction : invalidFractions)
+        for (int lossy = 0; lossy < 2; lossy++)
+          for (int noData = 0; noData < ((dt >= dt_float) ? 2 : 1); noData++)
+          {
+            if (noData && (lossy == 0 || invalidFraction > 0.1))    // a few noData cases are enough
+              continue;
+
+            BenchCase bc;
+            bc.source = "synthetic";
+            bc.dt = dt;
+            bc.nDepth = shape[0];
+            bc.nBands = shape[1];
+            bc.nCols = bc.nRows = opt.imageSize;
+            bc.invalidFraction = invalidFraction;
+            bc.bNoData = noData != 0;
+            bc.maxZErr = !lossy ? 0 : (dt < dt_float ? 2 : 0.01);
+
+            ostringstream oss;
+            oss << DataTypeName(dt) << "_d" << bc.nDepth << "_b" << bc.nBands << "_inv" << invalidFraction
+              << (lossy ? "_lossy" : "_lossless") << (noData ? "_nodata" : "");
+            bc.name = oss.str();
+
+            caseVec.push_back(bc);
+          }
+}
+
+//-----------------------------------------------------------------------------
+//    Lerc blobs from testData
+//-----------------------------------------------------------------------------
+
+static bool ReadFile(const string& fn, vector<Byte>& buffer)
+{
+  ifstream file(fn, ios::binary);
+  if (!file)
+    return false;
+
+  buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+  return !buffer.empty();
+}
+
+// decode the blob into a bench case, for re-encode
+static bool DecodeBlobToCase(const vector<Byte>& blob, BenchCase& bc)
+{
+  const int infoArrSize = (int)LercNS::InfoArrOrder::_last;
+  const int dataRangeArrSize = (int)LercNS::DataRangeArrOrder::_last;
+  uint32 infoArr[infoArrSize];
+  double dataRangeArr[dataRangeArrSize];
+
+  if (lerc_getBlobInfo(&blob[0], (uint32)blob.size(), infoArr, dataRangeArr, infoArrSize, dataRangeArrSize))
+    return false;
+
+  bc.dt = (int)infoArr[(int)LercNS::InfoArrOrder::dataType];
+  bc.nDepth = (int)infoArr[(int)LercNS::InfoArrOrder::nDepth];
+  bc.nCols = (int)infoArr[(int)LercNS::InfoArrOrder::nCols];
+  bc.nRows = (int)infoArr[(int)LercNS::InfoArrOrder::nRows];
+  bc.nBands = (int)infoArr[(int)LercNS::InfoArrOrder::nBands];
+  bc.nMasks = (int)infoArr[(int)LercNS::InfoArrOrder::nMasks];
+  bc.maxZErr = dataRangeArr[(int)LercNS::DataRangeArrOrder::maxZErrUsed];
+
+  size_t nValues = (size_t)bc.nDepth * bc.nCols * bc.nRows * bc.nBands;
+  bc.data.resize(nValues * DataTypeSize(bc.dt));
+  bc.validBytes.resize((size_t)bc.nCols * bc.nRows * bc.nMasks);
+
+  if (infoArr[(int)LercNS::InfoArrOrder::nUsesNoDataValue])
+  {
+    bc.usesNoData.resize(bc.nBands);
+    bc.noDataValues.resize(bc.nBands);
+  }
+
+  return 0 == lerc_decode_4D(&blob[0], (uint32)blob.size(), bc.nMasks, bc.validBytes.empty() ? nullptr : &bc.validBytes[0],
+    bc.nDepth, bc.nCols, bc.nRows, bc.nBands, bc.dt, &bc.data[0],
+    bc.usesNoData.empty() ? nullptr : &bc.usesNoData[0], bc.noDataValues.empty() ? nullptr : &bc.noDataValues[0]);
+}
+
+static void AddTestDataCases(const Options& opt, vector<BenchCase>& caseVec, vector<pair<string, vector<Byte> > >& blobVec)
+{
+  namespace fs = std::filesystem;
+  error_code ec;
+
+  if (!fs::is_directory(opt.testDataDir, ec))
+  {
+    cerr << "lerc_bench: no test data dir " << opt.testDataDir << ", synthetic images only" << endl;
+    return;
+  }
+
+  vector<string> fnVec;
+  for (const auto& entry : fs::directory_iterator(opt.testDataDir, ec))
+  {
+    string ext = entry.path().extension().string();
+    if (ext == ".lerc2" || ext == ".lerc1" || ext == ".lerc")
+      fnVec.push_back(entry.path().string());
+  }
+  sort(fnVec.begin(), fnVec.end());    // same order on all platforms
+
+  for (const string& fn : fnVec)
+  {
+    vector<Byte> blob;
+    BenchCase bc;
+    string stem = fs::path(fn).stem().string();
+
+    if (!ReadFile(fn, blob) || !DecodeBlobToCase(blob, bc))
+    {
+      cerr << "lerc_bench: cannot read " << fn << endl;
+      continue;
+    }
+
+    blobVec.push_back(make_pair(stem, blob));    // decode this blob as is
+
+    // re-encode the decoded data, lossless and with the maxZErr of the file
+    bc.source = "testData";
+    double maxZErrFile = bc.maxZErr;
+    bool bLossy = (bc.dt < dt_float) ? (maxZErrFile > 0.5) : (maxZErrFile > 0);
+
+    for (int lossy = 0; lossy < (bLossy ? 2 : 1); lossy++)
+    {
+      BenchCase bc2 = bc;
+      bc2.maxZErr = lossy ? maxZErrFile : 0;
+      bc2.name = stem + (lossy ? "_lossy" : "_lossless");
+      caseVec.push_back(bc2);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//    run
+//-----------------------------------------------------------------------------
+
+// max error over the valid values; a pixel with all values noData turns invalid on encode
+template<class T>
+static double MaxError(const BenchCase& bc, const vector<Byte>& decoded, int nMasksOut, const vector<Byte>& validBytesOut,
+  double& maxAbs, bool& bMaskOk)
+{
+  const T* p0 = (const T*)&bc.data[0];
+  const T* p1 = (const T*)&decoded[0];
+  const size_t nPix = (size_t)bc.nCols * bc.nRows;
+  double maxErr = 0;
+
+  maxAbs = 0;
+  bMaskOk = true;
+
+  for (int iBand = 0; iBand < bc.nBands; iBand++)
+  {
+    const Byte* pValid = bc.nMasks == 0 ? nullptr : &bc.validBytes[(bc.nMasks > 1 ? iBand : 0) * nPix];
+    const Byte* pValidOut = nMasksOut == 0 ? nullptr : &validBytesOut[(nMasksOut > 1 ? iBand : 0) * nPix];
+    bool bNoData = !bc.usesNoData.empty() && bc.usesNoData[iBand];
+    T noData = bNoData ? (T)bc.noDataValues[iBand] : 0;
+
+    for (size_t k = 0; k < nPix; k++)
+    {
+      const size_t n0 = ((size_t)iBand * nPix + k) * bc.nDepth;
+      bool bValid = !pValid || pValid[k];
+
+      if (bValid && bNoData)
+      {
+        int cntNoData = 0;
+        for (int m = 0; m < bc.nDepth; m++)
+          cntNoData += (p0[n0 + m] == noData) ? 1 : 0;
+        bValid = cntNoData < bc.nDepth;
+      }
+
+      if (bValid != (!pValidOut || pValidOut[k] != 0))
+        bMaskOk = false;
+
+      if (bValid)
+        for (int m = 0; m < bc.nDepth; m++)
+        {
+          size_t n = n0 + m;
+          if (bNoData && p0[n] == noData)
+          {
+            if (p1[n] != noData)
+              bMaskOk = false;
+          }
+          else
+          {
+            maxErr = std::max(maxErr, fabs((double)p1[n] - (double)p0[n]));
+            maxAbs = std::max(maxAbs, fabs((double)p0[n]));
+          }
+        }
+    }
+  }
+
+  return maxErr;
+}
+
+static double MaxError(const BenchCase& bc, const vector<Byte>& decoded, int nMasksOut, const vector<Byte>& validBytesOut,
+  double& maxAbs, bool& bMaskOk)
+{
+  switch (bc.dt)
+  {
+    case dt_char:   return MaxError<signed char>(bc, decoded, nMasksOut, validBytesOut, maxAbs, bMaskOk);
+    case dt_uchar:  return MaxError<Byte>(bc, decoded, nMasksOut, validBytesOut, maxAbs, bMaskOk);
+    case dt_short:  return MaxError<short>(bc, decoded, nMasksOut, validBytesOut, maxAbs, bMaskOk);
+    case dt_ushort: return MaxError<unsigned short>(bc, decoded, nMasksOut, validBytesOut, maxAbs, bMaskOk);
+    case dt_int:    return MaxError<int>(bc, decoded, nMasksOut, validBytesOut, maxAbs, bMaskOk);
+    case dt_uint:   return MaxError<unsigned int>(bc, decoded, nMasksOut, validBytesOut, maxAbs, bMaskOk);
+    case dt_float:  return MaxError<float>(bc, decoded, nMasksOut, validBytesOut, maxAbs, bMaskOk);
+    case dt_double: return MaxError<double>(bc, decoded, nMasksOut, validBytesOut, maxAbs, bMaskOk);
+  }
+  bMaskOk = false;
+  return 0;
+}
+
+static BenchResult RunEncodeDecode(const Options& opt, const BenchCase& bc)
+{
+  BenchResult res;
+  res.rawBytes = bc.data.size();
+
+  const Byte* pValid = bc.validBytes.empty() ? nullptr : &bc.validBytes[0];
+  const Byte* pUsesNoData = bc.usesNoData.empty() ? nullptr : &bc.usesNoData[0];
+  const double* pNoData = bc.noDataValues.empty() ? nullptr : &bc.noDataValues[0];
+
+  uint32 numBytesNeeded = 0;
+  if (lerc_computeCompressedSize_4D(&bc.data[0], bc.dt, bc.nDepth, bc.nCols, bc.nRows, bc.nBands, bc.nMasks, pValid,
+    bc.maxZErr, &numBytesNeeded, pUsesNoData, pNoData) || numBytesNeeded == 0)
+  {
+    res.error = "lerc_computeCompressedSize_4D failed";
+    return res;
+  }
+
+  vector<Byte> blob(numBytesNeeded);
+  uint32 numBytesWritten = 0;
+
+  res.encode = TimeIt(opt, [&]()
+  {
+    return 0 == lerc_encode_4D(&bc.data[0], bc.dt, bc.nDepth, bc.nCols, bc.nRows, bc.nBands, bc.nMasks, pValid,
+      bc.maxZErr, &blob[0], (uint32)blob.size(), &numBytesWritten, pUsesNoData, pNoData);
+  });
+
+  if (res.encode.runs == 0)
+  {
+    res.error = "lerc_encode_4D failed";
+    return res;
+  }
+
+  res.blobBytes = numBytesWritten;
+
+  // noData can turn into invalid pixels, so the blob can have a mask even if the input has none
+  const int infoArrSize = (int)LercNS::InfoArrOrder::_last;
+  uint32 infoArr[infoArrSize];
+  if (lerc_getBlobInfo(&blob[0], numBytesWritten, infoArr, nullptr, infoArrSize, 0))
+  {
+    res.error = "lerc_getBlobInfo failed";
+    return res;
+  }
+
+  const int nMasksOut = (int)infoArr[(int)LercNS::InfoArrOrder::nMasks];
+  vector<Byte> decoded(bc.data.size());
+  vector<Byte> validBytes((size_t)bc.nCols * bc.nRows * nMasksOut);
+  vector<Byte> usesNoData(bc.usesNoData.size());
+  vector<double> noDataValues(bc.noDataValues.size());
+
+  res.decode = TimeIt(opt, [&]()
+  {
+    return 0 == lerc_decode_4D(&blob[0], numBytesWritten, nMasksOut, validBytes.empty() ? nullptr : &validBytes[0],
+      bc.nDepth, bc.nCols, bc.nRows, bc.nBands, bc.dt, &decoded[0],
+      usesNoData.empty() ? nullptr : &usesNoData[0], noDataValues.empty() ? nullptr : &noDataValues[0]);
+  });
+
+  if (res.decode.runs == 0)
+  {
+    res.error = "lerc_decode_4D failed";
+    return res;
+  }
+
+  bool bMaskOk = false;
+  double maxAbs = 0;
+  res.maxErr = MaxError(bc, decoded, nMasksOut, validBytes, maxAbs, bMaskOk);
+
+  // allow for the finite precision of the data type
+  double maxErrAllowed = (bc.dt < dt_float) ? floor(std::max(0.5, bc.maxZErr))
+    : bc.maxZErr + maxAbs * ((bc.dt == dt_float) ? FLT_EPSILON : DBL_EPSILON);
+  res.bOk = bMaskOk && res.maxErr <= maxErrAllowed;
+  if (!res.bOk)
+    res.error = bMaskOk ? "max error exceeded" : "mask or noData differs";
+
+  return res;
+}
+
+static BenchResult RunDecodeOnly(const Options& opt, const vector<Byte>& blob, BenchCase& bc)
+{
+  BenchResult res;
+  res.blobBytes = blob.size();
+
+  vector<Byte> decoded;
+  if (!DecodeBlobToCase(blob, bc))
+  {
+    res.error = "lerc_decode_4D failed";
+    return res;
+  }
+
+  res.rawBytes = bc.data.size();
+  decoded.resize(bc.data.size());
+  vector<Byte> validBytes(bc.validBytes.size());
+  vector<Byte> usesNoData(bc.usesNoData.size());
+  vector<double> noDataValues(bc.noDataValues.size());
+
+  res.decode = TimeIt(opt, [&]()
+  {
+    return 0 == lerc_decode_4D(&blob[0], (uint32)blob.size(), bc.nMasks, validBytes.empty() ? nullptr : &validBytes[0],
+      bc.nDepth, bc.nCols, bc.nRows, bc.nBands, bc.dt, &decoded[0],
+      usesNoData.empty() ? nullptr : &usesNoData[0], noDataValues.empty() ? nullptr : &noDataValues[0]);
+  });
+
+  res.bOk = res.decode.runs > 0 && decoded == bc.data;    // same result each time
+  if (!res.bOk)
+    res.error = "decode not repeatable";
+
+  return res;
+}
+
+//-----------------------------------------------------------------------------
+//    JSON out
+//-----------------------------------------------------------------------------
+
+static void WriteTiming(ostream& os, const char* key, const Timing& t, size_t rawBytes, double nPixels)
+{
+  os << "      \"" << key << "\": { \"runs\": " << t.runs
+    << ", \"minMs\": " << t.minSec * 1000 << ", \"medianMs\": " << t.medianSec * 1000;
+
+  if (t.minSec > 0)
+    os << ", \"MBps\": " << rawBytes / t.minSec / 1e6 << ", \"MPixps\": " << nPixels / t.minSec / 1e6;
+
+  os << " }";
+}
+
+static void WriteResult(ostream& os, const BenchCase& bc, const BenchResult& res, const char* mode, bool bFirst)
+{
+  const double nPixels = (double)bc.nCols * bc.nRows * bc.nBands;
+
+  os << (bFirst ? "" : ",\n") << "    {\n";
+  os << "      \"name\": \"" << bc.name << "\", \"source\": \"" << bc.source << "\", \"mode\": \"" << mode << "\",\n";
+  os << "      \"dataType\": \"" << DataTypeName(bc.dt) << "\", \"nDepth\": " << bc.nDepth << ", \"nCols\": " << bc.nCols
+    << ", \"nRows\": " << bc.nRows << ", \"nBands\": " << bc.nBands << ", \"nMasks\": " << bc.nMasks << ",\n";
+  os << "      \"invalidFraction\": " << bc.invalidFraction << ", \"noData\": " << (bc.usesNoData.empty() ? "false" : "true")
+    << ", \"maxZErr\": " << bc.maxZErr << ",\n";
+  os << "      \"rawBytes\": " << res.rawBytes << ", \"blobBytes\": " << res.blobBytes
+    << ", \"ratio\": " << (res.blobBytes ? (double)res.rawBytes / res.blobBytes : 0) << ",\n";
+
+  if (res.encode.runs > 0)
+  {
+    WriteTiming(os, "encode", res.encode, res.rawBytes, nPixels);
+    os << ",\n";
+  }
+  if (res.decode.runs > 0)
+  {
+    WriteTiming(os, "decode", res.decode, res.rawBytes, nPixels);
+    os << ",\n";
+  }
+
+  os << "      \"maxErr\": " << res.maxErr << ", \"ok\": " << (res.bOk ? "true" : "false");
+  if (!res.error.empty())
+    os << ", \"error\": \"" << res.error << "\"";
+  os << "\n    }";
+}
+
+//-----------------------------------------------------------------------------
+//    main
+//-----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  Options opt;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    bool bHasValue = i + 1 < argc;
+
+    if (arg == "-o" && bHasValue)
+      opt.outFile = argv[++i];
+    else if (arg == "-d" && bHasValue)
+      opt.testDataDir = argv[++i];
+    else if (arg == "-s" && bHasValue)
+      opt.imageSize = std::max(1, atoi(argv[++i]));
+    else if (arg == "-t" && bHasValue)
+      opt.minSeconds = std::max(0.0, atof(argv[++i]));
+    else if (arg == "-f" && bHasValue)
+      opt.filter = argv[++i];
+    else
+    {
+      cerr << "usage: lerc_bench [-o out.json] [-d testDataDir] [-s imageSize] [-t minSecondsPerTiming] [-f nameFilter]" << endl;
+      return 1;
+    }
+  }
+
+  vector<BenchCase> caseVec;
+  vector<pair<string, vector<Byte> > > blobVec;
+
+  AddTestDataCases(opt, caseVec, blobVec);
+  AddSyntheticCases(opt, caseVec);
+
+  ofstream outFile;
+  if (!opt.outFile.empty())
+  {
+    outFile.open(opt.outFile);
+    if (!outFile)
+    {
+      cerr << "lerc_bench: cannot write " << opt.outFile << endl;
+      return 1;
+    }
+  }
+  ostream& os = opt.outFile.empty() ? cout : outFile;
+
+  os << "{\n  \"lercVersion\": \"" << LERC_VERSION_MAJOR << "." << LERC_VERSION_MINOR << "." << LERC_VERSION_PATCH << "\",\n";
+  os << "  \"imageSize\": " << opt.imageSize << ", \"minSecondsPerTiming\": " << opt.minSeconds << ",\n";
+  os << "  \"results\": [\n";
+
+  int cntFailures = 0;
+  bool bFirst = true;
+
+  for (const auto& nameBlob : blobVec)
+  {
+    BenchCase bc;
+    bc.name = nameBlob.first;
+    bc.source = "testData";
+    if (!opt.filter.empty() && bc.name.find(opt.filter) == string::npos)
+      continue;
+
+    cerr << "decode " << bc.name << endl;
+    BenchResult res = RunDecodeOnly(opt, nameBlob.second, bc);
+    cntFailures += res.bOk ? 0 : 1;
+    WriteResult(os, bc, res, "decode", bFirst);
+    bFirst = false;
+  }
+
+  uint32 seed = 1;
+  for (BenchCase& bc : caseVec)
+  {
+    if (bc.source == "synthetic")
+      MakeSyntheticCase(bc, seed++ * 7919);
+
+    if (!opt.filter.empty() && bc.name.find(opt.filter) == string::npos)
+      continue;
+
+    cerr << "encode / decode " << bc.name << endl;
+    BenchResult res = RunEncodeDecode(opt, bc);
+    cntFailures += res.bOk ? 0 : 1;
+    WriteResult(os, bc, res, "encode_decode", bFirst);
+    bFirst = false;
+
+    if (bc.source == "synthetic")    // free as we go
+      vector<Byte>().swap(bc.data);
+  }
+
+  os << "\n  ],\n  \"failures\": " << cntFailures << "\n}\n";
+
+  return cntFailures > 0 ? 2 : 0;
+}
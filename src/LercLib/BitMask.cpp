@@ -25,10 +25,36 @@ Contributors:  Thomas Maurer
 #include "BitMask.h"
 #include <cstring>
 
+#ifdef LERC_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__)
+#include <intrin.h>
+#endif
+
 USING_NAMESPACE_LERC
 
 // -------------------------------------------------------------------------- ;
 
+// popcnt instruction if the target has it, else the bit trick
+
+static inline int PopCount(uint64_t x)
+{
+#if defined(__POPCNT__) && (defined(__GNUC__) || defined(__clang__))
+  return __builtin_popcountll(x);
+#elif defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__)
+  return (int)__popcnt64(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// -------------------------------------------------------------------------- ;
+
 BitMask::BitMask(const BitMask& src) : m_pBits(nullptr), m_nCols(0), m_nRows(0)
 {
   SetSize(src.m_nCols, src.m_nRows);
@@ -99,18 +125,23 @@ bool BitMask::SetSize(int nCols, int nRows)
 
 int64_t BitMask::CountValidBits() const
 {
-  const Byte numBitsHB[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
   const Byte* ptr = m_pBits;
+  const size_t len = Size();
   int64_t sum = 0;
-  size_t i = Size();
-  while (i--)
+  size_t i = 0;
+
+  for (; i + 8 <= len; i += 8)
   {
-    sum += numBitsHB[*ptr & 15] + numBitsHB[*ptr >> 4];
-    ptr++;
+    uint64_t x;
+    memcpy(&x, ptr + i, sizeof(x));
+    sum += PopCount(x);
   }
 
+  for (; i < len; i++)
+    sum += PopCount(ptr[i]);
+
   // subtract undefined bits potentially contained in the last byte
-  int64_t sizeX8 = (int64_t)(Size() * 8);
+  int64_t sizeX8 = (int64_t)(len * 8);
   for (int64_t k = (int64_t)m_nCols * m_nRows; k < sizeX8; k++)
     if (IsValid(k))
       sum--;
@@ -120,6 +151,107 @@ int64_t BitMask::CountValidBits() const
 
 // -------------------------------------------------------------------------- ;
 
+// movemask gives pixel 0 in the lowest bit, the mask has it in the highest bit of each byte
+
+static inline Byte ReverseBits(Byte b)
+{
+  static const Byte rev4[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+  return (Byte)((rev4[b & 15] << 4) | rev4[b >> 4]);
+}
+
+// -------------------------------------------------------------------------- ;
+
+void BitMask::SetFromByteMask(const Byte* pByteMask)
+{
+  if (!m_pBits || !pByteMask)
+    return;
+
+  const size_t nPix = (size_t)m_nCols * m_nRows;
+  Byte* dst = m_pBits;
+  size_t k = 0;
+
+#ifdef LERC_HAVE_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for (; k + 16 <= nPix; k += 16, dst += 2)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)(pByteMask + k));
+    int m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero));    // bit set for valid
+    dst[0] = ReverseBits((Byte)m);
+    dst[1] = ReverseBits((Byte)(m >> 8));
+  }
+#endif
+
+  for (; k + 8 <= nPix; k += 8)
+  {
+    Byte b = 0;
+    for (int i = 0; i < 8; i++)
+      b |= pByteMask[k + i] ? (Byte)(0x80 >> i) : 0;
+    *dst++ = b;
+  }
+
+  if (k < nPix)    // last byte, keep the bits past the end valid
+  {
+    Byte b = 0xFF;
+    for (int i = 0; k + i < nPix; i++)
+      if (!pByteMask[k + i])
+        b &= ~(Byte)(0x80 >> i);
+    *dst = b;
+  }
+}
+
+// -------------------------------------------------------------------------- ;
+
+void BitMask::GetByteMask(Byte* pByteMask) const
+{
+  if (!m_pBits || !pByteMask)
+    return;
+
+  const size_t nPix = (size_t)m_nCols * m_nRows;
+  size_t k = 0;
+
+#ifdef LERC_HAVE_SSE2
+  const Byte* src = m_pBits;
+  const __m128i bitSel = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+  const __m128i one = _mm_set1_epi8(1);
+  for (; k + 16 <= nPix; k += 16, src += 2)
+  {
+    __m128i x = _mm_unpacklo_epi64(_mm_set1_epi8((char)src[0]), _mm_set1_epi8((char)src[1]));
+    x = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(x, bitSel), bitSel), one);
+    _mm_storeu_si128((__m128i*)(pByteMask + k), x);
+  }
+#endif
+
+  for (; k < nPix; k++)
+    pByteMask[k] = IsValid((int64_t)k);
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool BitMask::operator == (const BitMask& other) const
+{
+  if (m_nCols != other.m_nCols || m_nRows != other.m_nRows)
+    return false;
+
+  if (!m_pBits || !other.m_pBits)
+    return m_pBits == other.m_pBits;
+
+  const size_t nPix = (size_t)m_nCols * m_nRows;
+  const size_t nFull = nPix >> 3;
+
+  if (memcmp(m_pBits, other.m_pBits, nFull) != 0)
+    return false;
+
+  if (nFull < Size())    // ignore the bits past the end
+  {
+    Byte m = (Byte)(0xFF00 >> (nPix & 7));
+    return ((m_pBits[nFull] ^ other.m_pBits[nFull]) & m) == 0;
+  }
+
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
 void BitMask::Clear()
 {
   delete[] m_pBits;
@@ -27,6 +27,7 @@ Contributors:  Thomas Maurer
 #include "Defines.h"
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 NAMESPACE_LERC_START
 
@@ -69,11 +70,91 @@ public:
   int64_t CountValidBits() const;
   void Clear();
 
+  // next run [runBegin, runEnd) of valid pixels in [k, kEnd), false if none; iterate a row segment as
+  //   for (int64_t r0, r1, k = k0; bitMask.NextValidRun(k, k1, r0, r1); k = r1)
+  inline bool NextValidRun(int64_t k, int64_t kEnd, int64_t& runBegin, int64_t& runEnd) const;
+
+  // one byte per pixel, 0 is invalid, all else valid; size must be set
+  void SetFromByteMask(const Byte* pByteMask);
+  void GetByteMask(Byte* pByteMask) const;    // writes 0 or 1 per pixel
+
+  bool operator == (const BitMask& other) const;    // same size and same bits
+
 private:
   Byte*  m_pBits;
   int    m_nCols, m_nRows;
+
+  inline uint64_t Word(int64_t k) const;    // the 64 bits of the aligned word holding k, pixel 0 of it in the msb
+  inline int64_t FindNext(int64_t k, int64_t kEnd, bool bValid) const;
+
+  static inline int CountLeadingZeros(uint64_t x);    // x != 0
 };
 
+// -------------------------------------------------------------------------- ;
+
+inline uint64_t BitMask::Word(int64_t k) const
+{
+  size_t i0 = (size_t)(k >> 6) << 3, n = Size() - i0;
+  Byte b[8] = { 0 };
+  memcpy(b, m_pBits + i0, n < 8 ? n : 8);    // the last word can be short
+
+  return ((uint64_t)b[0] << 56) | ((uint64_t)b[1] << 48) | ((uint64_t)b[2] << 40) | ((uint64_t)b[3] << 32)
+    | ((uint64_t)b[4] << 24) | ((uint64_t)b[5] << 16) | ((uint64_t)b[6] << 8) | (uint64_t)b[7];
+}
+
+// -------------------------------------------------------------------------- ;
+
+inline int BitMask::CountLeadingZeros(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll(x);
+#else
+  int n = 0;
+  if (!(x >> 32)) { n += 32;  x <<= 32; }
+  if (!(x >> 48)) { n += 16;  x <<= 16; }
+  if (!(x >> 56)) { n += 8;  x <<= 8; }
+  if (!(x >> 60)) { n += 4;  x <<= 4; }
+  if (!(x >> 62)) { n += 2;  x <<= 2; }
+  if (!(x >> 63)) { n += 1; }
+  return n;
+#endif
+}
+
+// -------------------------------------------------------------------------- ;
+
+inline int64_t BitMask::FindNext(int64_t k, int64_t kEnd, bool bValid) const
+{
+  while (k < kEnd)
+  {
+    uint64_t w = Word(k);
+    if (!bValid)
+      w = ~w;
+
+    w &= ~(uint64_t)0 >> (k & 63);    // drop the bits before k
+    int64_t k0 = k & ~(int64_t)63;
+
+    if (w)
+    {
+      k = k0 + CountLeadingZeros(w);
+      return k < kEnd ? k : kEnd;
+    }
+    k = k0 + 64;
+  }
+  return kEnd;
+}
+
+// -------------------------------------------------------------------------- ;
+
+inline bool BitMask::NextValidRun(int64_t k, int64_t kEnd, int64_t& runBegin, int64_t& runEnd) const
+{
+  runBegin = FindNext(k, kEnd, true);
+  if (runBegin >= kEnd)
+    return false;
+
+  runEnd = FindNext(runBegin + 1, kEnd, false);
+  return true;
+}
+
 NAMESPACE_LERC_END
 
 #endif
@@ -259,6 +259,66 @@ bool BitStuffer2::Decode(const Byte** ppByte, size_t& nBytesRemaining, vector<un
 
 // -------------------------------------------------------------------------- ;
 
+bool BitStuffer2::Skip(const Byte** ppByte, size_t& nBytesRemaining, size_t maxElementCount, int lerc2Version)
+{
+  if (!ppByte || nBytesRemaining < 1 || lerc2Version < 3)
+    return false;
+
+  // same header parsing and checks as Decode()
+  Byte numBitsByte = **ppByte;
+  (*ppByte)++;
+  nBytesRemaining--;
+
+  int bits67 = numBitsByte >> 6;
+  int nb = (bits67 == 0) ? 4 : 3 - bits67;
+
+  bool doLut = (numBitsByte & (1 << 5)) ? true : false;    // bit 5
+  int numBits = numBitsByte & 31;    // bits 0-4;
+
+  unsigned int numElements = 0;
+  if (!DecodeUInt(ppByte, nBytesRemaining, numElements, nb))
+    return false;
+  if (numElements > maxElementCount)
+    return false;
+
+  if (!doLut)
+    return numBits == 0 || SkipBytes(ppByte, nBytesRemaining, numElements, numBits);
+
+  if (numBits == 0 || nBytesRemaining < 1)
+    return false;
+
+  int nLut = **ppByte - 1;
+  (*ppByte)++;
+  nBytesRemaining--;
+
+  if (nLut < 1 || !SkipBytes(ppByte, nBytesRemaining, nLut, numBits))
+    return false;
+
+  int nBitsLut = 0;
+  while (nLut >> nBitsLut)
+    nBitsLut++;
+
+  return SkipBytes(ppByte, nBytesRemaining, numElements, nBitsLut);
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool BitStuffer2::SkipBytes(const Byte** ppByte, size_t& nBytesRemaining, unsigned int numElements, int numBits)
+{
+  if (numElements == 0 || numBits >= 32)    // as in BitUnStuff()
+    return false;
+
+  unsigned long long numBytesLL = ((unsigned long long)numElements * numBits + 7) >> 3;
+  if (nBytesRemaining < numBytesLL)
+    return false;
+
+  *ppByte += (size_t)numBytesLL;
+  nBytesRemaining -= (size_t)numBytesLL;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
 unsigned int BitStuffer2::ComputeNumBytesNeededLut(const vector<pair<unsigned int, unsigned int> >& sortedDataVec, bool& doLut)
 {
   unsigned int maxElem = sortedDataVec.back().first;
@@ -46,6 +46,9 @@ public:
   bool EncodeLut(Byte** ppByte, const std::vector<std::pair<unsigned int, unsigned int> >& sortedDataVec, int lerc2Version) const;
   bool Decode(const Byte** ppByte, size_t& nBytesRemaining, std::vector<unsigned int>& dataVec, size_t maxElementCount, int lerc2Version) const;
 
+  // move the byte ptr past one encoded array without decoding it, lerc2Version >= 3 only
+  static bool Skip(const Byte** ppByte, size_t& nBytesRemaining, size_t maxElementCount, int lerc2Version);
+
   static unsigned int ComputeNumBytesNeededSimple(unsigned int numElem, unsigned int maxElem);
   static unsigned int ComputeNumBytesNeededLut(const std::vector<std::pair<unsigned int, unsigned int> >& sortedDataVec, bool& doLut);
 
@@ -61,6 +64,7 @@ private:
   static bool DecodeUInt(const Byte** ppByte, size_t& nBytesRemaining, unsigned int& k, int numBytes);
   static int NumBytesUInt(unsigned int k)  { return (k < 256) ? 1 : (k < (1 << 16)) ? 2 : 4; }
   static unsigned int NumTailBytesNotNeeded(unsigned int numElem, int numBits);
+  static bool SkipBytes(const Byte** ppByte, size_t& nBytesRemaining, unsigned int numElements, int numBits);
 };
 
 // -------------------------------------------------------------------------- ;
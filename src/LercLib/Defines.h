@@ -39,6 +39,11 @@ Contributors:  Thomas Maurer, Lucian Plesea
 #define HAVE_LERC1_DECODE
 //#define ENCODE_VERIFY
 
+// SSE2 versions of some inner loops (mask conversion, byte plane transpose, scans), the plain C++ ones are used otherwise
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LERC_HAVE_SSE2
+#endif
+
 NAMESPACE_LERC_START
 
 typedef unsigned char Byte;
@@ -141,6 +141,93 @@ private:
 
 // -------------------------------------------------------------------------- ;
 
+/** Byte histogram kept in 4 interleaved count tables, merged at the end.
+ *  Runs of the same value then don't stall on incrementing the same counter.
+ *  flip = 0x80 maps signed char to [0, 255], same as offset 128 in Lerc2.
+ */
+
+class ByteHisto
+{
+public:
+  ByteHisto()  { Clear(); }
+
+  void Clear()  { memset(m_cnt, 0, sizeof(m_cnt)); }
+
+  // every step'th value of data[0 .. len - 1]
+  inline void Add(const Byte* data, size_t len, size_t step = 1, Byte flip = 0);
+
+  // plain histo of data[i] into this, histo of data[i] - pred[i] into deltaHisto, same pass
+  inline void AddWithDelta(ByteHisto& deltaHisto, const Byte* data, const Byte* pred, size_t len, Byte flip = 0);
+
+  void AddOne(Byte val)  { m_cnt[0][val]++; }
+
+  unsigned int GetCount(int i) const  { return m_cnt[0][i] + m_cnt[1][i] + m_cnt[2][i] + m_cnt[3][i]; }
+  inline void GetHisto(std::vector<int>& histo) const;
+
+private:
+  unsigned int m_cnt[4][256];
+};
+
+// -------------------------------------------------------------------------- ;
+
+inline void ByteHisto::Add(const Byte* data, size_t len, size_t step, Byte flip)
+{
+  if (!data || !len || !step)
+    return;
+
+  size_t num = (len + step - 1) / step, k = 0;
+  const Byte* p = data;
+
+  for (; k + 4 <= num; k += 4, p += 4 * step)
+  {
+    m_cnt[0][p[0] ^ flip]++;
+    m_cnt[1][p[step] ^ flip]++;
+    m_cnt[2][p[2 * step] ^ flip]++;
+    m_cnt[3][p[3 * step] ^ flip]++;
+  }
+
+  for (; k < num; k++, p += step)
+    m_cnt[0][*p ^ flip]++;
+}
+
+// -------------------------------------------------------------------------- ;
+
+inline void ByteHisto::AddWithDelta(ByteHisto& deltaHisto, const Byte* data, const Byte* pred, size_t len, Byte flip)
+{
+  unsigned int (*dCnt)[256] = deltaHisto.m_cnt;
+  size_t i = 0;
+
+  for (; i + 4 <= len; i += 4)
+  {
+    m_cnt[0][data[i    ] ^ flip]++;
+    m_cnt[1][data[i + 1] ^ flip]++;
+    m_cnt[2][data[i + 2] ^ flip]++;
+    m_cnt[3][data[i + 3] ^ flip]++;
+
+    dCnt[0][(Byte)(data[i    ] - pred[i    ]) ^ flip]++;    // use overflow
+    dCnt[1][(Byte)(data[i + 1] - pred[i + 1]) ^ flip]++;
+    dCnt[2][(Byte)(data[i + 2] - pred[i + 2]) ^ flip]++;
+    dCnt[3][(Byte)(data[i + 3] - pred[i + 3]) ^ flip]++;
+  }
+
+  for (; i < len; i++)
+  {
+    m_cnt[0][data[i] ^ flip]++;
+    dCnt[0][(Byte)(data[i] - pred[i]) ^ flip]++;
+  }
+}
+
+// -------------------------------------------------------------------------- ;
+
+inline void ByteHisto::GetHisto(std::vector<int>& histo) const
+{
+  histo.resize(256);
+  for (int i = 0; i < 256; i++)
+    histo[i] = (int)GetCount(i);
+}
+
+// -------------------------------------------------------------------------- ;
+
 inline bool Huffman::DecodeOneValue(const Byte** ppSrc, size_t& nBytesRemaining, int& bitPos, int numBitsLUT, int& value) const
 {
   const size_t s4 = sizeof(unsigned int);
@@ -24,11 +24,18 @@ Contributors:  Thomas Maurer
 #include "Defines.h"
 #include "Lerc.h"
 #include "Lerc2.h"
+#include "Stats.h"
+#include "Trace.h"
+#include <algorithm>
 #include <cstring>
 #include <functional>
 #include <limits>
 #include <typeinfo>
 
+#ifdef LERC_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifdef HAVE_LERC1_DECODE
   #include "Lerc1Decode/CntZImage.h"
 #endif
@@ -39,9 +46,10 @@ USING_NAMESPACE_LERC
 // -------------------------------------------------------------------------- ;
 
 ErrCode Lerc::ComputeCompressedSize(const void* pData, int version, DataType dt, int nDepth, int nCols, int nRows, int nBands,
-  int nMasks, const Byte* pValidBytes, double maxZErr, unsigned int& numBytesNeeded, const unsigned char* pUsesNoData, const double* noDataValues)
+  int nMasks, const Byte* pValidBytes, double maxZErr, unsigned int& numBytesNeeded, const unsigned char* pUsesNoData, const double* noDataValues,
+  const EncodeOptions* pOptions)
 {
-#define LERC_ARG_1 version, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr, numBytesNeeded, pUsesNoData, noDataValues
+#define LERC_ARG_1 version, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr, numBytesNeeded, pUsesNoData, noDataValues, pOptions
 
   switch (dt)
   {
@@ -65,9 +73,9 @@ ErrCode Lerc::ComputeCompressedSize(const void* pData, int version, DataType dt,
 
 ErrCode Lerc::Encode(const void* pData, int version, DataType dt, int nDepth, int nCols, int nRows, int nBands,
   int nMasks, const Byte* pValidBytes, double maxZErr, Byte* pBuffer, unsigned int numBytesBuffer,
-  unsigned int& numBytesWritten, const unsigned char* pUsesNoData, const double* noDataValues)
+  unsigned int& numBytesWritten, const unsigned char* pUsesNoData, const double* noDataValues, const EncodeOptions* pOptions)
 {
-#define LERC_ARG_2 version, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr, pBuffer, numBytesBuffer, numBytesWritten, pUsesNoData, noDataValues
+#define LERC_ARG_2 version, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr, pBuffer, numBytesBuffer, numBytesWritten, pUsesNoData, noDataValues, pOptions
 
   switch (dt)
   {
@@ -89,6 +97,72 @@ ErrCode Lerc::Encode(const void* pData, int version, DataType dt, int nDepth, in
 
 // -------------------------------------------------------------------------- ;
 
+ErrCode Lerc::ComputeCompressBound(DataType dt, int nDepth, int nCols, int nRows, int nBands, unsigned int& numBytesBound)
+{
+  numBytesBound = 0;
+
+  if (dt < DT_Char || dt >= DT_Undefined || nDepth <= 0 || nCols <= 0 || nRows <= 0 || nBands <= 0)
+    return ErrCode::WrongParam;
+
+  const size_t sizeOfType[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+  if (!CheckDimensions(nDepth, nCols, nRows, sizeOfType[dt]))
+    return ErrCode::DimensionsTooLarge;
+
+  uint64_t nBytesBand = Lerc2::ComputeNumBytesUpperBound(nDepth, nCols, nRows, (Lerc2::DataType)dt);
+  if (!nBytesBand)
+    return ErrCode::Failed;
+
+  // Encode() fails on a band blob > 2 GB or a total blob > 4 GB, so clamping to these is still a bound
+  nBytesBand = std::min(nBytesBand, (uint64_t)INT_MAX);
+  numBytesBound = (unsigned int)std::min(nBytesBand * nBands, (uint64_t)UINT_MAX);
+
+  return ErrCode::Ok;
+}
+
+// -------------------------------------------------------------------------- ;
+
+ErrCode Lerc::GetEncodeOptions(const int* pOptionsArr, int nOptions, EncodeOptions& options)
+{
+  if ((!pOptionsArr && nOptions > 0) || nOptions < 0)
+    return ErrCode::WrongParam;
+
+  EncodeOptions opt = options;
+
+  for (int i = 0; i < std::min(nOptions, (int)EncodeOptionsArrOrder::_last); i++)
+  {
+    const int val = pOptionsArr[i];
+
+    switch ((EncodeOptionsArrOrder)i)
+    {
+    case EncodeOptionsArrOrder::dropNoisyBitPlanes:
+      if (val < 0 || val > 1)
+        return ErrCode::WrongParam;
+      opt.bDropNoisyBitPlanes = (val == 1);
+      break;
+
+    case EncodeOptionsArrOrder::bitPlaneRowStep:
+      if (val < 1)
+        return ErrCode::WrongParam;
+      opt.bitPlaneRowStep = val;
+      break;
+
+    case EncodeOptionsArrOrder::microBlockSizeSearch:
+      if (val < 0 || val > 1)
+        return ErrCode::WrongParam;
+      opt.bMicroBlockSizeSearch = (val == 1);
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  options = opt;
+  return ErrCode::Ok;
+}
+
+// -------------------------------------------------------------------------- ;
+
 ErrCode Lerc::GetLercInfo(const Byte* pLercBlob, unsigned int numBytesBlob, struct LercInfo& lercInfo, double* pMins, double* pMaxs, size_t nElem)
 {
   lercInfo.RawInit();
@@ -223,30 +297,34 @@ ErrCode Lerc::GetLercInfo(const Byte* pLercBlob, unsigned int numBytesBlob, stru
 
     pByte = pLercBlob;
     bool onlyZPart = false;
+    std::vector<float> zVec;
+    BitMask bitMask;
+
+    if (!Resize(zVec, (size_t)width * height))
+      return ErrCode::Failed;
 
     while (lercInfo.blobSize + numBytesHeaderBand1 < numBytesBlob)    // means there could be another band
     {
-      if (!cntZImg.read(&pByte, pLercBlob + numBytesBlob, 1e12, false, onlyZPart))
+      if (!cntZImg.read(&pByte, pLercBlob + numBytesBlob, 1e12, zVec.data(), bitMask, onlyZPart))
         return (lercInfo.nBands > 0) ? ErrCode::Ok : ErrCode::Failed;    // no other band, we are done
 
       onlyZPart = true;
       lercInfo.blobSize = (int)(pByte - pLercBlob);
 
       // now that we have decoded it, we can go the extra mile and collect some extra info
-      int numValidPixels = 0;
+      int numValidPixels = (int)bitMask.CountValidBits();
       float zMin =  FLT_MAX;
       float zMax = -FLT_MAX;
 
-      for (int i = 0; i < height; i++)
+      int64_t k0 = 0, k1 = 0;
+      for (int64_t k = 0, kEnd = (int64_t)width * height; bitMask.NextValidRun(k, kEnd, k0, k1); k = k1)
       {
-        for (int j = 0; j < width; j++)
-          if (cntZImg(i, j).cnt > 0)
-          {
-            numValidPixels++;
-            float z = cntZImg(i, j).z;
-            zMax = max(zMax, z);
-            zMin = min(zMin, z);
-          }
+        for (int64_t m = k0; m < k1; m++)
+        {
+          float z = zVec[m];
+          zMax = max(zMax, z);
+          zMin = min(zMin, z);
+        }
       }
 
       lercInfo.numValidPixel = numValidPixels;
@@ -315,14 +393,27 @@ ErrCode Lerc::ConvertToDouble(const void* pDataIn, DataType dt, size_t nDataValu
   }
 }
 
+// -------------------------------------------------------------------------- ;
+
+bool Lerc::ApplyEncodeOptions(const EncodeOptions* pOptions, Lerc2& lerc2)
+{
+  if (!pOptions)
+    return true;
+
+  return lerc2.SetDropNoisyBitPlanes(pOptions->bDropNoisyBitPlanes)
+    && lerc2.SetBitPlaneSampling(pOptions->bitPlaneRowStep)
+    && lerc2.SetMicroBlockSizeSearch(pOptions->bMicroBlockSizeSearch);
+}
+
 // -------------------------------------------------------------------------- ;
 // -------------------------------------------------------------------------- ;
 
 template<class T>
 ErrCode Lerc::ComputeCompressedSizeTempl(const T* pData, int version, int nDepth, int nCols, int nRows,
   int nBands, int nMasks, const Byte* pValidBytes, double maxZErr, unsigned int& numBytesNeeded,
-  const unsigned char* pUsesNoData, const double* noDataValues)
+  const unsigned char* pUsesNoData, const double* noDataValues, const EncodeOptions* pOptions)
 {
+  Stats::Scope statsScope;
   numBytesNeeded = 0;
 
   if (!pData || nDepth <= 0 || nCols <= 0 || nRows <= 0 || nBands <= 0 || maxZErr < 0)
@@ -344,12 +435,12 @@ ErrCode Lerc::ComputeCompressedSizeTempl(const T* pData, int version, int nDepth
           return ErrCode::WrongParam;
 
     return EncodeInternal_v5(pData, version, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr,
-      numBytesNeeded, nullptr, 0, numBytesWritten);
+      numBytesNeeded, nullptr, 0, numBytesWritten, pOptions);
   }
   else
   {
     return EncodeInternal(pData, version, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr,
-      numBytesNeeded, nullptr, 0, numBytesWritten, pUsesNoData, noDataValues);
+      numBytesNeeded, nullptr, 0, numBytesWritten, pUsesNoData, noDataValues, pOptions);
   }
 }
 
@@ -358,8 +449,9 @@ ErrCode Lerc::ComputeCompressedSizeTempl(const T* pData, int version, int nDepth
 template<class T>
 ErrCode Lerc::EncodeTempl(const T* pData, int version, int nDepth, int nCols, int nRows, int nBands,
   int nMasks, const Byte* pValidBytes, double maxZErr, Byte* pBuffer, unsigned int numBytesBuffer,
-  unsigned int& numBytesWritten, const unsigned char* pUsesNoData, const double* noDataValues)
+  unsigned int& numBytesWritten, const unsigned char* pUsesNoData, const double* noDataValues, const EncodeOptions* pOptions)
 {
+  Stats::Scope statsScope;
   numBytesWritten = 0;
 
   if (!pData || nDepth <= 0 || nCols <= 0 || nRows <= 0 || nBands <= 0 || maxZErr < 0 || !pBuffer || !numBytesBuffer)
@@ -383,12 +475,12 @@ ErrCode Lerc::EncodeTempl(const T* pData, int version, int nDepth, int nCols, in
           return ErrCode::WrongParam;
 
     return EncodeInternal_v5(pData, version, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr,
-      numBytesNeeded, pBuffer, numBytesBuffer, numBytesWritten);
+      numBytesNeeded, pBuffer, numBytesBuffer, numBytesWritten, pOptions);
   }
   else
   {
     return EncodeInternal(pData, version, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr,
-      numBytesNeeded, pBuffer, numBytesBuffer, numBytesWritten, pUsesNoData, noDataValues);
+      numBytesNeeded, pBuffer, numBytesBuffer, numBytesWritten, pUsesNoData, noDataValues, pOptions);
   }
 }
 
@@ -399,6 +491,9 @@ ErrCode Lerc::DecodeTempl(T* pData, const Byte* pLercBlob, unsigned int numBytes
   int nDepth, int nCols, int nRows, int nBands, int nMasks, Byte* pValidBytes,
   unsigned char* pUsesNoData, double* noDataValues)
 {
+  Stats::Scope statsScope;
+  LERC_TRACE_SCOPE("Lerc::Decode");
+
   if (!pData || nDepth <= 0 || nCols <= 0 || nRows <= 0 || nBands <= 0 || !pLercBlob || !numBytesBlob)
     return ErrCode::WrongParam;
 
@@ -450,6 +545,8 @@ ErrCode Lerc::DecodeTempl(T* pData, const Byte* pLercBlob, unsigned int numBytes
 
     for (int iBand = 0; iBand < nBands; iBand++)
     {
+      LERC_TRACE_SCOPE_ARG("Lerc::Decode band", "band", iBand);
+
       if (((size_t)(pByte - pLercBlob) < numBytesBlob) && Lerc2::GetHeaderInfo(pByte, nBytesRemaining, hdInfo, bHasMask))
       {
         if (hdInfo.nDepth != nDepth || hdInfo.nCols != nCols || hdInfo.nRows != nRows || hdInfo.blobSize < 0)
@@ -491,6 +588,7 @@ ErrCode Lerc::DecodeTempl(T* pData, const Byte* pLercBlob, unsigned int numBytes
     unsigned int numBytesHeaderBand1 = CntZImage::computeNumBytesNeededToReadHeader(true);
     const Byte* pByte1 = pLercBlob;
     CntZImage zImg;
+    BitMask bitMask;
 
     for (int iBand = 0; iBand < nBands; iBand++)
     {
@@ -498,18 +596,23 @@ ErrCode Lerc::DecodeTempl(T* pData, const Byte* pLercBlob, unsigned int numBytes
       if ((size_t)(pByte1 - pLercBlob) + numBytesHeader > numBytesBlob)  // corrupted blob or wrong nBands
         return ErrCode::Failed;
 
+      size_t nPix = (size_t)iBand * nRows * nCols;
+      T* arr = pData + nPix;
+
+      // decode straight into arr, only the valid pixels get written
       bool onlyZPart = iBand > 0;
-      if (!zImg.read(&pByte1, pLercBlob + numBytesBlob, 1e12, false, onlyZPart))
+      if (!zImg.read(&pByte1, pLercBlob + numBytesBlob, 1e12, arr, bitMask, onlyZPart))
         return ErrCode::Failed;
 
-      if (zImg.getWidth() != nCols || zImg.getHeight() != nRows)
+      if (bitMask.GetWidth() != nCols || bitMask.GetHeight() != nRows)
         return ErrCode::Failed;
 
-      size_t nPix = (size_t)iBand * nRows * nCols;
-      T* arr = pData + nPix;
-      Byte* pDst = iBand < nMasks ? pValidBytes + nPix : nullptr;
-
-      if (!Convert(zImg, arr, pDst, iBand == 0))
+      if (iBand < nMasks)
+      {
+        if (!Convert(bitMask, pValidBytes + nPix))
+          return ErrCode::Failed;
+      }
+      else if (iBand == 0 && bitMask.CountValidBits() < (int64_t)nRows * nCols)    // invalid pixels but no mask to pass them
         return ErrCode::Failed;
     }
 #else
@@ -526,8 +629,10 @@ ErrCode Lerc::DecodeTempl(T* pData, const Byte* pLercBlob, unsigned int numBytes
 template<class T>
 ErrCode Lerc::EncodeInternal_v5(const T* pData, int version, int nDepth, int nCols, int nRows, int nBands,
   int nMasks, const Byte* pValidBytes, double maxZErr, unsigned int& numBytesNeeded,
-  Byte* pBuffer, unsigned int numBytesBuffer, unsigned int& numBytesWritten)
+  Byte* pBuffer, unsigned int numBytesBuffer, unsigned int& numBytesWritten, const EncodeOptions* pOptions)
 {
+  LERC_TRACE_SCOPE("Lerc::EncodeInternal_v5");
+
   numBytesNeeded = 0;
   numBytesWritten = 0;
 
@@ -535,6 +640,9 @@ ErrCode Lerc::EncodeInternal_v5(const T* pData, int version, int nDepth, int nCo
   if (version >= 0 && !lerc2.SetEncoderToOldVersion(version))
     return ErrCode::WrongParam;
 
+  if (!ApplyEncodeOptions(pOptions, lerc2))
+    return ErrCode::WrongParam;
+
   Byte* pDst = pBuffer;
 
   const size_t nPix = (size_t)nCols * nRows;
@@ -548,6 +656,8 @@ ErrCode Lerc::EncodeInternal_v5(const T* pData, int version, int nDepth, int nCo
   // loop over the bands
   for (int iBand = 0; iBand < nBands; iBand++)
   {
+    LERC_TRACE_SCOPE_ARG("Lerc::Encode band", "band", iBand);
+
     bool bEncMsk = (iBand == 0);
 
     // using the proper section of valid bytes, check this band for NaN
@@ -629,8 +739,10 @@ template<class T>
 ErrCode Lerc::EncodeInternal(const T* pData, int version, int nDepth, int nCols, int nRows, int nBands,
   int nMasks, const Byte* pValidBytes, double maxZErr, unsigned int& numBytesNeeded,
   Byte* pBuffer, unsigned int numBytesBuffer, unsigned int& numBytesWritten,
-  const unsigned char* pUsesNoData, const double* noDataValues)
+  const unsigned char* pUsesNoData, const double* noDataValues, const EncodeOptions* pOptions)
 {
+  LERC_TRACE_SCOPE("Lerc::EncodeInternal");
+
   numBytesNeeded = 0;
   numBytesWritten = 0;
 
@@ -646,6 +758,9 @@ ErrCode Lerc::EncodeInternal(const T* pData, int version, int nDepth, int nCols,
   if (version >= 0 && !lerc2.SetEncoderToOldVersion(version))
     return ErrCode::WrongParam;
 
+  if (!ApplyEncodeOptions(pOptions, lerc2))
+    return ErrCode::WrongParam;
+
   if (pUsesNoData && !noDataValues)
     for (int i = 0; i < nBands; i++)
       if (pUsesNoData[i])
@@ -656,10 +771,9 @@ ErrCode Lerc::EncodeInternal(const T* pData, int version, int nDepth, int nCols,
   const size_t nPix = (size_t)nCols * nRows;
   const size_t nElem = nPix * nDepth;
 
-  const Byte* pPrevByteMask = nullptr;
   vector<T> dataBuffer;
-  vector<Byte> maskBuffer, prevMaskBuffer;
-  BitMask bitMask;
+  vector<Byte> maskBuffer;
+  BitMask bitMask, prevBitMask;
 
   // allocate buffer for 1 band
   if (!Resize(dataBuffer, nElem) || !Resize(maskBuffer, nPix))
@@ -672,6 +786,8 @@ ErrCode Lerc::EncodeInternal(const T* pData, int version, int nDepth, int nCols,
   // loop over the bands
   for (int iBand = 0; iBand < nBands; iBand++)
   {
+    LERC_TRACE_SCOPE_ARG("Lerc::Encode band", "band", iBand);
+
     bool bEncMsk = (iBand == 0);
 
     // get the data and mask for this band
@@ -716,28 +832,28 @@ ErrCode Lerc::EncodeInternal(const T* pData, int version, int nDepth, int nCols,
 
     bool bCompareMasks = (nMasks > 1) || bAnyMaskModified;
 
-    if (bCompareMasks && (iBand > 0) && MasksDiffer(&maskBuffer[0], pPrevByteMask, nPix))
-      bEncMsk = true;
+    const T* arrL = &dataBuffer[0];
+    const Byte* pByteMaskL = &maskBuffer[0];
 
-    if (nBands > 1 && iBand < nBands - 1)
+    // if not compared, the mask is the same as for the previous band
+    if (bEncMsk || bCompareMasks)
     {
-      // keep current mask as new previous band mask
-      prevMaskBuffer = maskBuffer;
-      pPrevByteMask = &prevMaskBuffer[0];
-    }
+      if (!Convert(pByteMaskL, nCols, nRows, bitMask))
+        return ErrCode::Failed;
 
-    const T* arrL = &dataBuffer[0];
-    const Byte* pByteMaskL = &maskBuffer[0];
+      if (iBand > 0 && !(bitMask == prevBitMask))    // compare the packed bits
+        bEncMsk = true;
+    }
 
     if (bEncMsk)
     {
-      bool bAllValid = !memchr(pByteMaskL, 0, nPix);
-
-      if (!bAllValid && !Convert(pByteMaskL, nCols, nRows, bitMask))
-        return ErrCode::Failed;
+      bool bAllValid = (bitMask.CountValidBits() == (int64_t)nPix);
 
       if (!lerc2.Set(nDepth, nCols, nRows, !bAllValid ? bitMask.Bits() : nullptr))
         return ErrCode::Failed;
+
+      if (iBand < nBands - 1)
+        prevBitMask = bitMask;    // keep current mask as new previous band mask
     }
 
     // set other flags
@@ -790,60 +906,6 @@ ErrCode Lerc::EncodeInternal(const T* pData, int version, int nDepth, int nCols,
 
 // -------------------------------------------------------------------------- ;
 
-#ifdef HAVE_LERC1_DECODE
-template<class T>
-bool Lerc::Convert(const CntZImage& zImg, T* arr, Byte* pByteMask, bool bMustFillMask)
-{
-  if (!arr || !zImg.getSize())
-    return false;
-
-  const bool fltPnt = (typeid(*arr) == typeid(double)) || (typeid(*arr) == typeid(float));
-
-  int h = zImg.getHeight();
-  int w = zImg.getWidth();
-
-  const CntZ* srcPtr = zImg.getData();
-  T* dstPtr = arr;
-  int num = w * h;
-
-  if (pByteMask)
-  {
-    memset(pByteMask, 0, num);
-
-    for (int k = 0; k < num; k++)
-    {
-      if (srcPtr->cnt > 0)
-      {
-        *dstPtr = fltPnt ? (T)srcPtr->z : (T)floor(srcPtr->z + 0.5);
-        pByteMask[k] = 1;
-      }
-
-      srcPtr++;
-      dstPtr++;
-    }
-  }
-  else
-  {
-    for (int k = 0; k < num; k++)
-    {
-      if (srcPtr->cnt > 0)
-      {
-        *dstPtr = fltPnt ? (T)srcPtr->z : (T)floor(srcPtr->z + 0.5);
-      }
-      else if (bMustFillMask)
-        return false;
-
-      srcPtr++;
-      dstPtr++;
-    }
-  }
-
-  return true;
-}
-#endif
-
-// -------------------------------------------------------------------------- ;
-
 template<class T>
 ErrCode Lerc::ConvertToDoubleTempl(const T* pDataIn, size_t nDataValues, double* pDataOut)
 {
@@ -860,6 +922,9 @@ ErrCode Lerc::ConvertToDoubleTempl(const T* pDataIn, size_t nDataValues, double*
 
 template<class T> ErrCode Lerc::CheckForNaN(const T* arr, int nDepth, int nCols, int nRows, const Byte* pByteMask)
 {
+  Stats::Timer timer(StatsArrOrder::msCheckForNaN);
+  LERC_TRACE_SCOPE("Lerc::CheckForNaN");
+
   if (!arr || nDepth <= 0 || nCols <= 0 || nRows <= 0)
     return ErrCode::WrongParam;
 
@@ -873,20 +938,22 @@ template<class T> ErrCode Lerc::CheckForNaN(const T* arr, int nDepth, int nCols,
 
     if (!pByteMask)    // all valid
     {
-      size_t num = (size_t)nCols * nDepth;
-      for (size_t m = 0; m < num; m++)
-        if (std::isnan((double)rowArr[m]))
-          bFoundNaN = true;
+      bFoundNaN = ContainsNaN(rowArr, (size_t)nCols * nDepth);
     }
     else    // not all valid
     {
-      for (size_t n = 0, j = 0; j < (size_t)nCols; j++, k++, n += nDepth)
-        if (pByteMask[k])
-        {
-          for (int m = 0; m < nDepth; m++)
-            if (std::isnan((double)rowArr[n + m]))
-              bFoundNaN = true;
-        }
+      for (size_t j = 0; j < (size_t)nCols && !bFoundNaN; )    // runs of valid pixels
+      {
+        size_t j1 = j;
+        while (j1 < (size_t)nCols && pByteMask[k + j1])
+          j1++;
+
+        if (j1 > j)
+          bFoundNaN = ContainsNaN(rowArr + j * nDepth, (j1 - j) * nDepth);
+
+        j = j1 + 1;
+      }
+      k += nCols;
     }
 
     if (bFoundNaN)
@@ -964,13 +1031,7 @@ bool Lerc::Convert(const Byte* pByteMask, int nCols, int nRows, BitMask& bitMask
   if (!bitMask.SetSize(nCols, nRows))
     return false;
 
-  bitMask.SetAllValid();
-
-  for (int k = 0, i = 0; i < nRows; i++)
-    for (int j = 0; j < nCols; j++, k++)
-      if (!pByteMask[k])
-        bitMask.SetInvalid(k);
-
+  bitMask.SetFromByteMask(pByteMask);
   return true;
 }
 
@@ -984,13 +1045,7 @@ bool Lerc::Convert(const BitMask& bitMask, Byte* pByteMask)
   if (nCols <= 0 || nRows <= 0 || !pByteMask)
     return false;
 
-  memset(pByteMask, 0, (size_t)nCols * nRows);
-
-  for (int k = 0, i = 0; i < nRows; i++)
-    for (int j = 0; j < nCols; j++, k++)
-      if (bitMask.IsValid(k))
-        pByteMask[k] = 1;
-
+  bitMask.GetByteMask(pByteMask);
   return true;
 }
 
@@ -1243,6 +1298,9 @@ ErrCode Lerc::FilterNoData(std::vector<T>& dataBuffer, std::vector<Byte>& maskBu
   double& maxZError, bool bPassNoDataValue, double& noDataValue, bool& bModifiedMask, bool& bNeedNoData,
   double& minValA, double& maxValA)
 {
+  Stats::Timer timer(StatsArrOrder::msFilterNoData);
+  LERC_TRACE_SCOPE("Lerc::FilterNoData");
+
   if (nDepth <= 0 || nCols <= 0 || nRows <= 0 || maxZError < 0)
     return ErrCode::WrongParam;
 
@@ -1375,11 +1433,237 @@ ErrCode Lerc::FilterNoData(std::vector<T>& dataBuffer, std::vector<Byte>& maskBu
 
 // -------------------------------------------------------------------------- ;
 
+bool Lerc::ScanValidValues(const float* p, size_t n, bool bCheckNoData, float noData, double& minValA, double& maxValA, bool& bAllIntA)
+{
+  if (!p || !n)
+    return true;
+
+  float zMin = p[0], zMax = p[0];
+  bool bAllInt = bAllIntA;
+  size_t i = 0;
+
+#ifdef LERC_HAVE_SSE2
+  if (n >= 4)
+  {
+    const __m128 vNoData = _mm_set1_ps(noData);
+    const __m128 vAbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 vBig = _mm_set1_ps((float)(1 << 23));    // float values from here on are all int
+    __m128 vMin = _mm_loadu_ps(p), vMax = vMin, vSpecial = _mm_setzero_ps(), vIsInt = _mm_cmpeq_ps(vMin, vMin);
+
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128 x = _mm_loadu_ps(p + i);
+      vSpecial = _mm_or_ps(vSpecial, _mm_cmpunord_ps(x, x));
+      if (bCheckNoData)
+        vSpecial = _mm_or_ps(vSpecial, _mm_cmpeq_ps(x, vNoData));
+
+      vMin = _mm_min_ps(vMin, x);
+      vMax = _mm_max_ps(vMax, x);
+
+      __m128 xInt = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+      vIsInt = _mm_and_ps(vIsInt, _mm_or_ps(_mm_cmpeq_ps(xInt, x), _mm_cmpge_ps(_mm_and_ps(x, vAbsMask), vBig)));
+    }
+
+    if (_mm_movemask_ps(vSpecial))
+      return false;
+
+    if (_mm_movemask_ps(vIsInt) != 15)
+      bAllInt = false;
+
+    float arrMin[4], arrMax[4];
+    _mm_storeu_ps(arrMin, vMin);
+    _mm_storeu_ps(arrMax, vMax);
+    for (int m = 0; m < 4; m++)
+    {
+      zMin = std::min(zMin, arrMin[m]);
+      zMax = std::max(zMax, arrMax[m]);
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    float z = p[i];
+    if (std::isnan(z) || (bCheckNoData && z == noData))
+      return false;
+
+    if (z < zMin)
+      zMin = z;
+    if (z > zMax)
+      zMax = z;
+
+    if (bAllInt && !IsInt(z))
+      bAllInt = false;
+  }
+
+  // -0 and 0 compare equal, take the first one found as the pixel loop would
+  if (zMin == 0 || zMax == 0)
+  {
+    const float* pZero = std::find(p, p + n, 0.0f);
+    if (zMin == 0)
+      zMin = *pZero;
+    if (zMax == 0)
+      zMax = *pZero;
+  }
+
+  if (zMin < minValA)
+    minValA = zMin;
+  if (zMax > maxValA)
+    maxValA = zMax;
+
+  bAllIntA = bAllInt;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool Lerc::ScanValidValues(const double* p, size_t n, bool bCheckNoData, double noData, double& minValA, double& maxValA, bool& bAllIntA)
+{
+  if (!p || !n)
+    return true;
+
+  double zMin = p[0], zMax = p[0];
+  bool bAllInt = bAllIntA;
+  size_t i = 0;
+
+#ifdef LERC_HAVE_SSE2
+  if (n >= 2)
+  {
+    const __m128d vNoData = _mm_set1_pd(noData);
+    const __m128d vAbsMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const __m128d vBig = _mm_set1_pd((double)((int64_t)1 << 52));    // adding it rounds to int below it
+    __m128d vMin = _mm_loadu_pd(p), vMax = vMin, vSpecial = _mm_setzero_pd(), vIsInt = _mm_cmpeq_pd(vMin, vMin);
+    __m128d vAnyBig = _mm_setzero_pd();
+
+    for (; i + 2 <= n; i += 2)
+    {
+      __m128d x = _mm_loadu_pd(p + i);
+      vSpecial = _mm_or_pd(vSpecial, _mm_cmpunord_pd(x, x));
+      if (bCheckNoData)
+        vSpecial = _mm_or_pd(vSpecial, _mm_cmpeq_pd(x, vNoData));
+
+      vMin = _mm_min_pd(vMin, x);
+      vMax = _mm_max_pd(vMax, x);
+
+      __m128d t = _mm_and_pd(x, vAbsMask);
+      vIsInt = _mm_and_pd(vIsInt, _mm_cmpeq_pd(_mm_sub_pd(_mm_add_pd(t, vBig), vBig), t));
+      vAnyBig = _mm_or_pd(vAnyBig, _mm_cmpge_pd(t, vBig));
+    }
+
+    if (_mm_movemask_pd(vSpecial))
+      return false;
+
+    if (_mm_movemask_pd(vAnyBig))    // IsInt() has its own rules up there, use it
+    {
+      for (size_t m = 0; m < i && bAllInt; m++)
+        bAllInt = IsInt(p[m]);
+    }
+    else if (_mm_movemask_pd(vIsInt) != 3)
+      bAllInt = false;
+
+    double arrMin[2], arrMax[2];
+    _mm_storeu_pd(arrMin, vMin);
+    _mm_storeu_pd(arrMax, vMax);
+    for (int m = 0; m < 2; m++)
+    {
+      zMin = std::min(zMin, arrMin[m]);
+      zMax = std::max(zMax, arrMax[m]);
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    double z = p[i];
+    if (std::isnan(z) || (bCheckNoData && z == noData))
+      return false;
+
+    if (z < zMin)
+      zMin = z;
+    if (z > zMax)
+      zMax = z;
+
+    if (bAllInt && !IsInt(z))
+      bAllInt = false;
+  }
+
+  // -0 and 0 compare equal, take the first one found as the pixel loop would
+  if (zMin == 0 || zMax == 0)
+  {
+    const double* pZero = std::find(p, p + n, 0.0);
+    if (zMin == 0)
+      zMin = *pZero;
+    if (zMax == 0)
+      zMax = *pZero;
+  }
+
+  if (zMin < minValA)
+    minValA = zMin;
+  if (zMax > maxValA)
+    maxValA = zMax;
+
+  bAllIntA = bAllInt;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool Lerc::ContainsNaN(const float* p, size_t n)
+{
+  size_t i = 0;
+
+#ifdef LERC_HAVE_SSE2
+  __m128 vNaN = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(p + i);
+    vNaN = _mm_or_ps(vNaN, _mm_cmpunord_ps(x, x));
+  }
+  if (_mm_movemask_ps(vNaN))
+    return true;
+#endif
+
+  for (; i < n; i++)
+    if (std::isnan(p[i]))
+      return true;
+
+  return false;
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool Lerc::ContainsNaN(const double* p, size_t n)
+{
+  size_t i = 0;
+
+#ifdef LERC_HAVE_SSE2
+  __m128d vNaN = _mm_setzero_pd();
+  for (; i + 2 <= n; i += 2)
+  {
+    __m128d x = _mm_loadu_pd(p + i);
+    vNaN = _mm_or_pd(vNaN, _mm_cmpunord_pd(x, x));
+  }
+  if (_mm_movemask_pd(vNaN))
+    return true;
+#endif
+
+  for (; i < n; i++)
+    if (std::isnan(p[i]))
+      return true;
+
+  return false;
+}
+
+// -------------------------------------------------------------------------- ;
+
 template<class T>
 ErrCode Lerc::FilterNoDataAndNaN(std::vector<T>& dataBuffer, std::vector<Byte>& maskBuffer, int nDepth, int nCols, int nRows,
   double& maxZError, bool bPassNoDataValue, double& noDataValue, bool& bModifiedMask, bool& bNeedNoData, bool& bIsFltDblAllInt,
   double& minValA, double& maxValA)
 {
+  Stats::Timer timer(StatsArrOrder::msFilterNoData);
+  LERC_TRACE_SCOPE("Lerc::FilterNoDataAndNaN");
+
   if (nDepth <= 0 || nCols <= 0 || nRows <= 0 || maxZError < 0)
     return ErrCode::WrongParam;
 
@@ -1418,12 +1702,28 @@ ErrCode Lerc::FilterNoDataAndNaN(std::vector<T>& dataBuffer, std::vector<Byte>&
   double maxVal = -DBL_MAX;
 
   // check for NaN or noData in valid pixels
-  for (int k = 0, i = 0; i < nRows; i++)
+  for (int k = 0, i = 0; i < nRows; i++, k += nCols)
   {
     T* rowArr = &(dataBuffer[(size_t)i * nCols * nDepth]);
 
-    for (int n = 0, j = 0; j < nCols; j++, k++, n += nDepth)
-      if (maskBuffer[k])
+    for (int j0 = 0; j0 < nCols; )
+    {
+      // next run [j0, j1) of valid pixels
+      while (j0 < nCols && !maskBuffer[k + j0])
+        j0++;
+
+      int j1 = j0;
+      while (j1 < nCols && maskBuffer[k + j1])
+        j1++;
+
+      if (j1 == j0)
+        break;
+
+      // fast path if there is nothing to filter, else go pixel by pixel
+      bool bDone = ScanValidValues(rowArr + (size_t)j0 * nDepth, (size_t)(j1 - j0) * nDepth, bPassNoDataValue, origNoData,
+        minVal, maxVal, bAllInt);
+
+      for (int n = j0 * nDepth, j = j0; j < j1 && !bDone; j++, n += nDepth)
       {
         int cntInvalidValues = 0;
 
@@ -1459,12 +1759,15 @@ ErrCode Lerc::FilterNoDataAndNaN(std::vector<T>& dataBuffer, std::vector<Byte>&
 
         if (cntInvalidValues == nDepth)
         {
-          maskBuffer[k] = 0;
+          maskBuffer[k + j] = 0;
           bModifiedMask = true;
         }
         else if (cntInvalidValues > 0)    // found mix of valid and invalid values at the same pixel
           bHasNoDataValuesLeft = true;
       }
+
+      j0 = j1;
+    }
   }
 
   if (minVal == DBL_MAX && maxVal == -DBL_MAX)    // if the tile has no valid data
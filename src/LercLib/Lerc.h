@@ -31,10 +31,6 @@ Contributors:  Thomas Maurer
 
 NAMESPACE_LERC_START
 
-#ifdef HAVE_LERC1_DECODE
-  class CntZImage;
-#endif
-
   class Lerc
   {
   public:
@@ -54,6 +50,22 @@ NAMESPACE_LERC_START
     // if more than 1 band, the outgoing Lerc blob has the single band Lerc blobs concatenated; 
     // or, if you have multiple values per pixel and stored as [RGB, RGB, ... ], then set nDepth accordingly (e.g., 3)
 
+    // optional encoder tuning, per call, as set from an int array by GetEncodeOptions(); nullptr means the defaults
+
+    struct EncodeOptions
+    {
+      bool bDropNoisyBitPlanes;    // int types only, find the noisy low bit planes and drop them, can raise maxZErr
+      int bitPlaneRowStep;         // bit plane noise test on every n-th row only, 1 - all rows
+      bool bMicroBlockSizeSearch;  // try micro block size 8, 16, and 32, instead of 8 and maybe 16
+
+      EncodeOptions() : bDropNoisyBitPlanes(false), bitPlaneRowStep(1), bMicroBlockSizeSearch(false) {}
+    };
+
+    // sets the first nOptions options from an array laid out as EncodeOptionsArrOrder in Lerc_types.h,
+    // the others keep their defaults; fails if one is out of range
+
+    static ErrCode GetEncodeOptions(const int* pOptionsArr, int nOptions, EncodeOptions& options);
+
     // computes the number of bytes needed to allocate the buffer, accurate to the byte;
     // does not encode the image data, but uses statistics and formulas to compute the buffer size needed;
     // this function is optional, you can also use a buffer large enough to call Encode() directly, 
@@ -73,7 +85,8 @@ NAMESPACE_LERC_START
       double maxZErr,                  // max coding error per pixel, defines the precision
       unsigned int& numBytesNeeded,    // size of outgoing Lerc blob
       const unsigned char* pUsesNoData,// if there are invalid values not marked by the mask, pass an array of size nBands, 1 - uses noData, 0 - not
-      const double* noDataValues);     // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const double* noDataValues,      // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const EncodeOptions* pOptions = nullptr);    // optional encoder tuning, nullptr for the defaults
 
     // encodes or compresses the image data into the buffer
 
@@ -92,7 +105,20 @@ NAMESPACE_LERC_START
       unsigned int numBytesBuffer,     // buffer size
       unsigned int& numBytesWritten,   // num bytes written to buffer
       const unsigned char* pUsesNoData,// if there are invalid values not marked by the mask, pass an array of size nBands, 1 - uses noData, 0 - not
-      const double* noDataValues);     // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const double* noDataValues,      // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const EncodeOptions* pOptions = nullptr);    // optional encoder tuning, nullptr for the defaults
+
+    // upper bound of the Lerc blob size for any data, mask, and maxZErr of these dimensions and data type;
+    // cheap, only uses the dimensions; a buffer of this size never fails Encode() with BufferTooSmall,
+    // so it can replace the call to ComputeCompressedSize() before Encode();
+
+    static ErrCode ComputeCompressBound(
+      DataType dt,                     // data type, char to double
+      int nDepth,                      // number of values per pixel
+      int nCols,                       // number of cols
+      int nRows,                       // number of rows
+      int nBands,                      // number of bands
+      unsigned int& numBytesBound);    // max size of outgoing Lerc blob
 
     // Decode
 
@@ -173,7 +199,8 @@ NAMESPACE_LERC_START
       double maxZErr,                  // max coding error per pixel, defines the precision
       unsigned int& numBytes,          // size of outgoing Lerc blob
       const unsigned char* pUsesNoData,// if there are invalid values not marked by the mask, pass an array of size nBands, 1 - uses noData, 0 - not
-      const double* noDataValues);     // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const double* noDataValues,      // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const EncodeOptions* pOptions = nullptr);    // optional encoder tuning, nullptr for the defaults
 
     template<class T> static ErrCode EncodeTempl(
       const T* pData,                  // raw image data, row by row, band by band
@@ -189,7 +216,8 @@ NAMESPACE_LERC_START
       unsigned int numBytesBuffer,     // buffer size
       unsigned int& numBytesWritten,   // num bytes written to buffer
       const unsigned char* pUsesNoData,// if there are invalid values not marked by the mask, pass an array of size nBands, 1 - uses noData, 0 - not
-      const double* noDataValues);     // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const double* noDataValues,      // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const EncodeOptions* pOptions = nullptr);    // optional encoder tuning, nullptr for the defaults
 
     template<class T> static ErrCode DecodeTempl(
       T* pData,                        // outgoing data bands
@@ -206,6 +234,8 @@ NAMESPACE_LERC_START
 
   private:
 
+    static bool ApplyEncodeOptions(const EncodeOptions* pOptions, Lerc2& lerc2);
+
     template<class T> static ErrCode EncodeInternal_v5(
       const T* pData,                  // raw image data, row by row, band by band
       int version,                     // 2 = v2.2, 3 = v2.3, 4 = v2.4, 5 = v2.5
@@ -219,7 +249,8 @@ NAMESPACE_LERC_START
       unsigned int& numBytes,          // size of outgoing Lerc blob
       Byte* pBuffer,                   // buffer to write to, function will fail if buffer too small
       unsigned int numBytesBuffer,     // buffer size
-      unsigned int& numBytesWritten);  // num bytes written to buffer
+      unsigned int& numBytesWritten,   // num bytes written to buffer
+      const EncodeOptions* pOptions);  // optional encoder tuning, or nullptr
 
     template<class T> static ErrCode EncodeInternal(
       const T* pData,                  // raw image data, row by row, band by band
@@ -236,11 +267,9 @@ NAMESPACE_LERC_START
       unsigned int numBytesBuffer,     // buffer size
       unsigned int& numBytesWritten,   // num bytes written to buffer
       const unsigned char* pUsesNoData,// if there are invalid values not marked by the mask, pass an array of size nBands, 1 - uses noData, 0 - not
-      const double* noDataValues);     // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const double* noDataValues,      // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const EncodeOptions* pOptions);  // optional encoder tuning, or nullptr
 
-#ifdef HAVE_LERC1_DECODE
-    template<class T> static bool Convert(const CntZImage& zImg, T* arr, Byte* pByteMask, bool bMustFillMask);
-#endif
     template<class T> static ErrCode ConvertToDoubleTempl(const T* pDataIn, size_t nDataValues, double* pDataOut);
 
     template<class T> static ErrCode CheckForNaN(const T* arr, int nDepth, int nCols, int nRows, const Byte* pByteMask);
@@ -275,6 +304,17 @@ NAMESPACE_LERC_START
       double& maxZError, bool bPassNoDataValue, double& noDataValue, bool& bModifiedMask, bool& bNeedNoData,
       double& minVal, double& maxVal);
 
+    // one pass over n values of valid pixels: min / max, and clear bAllInt if any value is not int;
+    // returns false and leaves all unchanged if there is any NaN, or noData if bCheckNoData
+    template<class T>
+    static bool ScanValidValues(const T*, size_t, bool, T, double&, double&, bool&)  { return false; }    // use the per pixel loop
+    static bool ScanValidValues(const float* p, size_t n, bool bCheckNoData, float noData, double& minVal, double& maxVal, bool& bAllInt);
+    static bool ScanValidValues(const double* p, size_t n, bool bCheckNoData, double noData, double& minVal, double& maxVal, bool& bAllInt);
+
+    template<class T> static bool ContainsNaN(const T*, size_t)  { return false; }
+    static bool ContainsNaN(const float* p, size_t n);
+    static bool ContainsNaN(const double* p, size_t n);
+
     template<class T>
     static ErrCode FilterNoDataAndNaN(std::vector<T>& dataBuffer, std::vector<Byte>& maskBuffer, int nDepth, int nCols, int nRows,
       double& maxZError, bool bPassNoDataValue, double& noDataValue, bool& bModifiedMask, bool& bNeedNoData, bool& bIsFltDblAllInt,
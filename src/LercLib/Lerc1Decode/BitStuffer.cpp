@@ -21,6 +21,7 @@ http://github.com/Esri/lerc/
 Contributors:  Thomas Maurer
 */
 
+#include <cstdint>
 #include <cstring>
 #include "BitStuffer.h"
 
@@ -55,8 +56,9 @@ bool BitStuffer::read(const Byte** ppByte, vector<unsigned int>& dataVec) const
 
   if (numUInts > 0)    // numBits can be 0
   {
-    m_tmpBitStuffVec.resize(numUInts);
+    m_tmpBitStuffVec.resize(numUInts + 1);    // one more uint, so each value can be taken from the 2 uints it may span
     m_tmpBitStuffVec[numUInts - 1] = 0;    // set last uint to 0
+    m_tmpBitStuffVec[numUInts] = 0;
 
     unsigned int nBytesToCopy = (numElements * numBits + 7) / 8;
     memcpy(&m_tmpBitStuffVec[0], *ppByte, nBytesToCopy);
@@ -74,38 +76,17 @@ bool BitStuffer::read(const Byte** ppByte, vector<unsigned int>& dataVec) const
     while (n--)
       *pLastULong <<= 8;
 
-    // do the un-stuffing
-    srcPtr = arr;
+    // do the un-stuffing, from a 64 bit window over the 2 uints at the bit position, without a branch per value
     unsigned int* dstPtr = &dataVec[0];
-    int bitPos = 0;
+    const int nb = 64 - numBits;
+    size_t bitPos = 0;
 
     for (unsigned int i = 0; i < numElements; i++)
     {
-      if (32 - bitPos >= numBits)
-      {
-        unsigned int val;
-        memcpy(&val, srcPtr, sizeof(unsigned int));
-        unsigned int n = val << bitPos;
-        *dstPtr++ = n >> (32 - numBits);
-
-        bitPos += numBits;
-        if (bitPos == 32)    // shift >= 32 is undefined
-        {
-          bitPos = 0;
-          srcPtr++;
-        }
-      }
-      else
-      {
-        unsigned int val;
-        memcpy(&val, srcPtr, sizeof(unsigned int));
-        srcPtr++;
-        unsigned int n = val << bitPos;
-        *dstPtr = n >> (32 - numBits);
-        bitPos -= (32 - numBits);
-        memcpy(&val, srcPtr, sizeof(unsigned int));
-        *dstPtr++ |= val >> (32 - bitPos);
-      }
+      const unsigned int* p = arr + (bitPos >> 5);
+      uint64_t w = ((uint64_t)p[0] << 32) | p[1];
+      *dstPtr++ = (unsigned int)((w << (bitPos & 31)) >> nb);
+      bitPos += numBits;
     }
 
     *ppByte += nBytesToCopy;
@@ -22,8 +22,10 @@ Contributors:  Thomas Maurer
 */
 
 #include <climits>
+#include <cmath>
 #include <cstring>
 #include <algorithm>
+#include <type_traits>
 #include "CntZImage.h"
 #include "BitStuffer.h"
 #include "../BitMask.h"
@@ -34,6 +36,53 @@ using namespace LercNS;
 
 // -------------------------------------------------------------------------- ;
 
+// calls readTile(i0, i1, j0, j1) for all tiles, in the order they are stored
+
+template<class Func>
+static bool ForEachTile(int width, int height, int numTilesVert, int numTilesHori, Func readTile)
+{
+  if (numTilesVert <= 0 || numTilesHori <= 0
+    || numTilesVert > height || numTilesHori > width)
+    return false;
+
+  for (int iTile = 0; iTile <= numTilesVert; iTile++)
+  {
+    int tileH = height / numTilesVert;
+    int i0 = iTile * tileH;
+    if (iTile == numTilesVert)
+      tileH = height % numTilesVert;
+
+    if (tileH == 0)
+      continue;
+
+    for (int jTile = 0; jTile <= numTilesHori; jTile++)
+    {
+      int tileW = width / numTilesHori;
+      int j0 = jTile * tileW;
+      if (jTile == numTilesHori)
+        tileW = width % numTilesHori;
+
+      if (tileW == 0)
+        continue;
+
+      if (!readTile(i0, i0 + tileH, j0, j0 + tileW))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+template<class T>
+static inline T FromFlt(float z)    // integer types get rounded
+{
+  return std::is_floating_point<T>::value ? (T)z : (T)floor(z + 0.5);
+}
+
+// -------------------------------------------------------------------------- ;
+
 CntZImage::CntZImage()
 {
   type_                    = CNT_Z;
@@ -72,53 +121,10 @@ unsigned int CntZImage::computeNumBytesNeededToReadHeader(bool onlyZPart)
 
 bool CntZImage::read(const Byte** ppByte, const Byte* bArr_end, double maxZError, bool onlyHeader, bool onlyZPart)
 {
-  if (!ppByte || !*ppByte)
-    return false;
-
-  size_t len = getTypeString().length();
-
-  if (*ppByte + len > bArr_end)
-    return false;
-
-  string typeStr(len, '0');
-  memcpy(&typeStr[0], *ppByte, len);
-  *ppByte += len;
-
-  if (typeStr != getTypeString())
-    return false;
-
-  int version = 0, type = 0, width = 0, height = 0;
+  int width = 0, height = 0;
   double maxZErrorInFile = 0;
 
-  const Byte* ptr = *ppByte;
-
-  if (ptr + 4 * sizeof(int) + sizeof(double) > bArr_end)
-    return false;
-
-  memcpy(&version, ptr, sizeof(int));  ptr += sizeof(int);
-  memcpy(&type,    ptr, sizeof(int));  ptr += sizeof(int);
-  memcpy(&height,  ptr, sizeof(int));  ptr += sizeof(int);
-  memcpy(&width,   ptr, sizeof(int));  ptr += sizeof(int);
-  memcpy(&maxZErrorInFile, ptr, sizeof(double));  ptr += sizeof(double);
-
-  *ppByte = ptr;
-
-  SWAP_4(version);
-  SWAP_4(type);
-  SWAP_4(height);
-  SWAP_4(width);
-  SWAP_8(maxZErrorInFile);
-
-  if (version != 11 || type != type_)
-    return false;
-
-  if (height < 0 || width < 0 || height > 40000 || width > 40000)  // guard against bogus numbers; size limitation for old Lerc1
-    return false;
-
-  if (sizeof(CntZ) * height * width > (size_t)INT_MAX)
-    return false;
-
-  if (maxZErrorInFile > maxZError)
+  if (!readHeader(ppByte, bArr_end, maxZError, width, height, maxZErrorInFile))
     return false;
 
   if (onlyHeader)
@@ -139,26 +145,10 @@ bool CntZImage::read(const Byte** ppByte, const Byte* bArr_end, double maxZError
     int numTilesVert = 0, numTilesHori = 0, numBytes = 0;
     float maxValInImg = 0;
 
-    const Byte* ptr = *ppByte;
-
-    if (ptr + 3 * sizeof(int) + sizeof(float) > bArr_end)
+    if (!readPartHeader(ppByte, bArr_end, numTilesVert, numTilesHori, numBytes, maxValInImg))
       return false;
 
-    memcpy(&numTilesVert, ptr, sizeof(int));  ptr += sizeof(int);
-    memcpy(&numTilesHori, ptr, sizeof(int));  ptr += sizeof(int);
-    memcpy(&numBytes, ptr, sizeof(int));  ptr += sizeof(int);
-    memcpy(&maxValInImg, ptr, sizeof(float));  ptr += sizeof(float);
-
-    *ppByte = ptr;
-    const Byte* bArr = ptr;
-
-    SWAP_4(numTilesVert);
-    SWAP_4(numTilesHori);
-    SWAP_4(numBytes);
-    SWAP_4(maxValInImg);
-
-    if (numBytes < 0 || ptr + numBytes > bArr_end)
-      return false;
+    const Byte* bArr = *ppByte;
 
     if (!zPart && numTilesVert == 0 && numTilesHori == 0)    // no tiling for this cnt part
     {
@@ -202,48 +192,174 @@ bool CntZImage::read(const Byte** ppByte, const Byte* bArr_end, double maxZError
 
 // -------------------------------------------------------------------------- ;
 
-bool CntZImage::readTiles(bool zPart, double maxZErrorInFile, int numTilesVert, int numTilesHori,
-  float maxValInImg, const Byte* bArr)
+template<class T>
+bool CntZImage::read(const Byte** ppByte, const Byte* bArr_end, double maxZError, T* arr, BitMask& bitMask, bool onlyZPart)
 {
-  if (numTilesVert <= 0 || numTilesHori <= 0
-    || numTilesVert > height_ || numTilesHori > width_)
-    return false;
+  int width = 0, height = 0;
+  double maxZErrorInFile = 0;
 
-  const Byte* ptr = bArr;
+  if (!arr || !readHeader(ppByte, bArr_end, maxZError, width, height, maxZErrorInFile))
+    return false;
 
-  for (int iTile = 0; iTile <= numTilesVert; iTile++)
+  if (onlyZPart)
   {
-    int tileH = height_ / numTilesVert;
-    int i0 = iTile * tileH;
-    if (iTile == numTilesVert)
-      tileH = height_ % numTilesVert;
+    if (bitMask.GetWidth() != width || bitMask.GetHeight() != height)    // cnt part of the band before
+      return false;
+  }
+  else
+  {
+    if (!bitMask.SetSize(width, height))
+      return false;
 
-    if (tileH == 0)
-      continue;
+    bitMask.SetAllInvalid();    // same as resizeFill0(), used below
 
-    for (int jTile = 0; jTile <= numTilesHori; jTile++)
-    {
-      int tileW = width_ / numTilesHori;
-      int j0 = jTile * tileW;
-      if (jTile == numTilesHori)
-        tileW = width_ % numTilesHori;
+    int numTilesVert = 0, numTilesHori = 0, numBytes = 0;
+    float maxCntInImg = 0;
 
-      if (tileW == 0)
-        continue;
+    if (!readPartHeader(ppByte, bArr_end, numTilesVert, numTilesHori, numBytes, maxCntInImg))
+      return false;
 
-      bool rv = zPart ? readZTile(  &ptr, i0, i0 + tileH, j0, j0 + tileW, maxZErrorInFile, maxValInImg) :
-                        readCntTile(&ptr, i0, i0 + tileH, j0, j0 + tileW);
+    const Byte* ptr = *ppByte;
 
-      if (!rv)
-        return false;
+    if (numTilesVert == 0 && numTilesHori == 0)    // no tiling for this cnt part
+    {
+      if (numBytes == 0 && maxCntInImg > 0)    // cnt part is const
+        bitMask.SetAllValid();
+
+      if (numBytes > 0)    // cnt part is binary mask, decompress right into the bit mask
+      {
+        RLE rle;
+        if (!rle.decompress(ptr, (size_t)width * height * 2, bitMask.Bits(), bitMask.Size()))
+          return false;
+      }
     }
+    else if (!ForEachTile(width, height, numTilesVert, numTilesHori,
+      [&](int i0, int i1, int j0, int j1) { return readCntTile(&ptr, i0, i1, j0, j1, bitMask); }))
+      return false;
+
+    *ppByte += numBytes;
   }
 
+  int numTilesVert = 0, numTilesHori = 0, numBytes = 0;
+  float maxZInImg = 0;
+
+  if (!readPartHeader(ppByte, bArr_end, numTilesVert, numTilesHori, numBytes, maxZInImg))
+    return false;
+
+  const Byte* ptr = *ppByte;
+
+  if (!ForEachTile(width, height, numTilesVert, numTilesHori,
+    [&](int i0, int i1, int j0, int j1) { return readZTile(&ptr, i0, i1, j0, j1, maxZErrorInFile, maxZInImg, arr, bitMask); }))
+    return false;
+
+  *ppByte += numBytes;
+
+  m_tmpDataVec.clear();
   return true;
 }
 
 // -------------------------------------------------------------------------- ;
 
+bool CntZImage::readHeader(const Byte** ppByte, const Byte* bArr_end, double maxZError,
+  int& width, int& height, double& maxZErrorInFile) const
+{
+  if (!ppByte || !*ppByte)
+    return false;
+
+  size_t len = getTypeString().length();
+
+  if (*ppByte + len > bArr_end)
+    return false;
+
+  string typeStr(len, '0');
+  memcpy(&typeStr[0], *ppByte, len);
+  *ppByte += len;
+
+  if (typeStr != getTypeString())
+    return false;
+
+  int version = 0, type = 0;
+  width = height = 0;
+  maxZErrorInFile = 0;
+
+  const Byte* ptr = *ppByte;
+
+  if (ptr + 4 * sizeof(int) + sizeof(double) > bArr_end)
+    return false;
+
+  memcpy(&version, ptr, sizeof(int));  ptr += sizeof(int);
+  memcpy(&type,    ptr, sizeof(int));  ptr += sizeof(int);
+  memcpy(&height,  ptr, sizeof(int));  ptr += sizeof(int);
+  memcpy(&width,   ptr, sizeof(int));  ptr += sizeof(int);
+  memcpy(&maxZErrorInFile, ptr, sizeof(double));  ptr += sizeof(double);
+
+  *ppByte = ptr;
+
+  SWAP_4(version);
+  SWAP_4(type);
+  SWAP_4(height);
+  SWAP_4(width);
+  SWAP_8(maxZErrorInFile);
+
+  if (version != 11 || type != type_)
+    return false;
+
+  if (height < 0 || width < 0 || height > 40000 || width > 40000)  // guard against bogus numbers; size limitation for old Lerc1
+    return false;
+
+  if (sizeof(CntZ) * height * width > (size_t)INT_MAX)
+    return false;
+
+  if (maxZErrorInFile > maxZError)
+    return false;
+
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool CntZImage::readPartHeader(const Byte** ppByte, const Byte* bArr_end,
+  int& numTilesVert, int& numTilesHori, int& numBytes, float& maxValInImg)
+{
+  const Byte* ptr = *ppByte;
+
+  if (ptr + 3 * sizeof(int) + sizeof(float) > bArr_end)
+    return false;
+
+  memcpy(&numTilesVert, ptr, sizeof(int));  ptr += sizeof(int);
+  memcpy(&numTilesHori, ptr, sizeof(int));  ptr += sizeof(int);
+  memcpy(&numBytes, ptr, sizeof(int));  ptr += sizeof(int);
+  memcpy(&maxValInImg, ptr, sizeof(float));  ptr += sizeof(float);
+
+  *ppByte = ptr;
+
+  SWAP_4(numTilesVert);
+  SWAP_4(numTilesHori);
+  SWAP_4(numBytes);
+  SWAP_4(maxValInImg);
+
+  if (numBytes < 0 || ptr + numBytes > bArr_end)
+    return false;
+
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool CntZImage::readTiles(bool zPart, double maxZErrorInFile, int numTilesVert, int numTilesHori,
+  float maxValInImg, const Byte* bArr)
+{
+  const Byte* ptr = bArr;
+
+  return ForEachTile(width_, height_, numTilesVert, numTilesHori, [&](int i0, int i1, int j0, int j1)
+    {
+      return zPart ? readZTile(&ptr, i0, i1, j0, j1, maxZErrorInFile, maxValInImg) :
+                     readCntTile(&ptr, i0, i1, j0, j1);
+    });
+}
+
+// -------------------------------------------------------------------------- ;
+
 bool CntZImage::readCntTile(const Byte** ppByte, int i0, int i1, int j0, int j1)
 {
   if (i0 >= i1 || j0 >= j1)
@@ -303,8 +419,7 @@ bool CntZImage::readCntTile(const Byte** ppByte, int i0, int i1, int j0, int j1)
       return false;
 
     int numPixel = (i1 - i0) * (j1 - j0);
-    BitStuffer bitStuffer;
-    if (!bitStuffer.read(&ptr, m_tmpDataVec) || m_tmpDataVec.size() < (size_t)numPixel)
+    if (!m_bitStuffer.read(&ptr, m_tmpDataVec) || m_tmpDataVec.size() < (size_t)numPixel)
       return false;
 
     unsigned int* srcPtr = &m_tmpDataVec[0];
@@ -394,8 +509,7 @@ bool CntZImage::readZTile(const Byte** ppByte, int i0, int i1, int j0, int j1, d
     else
     {
       vector<unsigned int>& dataVec = m_tmpDataVec;
-      BitStuffer bitStuffer;
-      if (!bitStuffer.read(&ptr, dataVec))
+      if (!m_bitStuffer.read(&ptr, dataVec))
         return false;
 
       double invScale = 2 * maxZErrorInFile;
@@ -439,6 +553,191 @@ bool CntZImage::readZTile(const Byte** ppByte, int i0, int i1, int j0, int j1, d
 
 // -------------------------------------------------------------------------- ;
 
+bool CntZImage::readCntTile(const Byte** ppByte, int i0, int i1, int j0, int j1, BitMask& bitMask)
+{
+  if (i0 >= i1 || j0 >= j1)
+    return false;
+
+  const int width = bitMask.GetWidth();
+  const Byte* ptr = *ppByte;
+  Byte comprFlag = *ptr++;
+
+  if (comprFlag == 2 || comprFlag == 3)    // entire tile is constant 0 or -1 (invalid)
+  {                                        // here we depend on SetAllInvalid()
+    *ppByte = ptr;
+    return true;
+  }
+
+  if (comprFlag == 4)    // entire tile is constant 1 (valid)
+  {
+    for (int i = i0; i < i1; i++)
+    {
+      int64_t k = (int64_t)i * width + j0;
+      for (int j = j0; j < j1; j++, k++)
+        bitMask.SetValid(k);
+    }
+
+    *ppByte = ptr;
+    return true;
+  }
+
+  if ((comprFlag & 63) > 4)
+    return false;
+
+  if (comprFlag == 0)
+  {
+    // read cnt's as flt arr uncompressed
+    for (int i = i0; i < i1; i++)
+    {
+      int64_t k = (int64_t)i * width + j0;
+      for (int j = j0; j < j1; j++, k++)
+      {
+        float cnt;
+        memcpy(&cnt, ptr, 4);  ptr += 4;
+        SWAP_4(cnt);
+        if (cnt > 0)
+          bitMask.SetValid(k);
+      }
+    }
+  }
+  else
+  {
+    // read cnt's as int arr bit stuffed
+    int bits67 = comprFlag >> 6;
+    int n = (bits67 == 0) ? 4 : 3 - bits67;
+
+    float offset = 0;
+    if (!readFlt(&ptr, offset, n))
+      return false;
+
+    int numPixel = (i1 - i0) * (j1 - j0);
+    if (!m_bitStuffer.read(&ptr, m_tmpDataVec) || m_tmpDataVec.size() < (size_t)numPixel)
+      return false;
+
+    const unsigned int* srcPtr = &m_tmpDataVec[0];
+
+    for (int i = i0; i < i1; i++)
+    {
+      int64_t k = (int64_t)i * width + j0;
+      for (int j = j0; j < j1; j++, k++)
+        if (offset + (float)(*srcPtr++) > 0)
+          bitMask.SetValid(k);
+    }
+  }
+
+  *ppByte = ptr;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+template<class T>
+bool CntZImage::readZTile(const Byte** ppByte, int i0, int i1, int j0, int j1, double maxZErrorInFile, float maxZInImg,
+  T* arr, const BitMask& bitMask)
+{
+  const int width = bitMask.GetWidth();
+
+  // calls func(k0, k1) for each run [k0, k1) of valid pixels in this tile, row by row
+  auto forEachValidRun = [&](auto func)
+  {
+    for (int i = i0; i < i1; i++)
+    {
+      int64_t k = (int64_t)i * width + j0, kEnd = k + (j1 - j0), k0 = 0, k1 = 0;
+      for (; bitMask.NextValidRun(k, kEnd, k0, k1); k = k1)
+        if (!func(k0, k1))
+          return false;
+    }
+    return true;
+  };
+
+  const Byte* ptr = *ppByte;
+  Byte comprFlag = *ptr++;
+  int bits67 = comprFlag >> 6;
+  comprFlag &= 63;
+
+  if (comprFlag == 2)    // entire zTile is constant 0 (if valid or invalid doesn't matter)
+  {
+    forEachValidRun([&](int64_t k0, int64_t k1) { std::fill(arr + k0, arr + k1, (T)0);  return true; });
+
+    *ppByte = ptr;
+    return true;
+  }
+
+  if (comprFlag > 3)
+    return false;
+
+  if (comprFlag == 0)
+  {
+    // read z's as flt arr uncompressed
+    forEachValidRun([&](int64_t k0, int64_t k1)
+      {
+        for (int64_t k = k0; k < k1; k++)
+        {
+          float z;
+          memcpy(&z, ptr, 4);  ptr += 4;
+          SWAP_4(z);
+          arr[k] = FromFlt<T>(z);
+        }
+        return true;
+      });
+  }
+  else
+  {
+    // read z's as int arr bit stuffed
+    int n = (bits67 == 0) ? 4 : 3 - bits67;
+    float offset = 0;
+    if (!readFlt(&ptr, offset, n))
+      return false;
+
+    if (comprFlag == 3)
+    {
+      const T z = FromFlt<T>(offset);
+      forEachValidRun([&](int64_t k0, int64_t k1) { std::fill(arr + k0, arr + k1, z);  return true; });
+    }
+    else
+    {
+      if (!m_bitStuffer.read(&ptr, m_tmpDataVec))
+        return false;
+
+      const double invScale = 2 * maxZErrorInFile;
+      const unsigned int* srcPtr = m_tmpDataVec.data();
+      const unsigned int* srcEnd = srcPtr + m_tmpDataVec.size();
+
+      bool rv = forEachValidRun([&](int64_t k0, int64_t k1)
+        {
+          if (srcEnd - srcPtr < k1 - k0)    // fewer values than valid pixels
+            return false;
+
+          for (int64_t k = k0; k < k1; k++)
+          {
+            float z = (float)(offset + *srcPtr++ * invScale);
+            arr[k] = FromFlt<T>(std::min(z, maxZInImg));    // make sure we stay in the orig range
+          }
+          return true;
+        });
+
+      if (!rv)
+        return false;
+    }
+  }
+
+  *ppByte = ptr;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+template bool CntZImage::read<signed char>(const Byte** ppByte, const Byte* bArr_end, double maxZError, signed char* arr, BitMask& bitMask, bool onlyZPart);
+template bool CntZImage::read<Byte>(const Byte** ppByte, const Byte* bArr_end, double maxZError, Byte* arr, BitMask& bitMask, bool onlyZPart);
+template bool CntZImage::read<short>(const Byte** ppByte, const Byte* bArr_end, double maxZError, short* arr, BitMask& bitMask, bool onlyZPart);
+template bool CntZImage::read<unsigned short>(const Byte** ppByte, const Byte* bArr_end, double maxZError, unsigned short* arr, BitMask& bitMask, bool onlyZPart);
+template bool CntZImage::read<int>(const Byte** ppByte, const Byte* bArr_end, double maxZError, int* arr, BitMask& bitMask, bool onlyZPart);
+template bool CntZImage::read<unsigned int>(const Byte** ppByte, const Byte* bArr_end, double maxZError, unsigned int* arr, BitMask& bitMask, bool onlyZPart);
+template bool CntZImage::read<float>(const Byte** ppByte, const Byte* bArr_end, double maxZError, float* arr, BitMask& bitMask, bool onlyZPart);
+template bool CntZImage::read<double>(const Byte** ppByte, const Byte* bArr_end, double maxZError, double* arr, BitMask& bitMask, bool onlyZPart);
+
+// -------------------------------------------------------------------------- ;
+
 int CntZImage::numBytesFlt(float z)
 {
   short s = (short)z;
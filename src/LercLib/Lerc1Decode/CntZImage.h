@@ -26,9 +26,12 @@ Contributors:  Thomas Maurer
 
 #include <vector>
 #include "TImage.hpp"
+#include "BitStuffer.h"
 
 NAMESPACE_LERC_START
 
+class BitMask;
+
 /**	count / z image
  *
  *	count can also be a weight, therefore float;
@@ -49,6 +52,11 @@ public:
   /// read succeeds only if maxZError on file <= maxZError requested
   bool read(const Byte** ppByte, const Byte* bArr_end, double maxZError, bool onlyHeader = false, bool onlyZPart = false);
 
+  /// same, but decodes straight into arr of size width * height and the valid pixel bitMask, without the cnt / z image;
+  /// only valid pixels are written to arr; for onlyZPart, bitMask must hold the valid pixels of the band before
+  template<class T>
+  bool read(const Byte** ppByte, const Byte* bArr_end, double maxZError, T* arr, BitMask& bitMask, bool onlyZPart = false);
+
 protected:
 
   struct InfoFromComputeNumBytes
@@ -65,11 +73,19 @@ protected:
     float maxZInImg;
   };
 
+  bool readHeader(const Byte** ppByte, const Byte* bArr_end, double maxZError, int& width, int& height, double& maxZErrorInFile) const;
+  static bool readPartHeader(const Byte** ppByte, const Byte* bArr_end, int& numTilesVert, int& numTilesHori, int& numBytes, float& maxValInImg);
+
   bool readTiles(bool zPart, double maxZErrorInFile, int numTilesVert, int numTilesHori, float maxValInImg, const Byte* bArr);
 
   bool readCntTile(const Byte** ppByte, int i0, int i1, int j0, int j1);
   bool readZTile(const Byte** ppByte, int i0, int i1, int j0, int j1, double maxZErrorInFile, float maxZInImg);
 
+  bool readCntTile(const Byte** ppByte, int i0, int i1, int j0, int j1, BitMask& bitMask);
+  template<class T>
+  bool readZTile(const Byte** ppByte, int i0, int i1, int j0, int j1, double maxZErrorInFile, float maxZInImg,
+    T* arr, const BitMask& bitMask);
+
   static int numBytesFlt(float z);    // returns 1, 2, or 4
   static bool readFlt(const Byte** ppByte, float& z, int numBytes);
 
@@ -77,6 +93,7 @@ protected:
 
   InfoFromComputeNumBytes    m_infoFromComputeNumBytes;
   std::vector<unsigned int>  m_tmpDataVec;             // used in read fcts
+  BitStuffer                 m_bitStuffer;             // "
   bool                       m_bDecoderCanIgnoreMask;  // "
 };
 
@@ -28,6 +28,13 @@ Contributors:   Thomas Maurer
 #include "Lerc2.h"
 #include "Huffman.h"
 #include "RLE.h"
+#include "Parallel.h"
+#include "Stats.h"
+#include "Trace.h"
+
+#ifdef LERC_HAVE_SSE2
+#include <emmintrin.h>
+#endif
 
 USING_NAMESPACE_LERC
 using namespace std;
@@ -71,6 +78,11 @@ void Lerc2::Init()
   m_encodeMask        = true;
   m_writeDataOneSweep = false;
   m_minMaxSet         = false;
+  m_maskRLEValid      = false;
+  m_tileStatsMbSize   = 0;
+  m_bitPlaneRowStep   = 1;
+  m_dropNoisyBitPlanes = false;
+  m_microBlockSizeSearch = false;
   m_imageEncodeMode   = IEM_Tiling;
 
   m_headerInfo.RawInit();
@@ -85,12 +97,19 @@ bool Lerc2::Set(int nDepth, int nCols, int nRows, const Byte* pMaskBits)
   if (nDepth > 1 && m_headerInfo.version < 4)
     return false;
 
+  bool bSameSize = (nCols == m_bitMask.GetWidth() && nRows == m_bitMask.GetHeight());
+
   if (!m_bitMask.SetSize(nCols, nRows))
     return false;
 
   if (pMaskBits)
   {
-    memcpy(m_bitMask.Bits(), pMaskBits, m_bitMask.Size());
+    // keep the compressed mask from the last band if the mask is the same
+    if (!bSameSize || memcmp(m_bitMask.Bits(), pMaskBits, m_bitMask.Size()) != 0)
+    {
+      memcpy(m_bitMask.Bits(), pMaskBits, m_bitMask.Size());
+      m_maskRLEValid = false;
+    }
 
     int64_t numValid = m_bitMask.CountValidBits();
     if (numValid < 0 || numValid > (int64_t)INT_MAX)
@@ -102,6 +121,7 @@ bool Lerc2::Set(int nDepth, int nCols, int nRows, const Byte* pMaskBits)
   {
     m_headerInfo.numValidPixel = nCols * nRows;
     m_bitMask.SetAllValid();
+    m_maskRLEValid = false;
   }
 
   m_headerInfo.nDepth  = nDepth;
@@ -176,9 +196,38 @@ void Lerc2::ClearMinMax()
 
 // -------------------------------------------------------------------------- ;
 
+bool Lerc2::SetMicroBlockSizeSearch(bool bSearch)
+{
+  m_microBlockSizeSearch = bSearch;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool Lerc2::SetDropNoisyBitPlanes(bool bDrop)
+{
+  m_dropNoisyBitPlanes = bDrop;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+bool Lerc2::SetBitPlaneSampling(int rowStep)
+{
+  if (rowStep < 1)
+    return false;
+
+  m_bitPlaneRowStep = rowStep;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
 template<class T>
 unsigned int Lerc2::ComputeNumBytesNeededToWrite(const T* arr, double maxZError, bool encodeMask)
 {
+  LERC_TRACE_SCOPE("Lerc2::ComputeNumBytesNeededToWrite");
+
   if (!arr || !IsLittleEndianSystem())
     return 0;
 
@@ -197,9 +246,21 @@ unsigned int Lerc2::ComputeNumBytesNeededToWrite(const T* arr, double maxZError,
 
   if (needMask && encodeMask)
   {
-    RLE rle;
-    size_t n = rle.computeNumBytesRLE((const Byte*)m_bitMask.Bits(), m_bitMask.Size());
-    nBytesHeaderMask += (unsigned int)n;
+    if (!m_maskRLEValid)    // compress it here, WriteMask() copies it to the blob
+    {
+      Stats::Timer timer(StatsArrOrder::msMask);
+      LERC_TRACE_SCOPE("Lerc2 RLE compress mask");
+      RLE rle;
+      size_t n = rle.computeNumBytesRLE((const Byte*)m_bitMask.Bits(), m_bitMask.Size());
+
+      m_maskRLE.resize(n);
+      if (!n || rle.compress((const Byte*)m_bitMask.Bits(), m_bitMask.Size(), &m_maskRLE[0]) != n)
+        return 0;
+
+      m_maskRLEValid = true;
+    }
+
+    nBytesHeaderMask += (unsigned int)m_maskRLE.size();
   }
 
   m_headerInfo.dt = GetDataType(arr[0]);
@@ -213,8 +274,17 @@ unsigned int Lerc2::ComputeNumBytesNeededToWrite(const T* arr, double maxZError,
   if (m_headerInfo.dt < DT_Float)    // integer types
   {
     // interpret a negative maxZError as bit plane epsilon; dflt = 0.01;
-    if (maxZError < 0 && (!TryBitPlaneCompression(arr, -maxZError, maxZError)))
-      maxZError = 0;
+    if (maxZError < 0)
+    {
+      if (!TryBitPlaneCompression(arr, -maxZError, maxZError))
+        maxZError = 0;
+    }
+    else if (m_dropNoisyBitPlanes)    // drop the noisy bit planes if that allows a larger error than asked for
+    {
+      double maxZErrorBP = 0;
+      if (TryBitPlaneCompression(arr, 0.01, maxZErrorBP))
+        maxZError = std::max(maxZError, maxZErrorBP);
+    }
 
     maxZError = std::max(0.5, floor(maxZError));
   }
@@ -245,8 +315,12 @@ unsigned int Lerc2::ComputeNumBytesNeededToWrite(const T* arr, double maxZError,
   Byte* ptr = nullptr;    // only emulate the writing and just count the bytes needed
   int nBytesTiling = 0;
 
+  // first tiling pass, WriteTiles() below only needs the data for tiles that try the LUT or diff encoding
+  if (!ComputeTileStats(arr, m_microBlockSize))
+    return 0;
+
   if ((!m_minMaxSet || m_headerInfo.nDepth > 1)
-    && !ComputeMinMaxRanges(arr, m_zMinVec, m_zMaxVec))    // need this for diff encoding before WriteTiles()
+    && !ComputeMinMaxRanges<T>(m_zMinVec, m_zMaxVec))    // need this for diff encoding before WriteTiles()
     return 0;
 
   m_headerInfo.zMin = *std::min_element(m_zMinVec.begin(), m_zMinVec.end());
@@ -306,6 +380,7 @@ unsigned int Lerc2::ComputeNumBytesNeededToWrite(const T* arr, double maxZError,
   {
     m_huffmanCodes.resize(0);
 
+    Stats::Timer timer(StatsArrOrder::msFpl);
     bool rv = m_lfpc.ComputeHuffmanCodesFlt(arr, (m_headerInfo.dt == DT_Double),
       m_headerInfo.nCols, m_headerInfo.nRows, m_headerInfo.nDepth);
 
@@ -330,6 +405,53 @@ unsigned int Lerc2::ComputeNumBytesNeededToWrite(const T* arr, double maxZError,
   m_writeDataOneSweep = false;
   size_t nBytesDataOneSweep = sizeof(T) * nDepth * numValid;
 
+  if (m_microBlockSizeSearch)
+  {
+    // estimate 16 and 32 from tile stats merged from the 8 x 8 ones, then count the best one exactly
+    int bestMbSize = 0, nBytesBest = nBytesData;
+
+    for (int mbSize = 2 * m_microBlockSize; mbSize <= 32; mbSize *= 2)
+    {
+      if (m_headerInfo.nRows <= mbSize / 2 && m_headerInfo.nCols <= mbSize / 2)
+        break;
+
+      MergeTileStats<T>();
+      m_headerInfo.microBlockSize = mbSize;
+
+      int nBytes2 = 0;
+      if (!WriteTiles(arr, &ptr, nBytes2) || nBytes2 < 0)
+        return 0;
+
+      if (nBytes2 <= nBytesBest)
+      {
+        nBytesBest = nBytes2;
+        bestMbSize = mbSize;
+      }
+    }
+
+    m_headerInfo.microBlockSize = m_microBlockSize;
+
+    if (bestMbSize > 0)
+    {
+      m_headerInfo.microBlockSize = bestMbSize;
+
+      int nBytes2 = 0;
+      if (!ComputeTileStats(arr, bestMbSize) || !WriteTiles(arr, &ptr, nBytes2) || nBytes2 < 0)
+        return 0;
+
+      if (nBytes2 <= nBytesData)
+      {
+        nBytesData = nBytes2;
+        m_imageEncodeMode = IEM_Tiling;
+        m_huffmanCodes.resize(0);
+      }
+      else
+      {
+        m_headerInfo.microBlockSize = m_microBlockSize;    // reset to orig
+      }
+    }
+  }
+  else
   {
     // try with double block size to reduce block header overhead, if
     if (((size_t)nBytesTiling * 8 < (size_t)numTotal * nDepth * 1.5)    // resulting bit rate < x (2 bpp)
@@ -340,7 +462,8 @@ unsigned int Lerc2::ComputeNumBytesNeededToWrite(const T* arr, double maxZError,
       m_headerInfo.microBlockSize = m_microBlockSize * 2;
 
       int nBytes2 = 0;
-      if (!WriteTiles(arr, &ptr, nBytes2) || nBytes2 < 0)    // no huffman in here anymore
+      if (!ComputeTileStats(arr, m_headerInfo.microBlockSize)
+        || !WriteTiles(arr, &ptr, nBytes2) || nBytes2 < 0)    // no huffman in here anymore
         return 0;
 
       if (nBytes2 <= nBytesData)
@@ -396,17 +519,32 @@ template unsigned int Lerc2::ComputeNumBytesNeededToWrite<double>(const double*
 template<class T>
 bool Lerc2::Encode(const T* arr, Byte** ppByte)
 {
+  LERC_TRACE_SCOPE("Lerc2::Encode");
+
   if (!arr || !ppByte || !IsLittleEndianSystem())
     return false;
 
+  ClearTileStats();    // only needed to count the bytes, WriteTiles() below reads the data
+
   Byte* ptrBlob = *ppByte;    // keep a ptr to the start of the blob
+  Byte* ptr0 = *ppByte;    // start of the current section, for the stats
+
+  Stats::Add(StatsArrOrder::nBands, 1);
+  Stats::Set(StatsArrOrder::imageEncodeMode, -2);
+  Stats::Set(StatsArrOrder::microBlockSize, 0);
 
   if (!WriteHeader(ppByte, m_headerInfo))
     return false;
 
+  Stats::Add(StatsArrOrder::bytesHeader, (double)(*ppByte - ptr0));
+  ptr0 = *ppByte;
+
   if (!WriteMask(ppByte))
     return false;
 
+  Stats::Add(StatsArrOrder::bytesMask, (double)(*ppByte - ptr0));
+  ptr0 = *ppByte;
+
   if (m_headerInfo.numValidPixel == 0 || m_headerInfo.zMin == m_headerInfo.zMax)
   {
     return DoChecksOnEncode(ptrBlob, *ppByte);
@@ -421,12 +559,17 @@ bool Lerc2::Encode(const T* arr, Byte** ppByte)
     if (!CheckMinMaxRanges(minMaxEqual))
       return false;
 
+    Stats::Add(StatsArrOrder::bytesHeader, (double)(*ppByte - ptr0));
+    ptr0 = *ppByte;
+
     if (minMaxEqual)
       return DoChecksOnEncode(ptrBlob, *ppByte);
   }
 
   **ppByte = m_writeDataOneSweep ? 1 : 0;    // write flag
   (*ppByte)++;
+  Stats::Add(StatsArrOrder::bytesHeader, 1);
+  ptr0 = *ppByte;
 
   if (!m_writeDataOneSweep)
   {
@@ -434,17 +577,25 @@ bool Lerc2::Encode(const T* arr, Byte** ppByte)
     {
       **ppByte = (Byte)m_imageEncodeMode;    // Huffman or tiling encode mode
       (*ppByte)++;
+      Stats::Add(StatsArrOrder::bytesHeader, 1);
+      ptr0 = *ppByte;
 
       if (m_imageEncodeMode != IEM_Tiling)
       {
+        Stats::Set(StatsArrOrder::imageEncodeMode, m_imageEncodeMode);
+
         if (m_headerInfo.TryHuffmanFlt())
         {
           if (!(m_imageEncodeMode == IEM_DeltaHuffman || m_imageEncodeMode == IEM_Huffman || m_imageEncodeMode == IEM_DeltaDeltaHuffman))
             return false;
 
-          if (!m_lfpc.EncodeHuffmanFlt(ppByte))
-            return false;
+          {
+            Stats::Timer timer(StatsArrOrder::msFpl);
+            if (!m_lfpc.EncodeHuffmanFlt(ppByte))
+              return false;
+          }
 
+          Stats::Add(StatsArrOrder::bytesFpl, (double)(*ppByte - ptr0));
           return DoChecksOnEncode(ptrBlob, *ppByte);
         }
 
@@ -461,19 +612,29 @@ bool Lerc2::Encode(const T* arr, Byte** ppByte)
           else
             return false;
 
+          Stats::Add(StatsArrOrder::bytesHuffman, (double)(*ppByte - ptr0));
           return DoChecksOnEncode(ptrBlob, *ppByte);
         }
       }
     }
 
+    Stats::Set(StatsArrOrder::imageEncodeMode, IEM_Tiling);
+    Stats::Set(StatsArrOrder::microBlockSize, m_headerInfo.microBlockSize);
+
     int numBytes = 0;
     if (!WriteTiles(arr, ppByte, numBytes) || numBytes < 0)
       return false;
+
+    Stats::Add(StatsArrOrder::bytesTiles, numBytes);
   }
   else
   {
+    Stats::Set(StatsArrOrder::imageEncodeMode, -1);
+
     if (!WriteDataOneSweep(arr, ppByte))
       return false;
+
+    Stats::Add(StatsArrOrder::bytesOneSweep, (double)(*ppByte - ptr0));
   }
 
   return DoChecksOnEncode(ptrBlob, *ppByte);
@@ -577,15 +738,25 @@ bool Lerc2::GetRanges(const Byte* pByte, size_t nBytesRemaining, double* pMins,
 template<class T>
 bool Lerc2::Decode(const Byte** ppByte, size_t& nBytesRemaining, T* arr, Byte* pMaskBits)
 {
+  LERC_TRACE_SCOPE("Lerc2::Decode");
+
   if (!arr || !ppByte || !IsLittleEndianSystem())
     return false;
 
   const Byte* ptrBlob = *ppByte;    // keep a ptr to the start of the blob
+  const Byte* ptr0 = *ppByte;    // start of the current section, for the stats
   size_t nBytesRemaining00 = nBytesRemaining;
 
+  Stats::Add(StatsArrOrder::nBands, 1);
+  Stats::Set(StatsArrOrder::imageEncodeMode, -2);
+  Stats::Set(StatsArrOrder::microBlockSize, 0);
+
   if (!ReadHeader(ppByte, nBytesRemaining, m_headerInfo))
     return false;
 
+  Stats::Add(StatsArrOrder::bytesHeader, (double)(*ppByte - ptr0));
+  ptr0 = *ppByte;
+
   if (nBytesRemaining00 < (size_t)m_headerInfo.blobSize)
     return false;
 
@@ -603,6 +774,9 @@ bool Lerc2::Decode(const Byte** ppByte, size_t& nBytesRemaining, T* arr, Byte* p
   if (!ReadMask(ppByte, nBytesRemaining))
     return false;
 
+  Stats::Add(StatsArrOrder::bytesMask, (double)(*ppByte - ptr0));
+  ptr0 = *ppByte;
+
   if (pMaskBits)    // return proper mask bits even if they were not stored
     memcpy(pMaskBits, m_bitMask.Bits(), m_bitMask.Size());
 
@@ -664,30 +838,54 @@ bool Lerc2::Decode(const Byte** ppByte, size_t& nBytesRemaining, T* arr, Byte* p
 
       if (m_imageEncodeMode != IEM_Tiling)
       {
+        Stats::Set(StatsArrOrder::imageEncodeMode, m_imageEncodeMode);
+        Stats::Add(StatsArrOrder::bytesHeader, (double)(*ppByte - ptr0));
+        ptr0 = *ppByte;
+
         if (m_headerInfo.TryHuffmanInt())
         {
           if (m_imageEncodeMode == IEM_DeltaHuffman || (m_headerInfo.version >= 4 && m_imageEncodeMode == IEM_Huffman))
-            return DecodeHuffman(ppByte, nBytesRemaining, arr);    // done.
+          {
+            bool rv = DecodeHuffman(ppByte, nBytesRemaining, arr);
+            Stats::Add(StatsArrOrder::bytesHuffman, (double)(*ppByte - ptr0));
+            return rv;    // done.
+          }
           else
             return false;
         }
         else if (m_headerInfo.TryHuffmanFlt() && m_imageEncodeMode == IEM_DeltaDeltaHuffman)
         {
-          return LosslessFPCompression::DecodeHuffmanFlt(ppByte, nBytesRemaining, arr,
+          Stats::Timer timer(StatsArrOrder::msFpl);
+          bool rv = LosslessFPCompression::DecodeHuffmanFlt(ppByte, nBytesRemaining, arr,
             (m_headerInfo.dt == DT_Double), m_headerInfo.nCols, m_headerInfo.nRows, m_headerInfo.nDepth);
+          Stats::Add(StatsArrOrder::bytesFpl, (double)(*ppByte - ptr0));
+          return rv;
         }
         else
           return false;
       }
     }
 
+    Stats::Set(StatsArrOrder::imageEncodeMode, IEM_Tiling);
+    Stats::Set(StatsArrOrder::microBlockSize, m_headerInfo.microBlockSize);
+    Stats::Add(StatsArrOrder::bytesHeader, (double)(*ppByte - ptr0));
+    ptr0 = *ppByte;
+
     if (!ReadTiles(ppByte, nBytesRemaining, arr))
       return false;
+
+    Stats::Add(StatsArrOrder::bytesTiles, (double)(*ppByte - ptr0));
   }
   else
   {
+    Stats::Set(StatsArrOrder::imageEncodeMode, -1);
+    Stats::Add(StatsArrOrder::bytesHeader, (double)(*ppByte - ptr0));
+    ptr0 = *ppByte;
+
     if (!ReadDataOneSweep(ppByte, nBytesRemaining, arr))
       return false;
+
+    Stats::Add(StatsArrOrder::bytesOneSweep, (double)(*ppByte - ptr0));
   }
 
   return true;
@@ -707,6 +905,32 @@ template bool Lerc2::Decode<double>(const Byte** ppByte, size_t& nBytesRemaining
 // -------------------------------------------------------------------------- ;
 // -------------------------------------------------------------------------- ;
 
+size_t Lerc2::ComputeNumBytesUpperBound(int nDepth, int nCols, int nRows, DataType dt)
+{
+  if (nDepth <= 0 || nCols <= 0 || nRows <= 0 || dt < DT_Char || dt >= DT_Undefined)
+    return 0;
+
+  // header, the current version has the largest one
+  HeaderInfo hd;
+  hd.RawInit();
+  hd.version = CurrentVersion();
+  size_t numBytes = ComputeNumBytesHeaderToWrite(hd);
+
+  // mask; RLE at worst writes all literal, as odd segments of <= 32767 bytes with a 2 byte count each, plus the EOF count
+  const size_t nPix = (size_t)nCols * nRows;
+  const size_t nBytesMask = (nPix + 7) >> 3;
+  numBytes += sizeof(int) + nBytesMask + 2 * (nBytesMask / 32767 + 1) + 2;
+
+  // min max ranges, flag, and data; ComputeNumBytesNeededToWrite() falls back to writing the data
+  // in one sweep if tiling or Huffman (incl its flag byte) is not smaller
+  const size_t nBytesElem = (size_t)GetDataTypeSize(dt) * nDepth;
+  numBytes += 2 * nBytesElem + 1 + nBytesElem * nPix;
+
+  return numBytes;
+}
+
+// -------------------------------------------------------------------------- ;
+
 unsigned int Lerc2::ComputeNumBytesHeaderToWrite(const struct HeaderInfo& hd)
 {
   unsigned int numBytes = (unsigned int)FileKey().length();
@@ -920,6 +1144,9 @@ bool Lerc2::ReadHeader(const Byte** ppByte, size_t& nBytesRemainingInOut, struct
 
 bool Lerc2::WriteMask(Byte** ppByte) const
 {
+  Stats::Timer timer(StatsArrOrder::msMask);
+  LERC_TRACE_SCOPE("Lerc2::WriteMask");
+
   if (!ppByte)
     return false;
 
@@ -932,19 +1159,14 @@ bool Lerc2::WriteMask(Byte** ppByte) const
 
   if (needMask && m_encodeMask)
   {
-    Byte* pArrRLE;
-    size_t numBytesRLE;
-    RLE rle;
-    if (!rle.compress((const Byte*)m_bitMask.Bits(), m_bitMask.Size(), &pArrRLE, numBytesRLE, false))
+    if (!m_maskRLEValid)    // see ComputeNumBytesNeededToWrite()
       return false;
 
-    int numBytesMask = (int)numBytesRLE;
+    int numBytesMask = (int)m_maskRLE.size();
     memcpy(ptr, &numBytesMask, sizeof(int));    // num bytes for compressed mask
     ptr += sizeof(int);
-    memcpy(ptr, pArrRLE, numBytesRLE);
-    ptr += numBytesRLE;
-
-    delete[] pArrRLE;
+    memcpy(ptr, &m_maskRLE[0], m_maskRLE.size());
+    ptr += m_maskRLE.size();
   }
   else
   {
@@ -960,6 +1182,9 @@ bool Lerc2::WriteMask(Byte** ppByte) const
 
 bool Lerc2::ReadMask(const Byte** ppByte, size_t& nBytesRemainingInOut)
 {
+  Stats::Timer timer(StatsArrOrder::msMask);
+  LERC_TRACE_SCOPE("Lerc2::ReadMask");
+
   if (!ppByte)
     return false;
 
@@ -983,6 +1208,8 @@ bool Lerc2::ReadMask(const Byte** ppByte, size_t& nBytesRemainingInOut)
   if (!m_bitMask.SetSize(w, h))
     return false;
 
+  m_maskRLEValid = false;
+
   if (numValid == 0)
     m_bitMask.SetAllInvalid();
   else if (numValid == w * h)
@@ -1068,9 +1295,62 @@ unsigned int Lerc2::ComputeChecksumFletcher32(const Byte* pByte, int len)
 // for the theory and math, see
 // https://pdfs.semanticscholar.org/d064/2e2ad1a4c3b445b0d795770f604a5d9e269c.pdf
 
+void Lerc2::AddToBitPlaneCounts(const unsigned int* pVal, size_t num, int nBits, int* pCounts)
+{
+  size_t i = 0;
+
+#ifdef LERC_HAVE_SSE2
+  // 4 values at a time; the byte counters in acc[b] count the bits b, b + 8, b + 16, b + 24 of each value
+  const __m128i one = _mm_set1_epi8(1);
+  const size_t num4 = num & ~(size_t)3;
+
+  while (i < num4)
+  {
+    __m128i acc[8];
+    for (int b = 0; b < 8; b++)
+      acc[b] = _mm_setzero_si128();
+
+    size_t iEnd = std::min(num4, i + 4 * 255);    // byte counters must not overflow
+
+    for (; i < iEnd; i += 4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(pVal + i));
+      for (int b = 0; b < 8; b++, v = _mm_srli_epi32(v, 1))
+        acc[b] = _mm_add_epi8(acc[b], _mm_and_si128(v, one));
+    }
+
+    for (int b = 0; b < 8; b++)
+    {
+      Byte cnt[16];
+      _mm_storeu_si128((__m128i*)cnt, acc[b]);
+
+      for (int k = 0; k < 16; k++)
+      {
+        int bit = 8 * (k & 3) + b;
+        if (bit < nBits)
+          pCounts[bit] += cnt[k];
+      }
+    }
+  }
+#endif
+
+  for (; i < num; i++)
+  {
+    unsigned int val = pVal[i];
+    pCounts[0] += val & 1;
+    for (int k = 1; k < nBits; k++)
+      pCounts[k] += (val >>= 1) & 1;
+  }
+}
+
+// -------------------------------------------------------------------------- ;
+
 template<class T>
 bool Lerc2::TryBitPlaneCompression(const T* data, double eps, double& newMaxZError) const
 {
+  Stats::Timer timer(StatsArrOrder::msTryBitPlaneCompression);
+  LERC_TRACE_SCOPE("Lerc2::TryBitPlaneCompression");
+
   newMaxZError = 0;    // lossless is the obvious fallback
 
   if (!data || eps <= 0)
@@ -1084,97 +1364,65 @@ bool Lerc2::TryBitPlaneCompression(const T* data, double eps, double& newMaxZErr
   if (hd.numValidPixel < minCnt)    // not enough data for good stats
     return false;
 
+  if (hd.dt >= DT_Float)
+    return false;    // unsupported data type
+
+  // xor of neighbors, signed types get sign extended, only the lower maxShift bits get counted
   std::vector<int> cntDiffVec((size_t)nDepth * maxShift, 0);
+  std::vector<unsigned int> diffVec((size_t)nDepth * 2 * hd.nCols + 1);    // per row, 2 neighbors per pixel
+  const int rowStep = m_bitPlaneRowStep;
   int cnt = 0;
 
   if (nDepth == 1 && hd.numValidPixel == hd.nCols * hd.nRows)    // special but common case
   {
-    if (hd.dt == DT_Byte || hd.dt == DT_UShort || hd.dt == DT_UInt)    // unsigned int
+    for (int i = 0; i < hd.nRows - 1; i += rowStep)
     {
-      for (int i = 0; i < hd.nRows - 1; i++)
-        for (int k = i * hd.nCols, j = 0; j < hd.nCols - 1; j++, k++)
-        {
-          unsigned int c = ((unsigned int)data[k]) ^ ((unsigned int)data[k + 1]);
-          AddUIntToCounts(&cntDiffVec[0], c, maxShift);
-          cnt++;
-          c = ((unsigned int)data[k]) ^ ((unsigned int)data[k + hd.nCols]);
-          AddUIntToCounts(&cntDiffVec[0], c, maxShift);
-          cnt++;
-        }
-    }
-    else if (hd.dt == DT_Char || hd.dt == DT_Short || hd.dt == DT_Int)    // signed int
-    {
-      for (int i = 0; i < hd.nRows - 1; i++)
-        for (int k = i * hd.nCols, j = 0; j < hd.nCols - 1; j++, k++)
-        {
-          int c = ((int)data[k]) ^ ((int)data[k + 1]);
-          AddIntToCounts(&cntDiffVec[0], c, maxShift);
-          cnt++;
-          c = ((int)data[k]) ^ ((int)data[k + hd.nCols]);
-          AddIntToCounts(&cntDiffVec[0], c, maxShift);
-          cnt++;
-        }
+      const T* row = data + (size_t)i * hd.nCols;
+      const T* rowBelow = row + hd.nCols;
+      unsigned int* pDiff = &diffVec[0];
+
+      for (int j = 0; j < hd.nCols - 1; j++)
+      {
+        *pDiff++ = ((unsigned int)row[j]) ^ ((unsigned int)row[j + 1]);
+        *pDiff++ = ((unsigned int)row[j]) ^ ((unsigned int)rowBelow[j]);
+      }
+
+      int nDiff = (int)(pDiff - &diffVec[0]);
+      AddToBitPlaneCounts(&diffVec[0], nDiff, maxShift, &cntDiffVec[0]);
+      cnt += nDiff;
     }
-    else
-      return false;    // unsupported data type
   }
 
   else    // general case:  nDepth > 1 or not all pixel valid
   {
-    if (hd.dt == DT_Byte || hd.dt == DT_UShort || hd.dt == DT_UInt)    // unsigned int
+    const size_t depthStride = (size_t)2 * hd.nCols;
+
+    for (int i = 0; i < hd.nRows; i += rowStep)
     {
-      for (int k = 0, m0 = 0, i = 0; i < hd.nRows; i++)
-        for (int j = 0; j < hd.nCols; j++, k++, m0 += nDepth)
-          if (m_bitMask.IsValid(k))
+      int64_t k0 = (int64_t)i * hd.nCols, k1 = k0 + hd.nCols;
+      int nDiff = 0;
+
+      for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+        for (int k = (int)r0, m0 = k * nDepth; k < r1; k++, m0 += nDepth)
+        {
+          if (k < r1 - 1)    // hori
           {
-            if (j < hd.nCols - 1 && m_bitMask.IsValid(k + 1))    // hori
-            {
-              for (int s0 = 0, m = 0; m < nDepth; m++, s0 += maxShift)
-              {
-                unsigned int c = ((unsigned int)data[m0 + m]) ^ ((unsigned int)data[m0 + m + nDepth]);
-                AddUIntToCounts(&cntDiffVec[s0], c, maxShift);
-              }
-              cnt++;
-            }
-            if (i < hd.nRows - 1 && m_bitMask.IsValid(k + hd.nCols))    // vert
-            {
-              for (int s0 = 0, m = 0; m < nDepth; m++, s0 += maxShift)
-              {
-                unsigned int c = ((unsigned int)data[m0 + m]) ^ ((unsigned int)data[m0 + m + nDepth * hd.nCols]);
-                AddUIntToCounts(&cntDiffVec[s0], c, maxShift);
-              }
-              cnt++;
-            }
+            for (int m = 0; m < nDepth; m++)
+              diffVec[m * depthStride + nDiff] = ((unsigned int)data[m0 + m]) ^ ((unsigned int)data[m0 + m + nDepth]);
+            nDiff++;
           }
-    }
-    else if (hd.dt == DT_Char || hd.dt == DT_Short || hd.dt == DT_Int)    // signed int
-    {
-      for (int k = 0, m0 = 0, i = 0; i < hd.nRows; i++)
-        for (int j = 0; j < hd.nCols; j++, k++, m0 += nDepth)
-          if (m_bitMask.IsValid(k))
+          if (i < hd.nRows - 1 && m_bitMask.IsValid(k + hd.nCols))    // vert
           {
-            if (j < hd.nCols - 1 && m_bitMask.IsValid(k + 1))    // hori
-            {
-              for (int s0 = 0, m = 0; m < nDepth; m++, s0 += maxShift)
-              {
-                int c = ((int)data[m0 + m]) ^ ((int)data[m0 + m + nDepth]);
-                AddIntToCounts(&cntDiffVec[s0], c, maxShift);
-              }
-              cnt++;
-            }
-            if (i < hd.nRows - 1 && m_bitMask.IsValid(k + hd.nCols))    // vert
-            {
-              for (int s0 = 0, m = 0; m < nDepth; m++, s0 += maxShift)
-              {
-                int c = ((int)data[m0 + m]) ^ ((int)data[m0 + m + nDepth * hd.nCols]);
-                AddIntToCounts(&cntDiffVec[s0], c, maxShift);
-              }
-              cnt++;
-            }
+            for (int m = 0; m < nDepth; m++)
+              diffVec[m * depthStride + nDiff] = ((unsigned int)data[m0 + m]) ^ ((unsigned int)data[m0 + m + nDepth * hd.nCols]);
+            nDiff++;
           }
+        }
+
+      for (int m = 0; m < nDepth; m++)
+        AddToBitPlaneCounts(&diffVec[m * depthStride], nDiff, maxShift, &cntDiffVec[m * maxShift]);
+      cnt += nDiff;
     }
-    else
-      return false;    // unsupported data type
   }
 
   if (cnt < minCnt)    // not enough data for good stats
@@ -1233,6 +1481,9 @@ bool Lerc2::TryBitPlaneCompression(const T* data, double eps, double& newMaxZErr
 template<class T>
 bool Lerc2::TryRaiseMaxZError(const T* data, double& maxZError) const
 {
+  Stats::Timer timer(StatsArrOrder::msTryRaiseMaxZError);
+  LERC_TRACE_SCOPE("Lerc2::TryRaiseMaxZError");
+
   if (!data || m_headerInfo.dt < DT_Float || m_headerInfo.numValidPixel == 0)
     return false;
 
@@ -1253,6 +1504,61 @@ bool Lerc2::TryRaiseMaxZError(const T* data, double& maxZError) const
   if (zErr.empty())
     return false;
 
+  // test a sample first, most float data are no low precision decimals and fail all candidates right away;
+  // the sample is tested against all candidates, the full scan below against fewer, so it breaks less often
+  // and finds the same or larger round errors; a candidate failing on the sample fails there too
+  {
+    const int64_t nPix = (int64_t)hd.nCols * hd.nRows;
+    const bool bAllValid = (hd.numValidPixel == nPix);
+    const int64_t sampleStep = 97;
+    const size_t nCand = zErr.size();
+    std::vector<double> sampleErr(nCand, 0);
+
+    auto numFailed = [&]()
+    {
+      size_t cnt = 0;
+      for (size_t n = 0; n < nCand; n++)
+        if (sampleErr[n] / zFac[n] > maxZError / 2)
+          cnt++;
+      return cnt;
+    };
+
+    for (int64_t k = 0; k < nPix; k += sampleStep)
+    {
+      if (!bAllValid && !m_bitMask.IsValid(k))
+        continue;
+
+      for (int m = 0; m < nDepth; m++)
+      {
+        double x = data[k * nDepth + m];
+
+        for (size_t n = 0; n < nCand; n++)
+        {
+          double z = x * zFac[n];
+          if (z == (int)z)
+            break;
+
+          double delta = fabs(floor(z + 0.5) - z);
+          sampleErr[n] = std::max(sampleErr[n], delta);
+        }
+      }
+
+      if (numFailed() == nCand)
+        return false;
+    }
+
+    // failed candidates behind the last one passing cannot change the result, drop them
+    while (!zErr.empty() && sampleErr[zErr.size() - 1] / zFac.back() > maxZError / 2)
+    {
+      zErr.pop_back();
+      zFac.pop_back();
+      roundErr.pop_back();
+    }
+
+    if (zErr.empty())
+      return false;
+  }
+
   if (nDepth == 1 && hd.numValidPixel == hd.nCols * hd.nRows)    // special but common case
   {
     for (int i = 0; i < hd.nRows; i++)
@@ -1281,26 +1587,29 @@ bool Lerc2::TryRaiseMaxZError(const T* data, double& maxZError) const
 
   else    // general case:  nDepth > 1 or not all pixel valid
   {
-    for (int k = 0, m0 = 0, i = 0; i < hd.nRows; i++)
+    for (int i = 0; i < hd.nRows; i++)
     {
       size_t nCand = zErr.size();
+      int64_t k0 = (int64_t)i * hd.nCols, k1 = k0 + hd.nCols;
 
-      for (int j = 0; j < hd.nCols; j++, k++, m0 += nDepth)
-        if (m_bitMask.IsValid(k))
-          for (int m = 0; m < nDepth; m++)
-          {
-            double x = data[m0 + m];
+      for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+      {
+        const T* p = data + r0 * nDepth;
+        for (int64_t m = 0, num = (r1 - r0) * nDepth; m < num; m++)
+        {
+          double x = p[m];
 
-            for (size_t n = 0; n < nCand; n++)
-            {
-              double z = x * zFac[n];
-              if (z == (int)z)
-                break;
+          for (size_t n = 0; n < nCand; n++)
+          {
+            double z = x * zFac[n];
+            if (z == (int)z)
+              break;
 
-              double delta = fabs(floor(z + 0.5) - z);
-              roundErr[n] = std::max(roundErr[n], delta);
-            }
+            double delta = fabs(floor(z + 0.5) - z);
+            roundErr[n] = std::max(roundErr[n], delta);
           }
+        }
+      }
 
       if (!PruneCandidates(roundErr, zErr, zFac, maxZError))
         return false;
@@ -1402,74 +1711,180 @@ bool Lerc2::ReadDataOneSweep(const Byte** ppByte, size_t& nBytesRemaining, T* da
 // -------------------------------------------------------------------------- ;
 
 template<class T>
-bool Lerc2::ComputeMinMaxRanges(const T* data, std::vector<double>& zMinVecA, std::vector<double>& zMaxVecA) const
+bool Lerc2::ComputeTileStats(const T* data, int mbSize)
 {
-  if (!data || m_headerInfo.numValidPixel == 0)
+  Stats::Timer timer(StatsArrOrder::msComputeMinMaxRanges);
+  LERC_TRACE_SCOPE("Lerc2::ComputeTileStats");
+
+  m_tileStatsMbSize = 0;
+
+  if (!data || mbSize <= 0)
     return false;
 
   const HeaderInfo& hd = m_headerInfo;
   const int nDepth = hd.nDepth;
-  bool bInit = false;
+  const int numTilesVert = (hd.nRows + mbSize - 1) / mbSize;
+  const int numTilesHori = (hd.nCols + mbSize - 1) / mbSize;
 
-  zMinVecA.resize(nDepth);
-  zMaxVecA.resize(nDepth);
+  typedef TileStatsOf<T> TS;
+  std::vector<TS>& tileStatsVec = TileStatsVec((const TS*)nullptr);
+  tileStatsVec.resize((size_t)numTilesVert * numTilesHori * nDepth);
 
-  std::vector<T> zMinVec(nDepth, 0), zMaxVec(nDepth, 0);
+  // rows of tiles are independent, each writes its own slots
+  std::vector<char> rowOk(numTilesVert, 0);
+  int maxThreads = ((size_t)hd.nCols * hd.nRows * nDepth < ((size_t)1 << 20)) ? 1 : 0;
 
-  if (hd.numValidPixel == hd.nRows * hd.nCols)    // all valid, no mask
+  Parallel::For(numTilesVert, [&](size_t iTile)
   {
-    bInit = true;
-    for (int m = 0; m < nDepth; m++)
-      zMinVec[m] = zMaxVec[m] = data[m];
-
-    for (int m0 = 0, i = 0; i < hd.nRows; i++)
-      for (int j = 0; j < hd.nCols; j++, m0 += nDepth)
-        for (int m = 0; m < nDepth; m++)
-        {
-          T val = data[m0 + m];
+    std::vector<T> dataVec((size_t)mbSize * mbSize, 0);
+    int i0 = (int)iTile * mbSize;
+    int i1 = std::min(i0 + mbSize, hd.nRows);
+    TS* pStats = &tileStatsVec[iTile * numTilesHori * nDepth];
 
-          if (val < zMinVec[m])
-            zMinVec[m] = val;
-          else if (val > zMaxVec[m])
-            zMaxVec[m] = val;
-        }
-  }
-  else
-  {
-    for (int k = 0, m0 = 0, i = 0; i < hd.nRows; i++)
-      for (int j = 0; j < hd.nCols; j++, k++, m0 += nDepth)
-        if (m_bitMask.IsValid(k))
-        {
-          if (bInit)
-            for (int m = 0; m < nDepth; m++)
-            {
-              T val = data[m0 + m];
+    for (int jTile = 0; jTile < numTilesHori; jTile++)
+    {
+      int j0 = jTile * mbSize;
+      int j1 = std::min(j0 + mbSize, hd.nCols);
 
-              if (val < zMinVec[m])
-                zMinVec[m] = val;
-              else if (val > zMaxVec[m])
-                zMaxVec[m] = val;
-            }
-          else
-          {
-            bInit = true;
-            for (int m = 0; m < nDepth; m++)
-              zMinVec[m] = zMaxVec[m] = data[m0 + m];
-          }
-        }
-  }
+      for (int iDepth = 0; iDepth < nDepth; iDepth++, pStats++)
+      {
+        T zMin = 0, zMax = 0;
+        int numValidPixel = 0;
+        if (!GetValidDataAndStats(data, i0, i1, j0, j1, iDepth, &dataVec[0], zMin, zMax, numValidPixel, pStats->tryLut))
+          return;
 
-  if (bInit)
-    for (int m = 0; m < nDepth; m++)
-    {
-      zMinVecA[m] = zMinVec[m];
-      zMaxVecA[m] = zMaxVec[m];
+        pStats->zMin = zMin;
+        pStats->zMax = zMax;
+        pStats->numValidPixel = (unsigned short)numValidPixel;
+      }
     }
 
-  return bInit;
-}
+    rowOk[iTile] = 1;
+  }, maxThreads);
 
-// -------------------------------------------------------------------------- ;
+  if (std::find(rowOk.begin(), rowOk.end(), 0) != rowOk.end())
+    return false;
+
+  m_tileStatsMbSize = mbSize;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+template<class T>
+void Lerc2::MergeTileStats()
+{
+  Stats::Timer timer(StatsArrOrder::msComputeMinMaxRanges);
+  LERC_TRACE_SCOPE("Lerc2::MergeTileStats");
+
+  const HeaderInfo& hd = m_headerInfo;
+  const int nDepth = hd.nDepth;
+  const int mbSize = m_tileStatsMbSize;
+
+  if (mbSize <= 0)
+    return;
+
+  const int numTilesVert = (hd.nRows + mbSize - 1) / mbSize;
+  const int numTilesHori = (hd.nCols + mbSize - 1) / mbSize;
+  const int numTilesVert2 = (numTilesVert + 1) / 2;
+  const int numTilesHori2 = (numTilesHori + 1) / 2;
+
+  typedef TileStatsOf<T> TS;
+  std::vector<TS>& tileStatsVec = TileStatsVec((const TS*)nullptr);
+  std::vector<TS> tileStatsVec2((size_t)numTilesVert2 * numTilesHori2 * nDepth);
+  TS* pStats2 = &tileStatsVec2[0];
+
+  for (int iTile2 = 0; iTile2 < numTilesVert2; iTile2++)
+    for (int jTile2 = 0; jTile2 < numTilesHori2; jTile2++)
+      for (int iDepth = 0; iDepth < nDepth; iDepth++, pStats2++)
+      {
+        TS ts = { 0, 0, 0, false };
+
+        for (int iTile = 2 * iTile2; iTile < std::min(2 * iTile2 + 2, numTilesVert); iTile++)
+          for (int jTile = 2 * jTile2; jTile < std::min(2 * jTile2 + 2, numTilesHori); jTile++)
+          {
+            const TS& child = tileStatsVec[((size_t)iTile * numTilesHori + jTile) * nDepth + iDepth];
+
+            if (child.numValidPixel == 0)
+              continue;
+
+            if (ts.numValidPixel == 0)
+            {
+              ts.zMin = child.zMin;
+              ts.zMax = child.zMax;
+            }
+            else
+            {
+              ts.zMin = std::min(ts.zMin, child.zMin);
+              ts.zMax = std::max(ts.zMax, child.zMax);
+            }
+
+            ts.numValidPixel += child.numValidPixel;
+            ts.tryLut = ts.tryLut || child.tryLut;    // not exact, but WriteTiles() reads the data for these
+          }
+
+        *pStats2 = ts;
+      }
+
+  tileStatsVec.swap(tileStatsVec2);
+  m_tileStatsMbSize = 2 * mbSize;
+}
+
+// -------------------------------------------------------------------------- ;
+
+template<class T>
+bool Lerc2::ComputeMinMaxRanges(std::vector<double>& zMinVecA, std::vector<double>& zMaxVecA) const
+{
+  Stats::Timer timer(StatsArrOrder::msComputeMinMaxRanges);
+  LERC_TRACE_SCOPE("Lerc2::ComputeMinMaxRanges");
+
+  const HeaderInfo& hd = m_headerInfo;
+  const int nDepth = hd.nDepth;
+
+  if (hd.numValidPixel == 0 || m_tileStatsMbSize == 0)
+    return false;
+
+  // the tile stats are exact, so are their min and max
+  std::vector<double> zMinVec(nDepth, DBL_MAX), zMaxVec(nDepth, -DBL_MAX);
+  bool bInit = false;
+
+  typedef TileStatsOf<T> TS;
+  const std::vector<TS>& tileStatsVec = TileStatsVec((const TS*)nullptr);
+
+  for (size_t k = 0; k < tileStatsVec.size(); k += nDepth)
+  {
+    const TS* pStats = &tileStatsVec[k];
+
+    if (pStats[0].numValidPixel == 0)    // same mask for all depths
+      continue;
+
+    bInit = true;
+    for (int m = 0; m < nDepth; m++)
+    {
+      zMinVec[m] = std::min(zMinVec[m], (double)pStats[m].zMin);
+      zMaxVec[m] = std::max(zMaxVec[m], (double)pStats[m].zMax);
+    }
+  }
+
+  if (bInit)
+  {
+    zMinVecA = zMinVec;
+    zMaxVecA = zMaxVec;
+  }
+
+  return bInit;
+}
+
+// -------------------------------------------------------------------------- ;
+
+void Lerc2::ClearTileStats()
+{
+  std::vector<TileStats<float> >().swap(m_tileStatsVecFlt);    // free the memory, not just resize to 0
+  std::vector<TileStats<double> >().swap(m_tileStatsVecDbl);
+  m_tileStatsMbSize = 0;
+}
+
+// -------------------------------------------------------------------------- ;
 
 template<class T>
 bool Lerc2::WriteTiles(const T* data, Byte** ppByte, int& numBytes) const
@@ -1477,6 +1892,10 @@ bool Lerc2::WriteTiles(const T* data, Byte** ppByte, int& numBytes) const
   if (!data || !ppByte)
     return false;
 
+  LERC_TRACE_SCOPE("Lerc2::WriteTiles");
+  Stats::Timer timer(StatsArrOrder::msTiles);
+  Stats::Add(StatsArrOrder::numWriteTilesPasses, 1);
+
   numBytes = 0;
   int numBytesLerc = 0;
 
@@ -1497,6 +1916,11 @@ bool Lerc2::WriteTiles(const T* data, Byte** ppByte, int& numBytes) const
   const bool bCheckForIntOverflow = NeedToCheckForIntOverflow(hd);
   const bool bCheckForFltRndErr = NeedToCheckForFltRndErr(hd);
 
+  // if only counting bytes, take the stats from ComputeTileStats() and skip the data where possible
+  const bool bUseTileStats = !(*ppByte) && !bTryDiffEnc && (m_tileStatsMbSize == mbSize);
+  typedef TileStatsOf<T> TS;
+  const std::vector<TS>& tileStatsVec = TileStatsVec((const TS*)nullptr);
+
   int mbDiff2 = bTryDiffEnc ? mbSize * mbSize : 0;
   std::vector<int> diffDataVecInt(mbDiff2, 0);    // use fixed type (int) for difference of all int types
   std::vector<T> diffDataVecFlt(mbDiff2, 0), prevDataVec(mbDiff2, 0);
@@ -1518,6 +1942,8 @@ bool Lerc2::WriteTiles(const T* data, Byte** ppByte, int& numBytes) const
       if (jTile == numTilesHori - 1)
         tileW = hd.nCols - j0;
 
+      const TS* pStats = bUseTileStats ? &tileStatsVec[((size_t)iTile * numTilesHori + jTile) * nDepth] : nullptr;
+
       for (int iDepth = 0; iDepth < nDepth; iDepth++)
       {
         T zMin = 0, zMax = 0;
@@ -1525,7 +1951,13 @@ bool Lerc2::WriteTiles(const T* data, Byte** ppByte, int& numBytes) const
         bool bQuantizeDone = false;
         bool tryLut = false;
 
-        if (!GetValidDataAndStats(data, i0, i0 + tileH, j0, j0 + tileW, iDepth, dataBuf, zMin, zMax, numValidPixel, tryLut))
+        if (pStats && !pStats[iDepth].tryLut)    // NumBytesTile() needs no data then
+        {
+          zMin = (T)pStats[iDepth].zMin;
+          zMax = (T)pStats[iDepth].zMax;
+          numValidPixel = pStats[iDepth].numValidPixel;
+        }
+        else if (!GetValidDataAndStats(data, i0, i0 + tileH, j0, j0 + tileW, iDepth, dataBuf, zMin, zMax, numValidPixel, tryLut))
           return false;
 
         if (numValidPixel == 0 && !(*ppByte))
@@ -1671,15 +2103,31 @@ bool Lerc2::WriteTiles(const T* data, Byte** ppByte, int& numBytes) const
 
 template<class T>
 bool Lerc2::ReadTiles(const Byte** ppByte, size_t& nBytesRemaining, T* data) const
+{
+  Stats::Timer timer(StatsArrOrder::msTiles);
+  LERC_TRACE_SCOPE("Lerc2::ReadTiles");
+
+  // pick the tile kernel once per band, common nDepth get the pixel stride at compile time
+  switch (m_headerInfo.nDepth)
+  {
+    case 1:  return ReadTilesN<1>(ppByte, nBytesRemaining, data);
+    case 3:  return ReadTilesN<3>(ppByte, nBytesRemaining, data);
+    case 4:  return ReadTilesN<4>(ppByte, nBytesRemaining, data);
+    default: return ReadTilesN<0>(ppByte, nBytesRemaining, data);
+  }
+}
+
+// -------------------------------------------------------------------------- ;
+
+template<int N, class T>
+bool Lerc2::ReadTilesN(const Byte** ppByte, size_t& nBytesRemaining, T* data) const
 {
   if (!data || !ppByte || !(*ppByte))
     return false;
 
-  std::vector<unsigned int> bufferVec;
-
   const HeaderInfo& hd = m_headerInfo;
   int mbSize = hd.microBlockSize;
-  int nDepth = hd.nDepth;
+  const int nDepth = N > 0 ? N : hd.nDepth;
 
   if (mbSize > 32)
     return false;
@@ -1687,28 +2135,87 @@ bool Lerc2::ReadTiles(const Byte** ppByte, size_t& nBytesRemaining, T* data) con
   int numTilesVert = (hd.nRows + mbSize - 1) / mbSize;
   int numTilesHori = (hd.nCols + mbSize - 1) / mbSize;
 
+  auto readRowOfTiles = [&](int iTile, const Byte** ppByteRow, size_t& nBytesRow,
+    const BitStuffer2& bitStuffer2, std::vector<unsigned int>& bufferVec)
+  {
+    int i0 = iTile * mbSize;
+    int i1 = std::min(i0 + mbSize, hd.nRows);
+
+    for (int jTile = 0; jTile < numTilesHori; jTile++)
+    {
+      int j0 = jTile * mbSize;
+      int j1 = std::min(j0 + mbSize, hd.nCols);
+
+      for (int iDepth = 0; iDepth < nDepth; iDepth++)
+        if (!ReadTile<N>(ppByteRow, nBytesRow, data, i0, i1, j0, j1, iDepth, bitStuffer2, bufferVec))
+          return false;
+    }
+    return true;
+  };
+
+  // tiles have no offset table, but for Lerc2 v3+ a quick pass over the tile headers finds where
+  // each row of tiles starts, then the rows of tiles are independent
+  bool bLarge = (size_t)hd.nCols * hd.nRows * nDepth >= ((size_t)1 << 18);
+
+  if (hd.version < 3 || !bLarge || Parallel::NumThreads(numTilesVert) < 2)
+  {
+    std::vector<unsigned int> bufferVec;
+
+    for (int iTile = 0; iTile < numTilesVert; iTile++)
+      if (!readRowOfTiles(iTile, ppByte, nBytesRemaining, m_bitStuffer2, bufferVec))
+        return false;
+
+    return true;
+  }
+
+  std::vector<const Byte*> rowStartVec(numTilesVert + 1);
+  const Byte* ptr = *ppByte;
+  size_t nBytes = nBytesRemaining;
+
   for (int iTile = 0; iTile < numTilesVert; iTile++)
   {
-    int tileH = mbSize;
-    int i0 = iTile * tileH;
-    if (iTile == numTilesVert - 1)
-      tileH = hd.nRows - i0;
+    rowStartVec[iTile] = ptr;
+    int i0 = iTile * mbSize;
+    int i1 = std::min(i0 + mbSize, hd.nRows);
 
     for (int jTile = 0; jTile < numTilesHori; jTile++)
     {
-      int tileW = mbSize;
-      int j0 = jTile * tileW;
-      if (jTile == numTilesHori - 1)
-        tileW = hd.nCols - j0;
+      int j0 = jTile * mbSize;
+      int j1 = std::min(j0 + mbSize, hd.nCols);
 
       for (int iDepth = 0; iDepth < nDepth; iDepth++)
-      {
-        if (!ReadTile(ppByte, nBytesRemaining, data, i0, i0 + tileH, j0, j0 + tileW, iDepth, bufferVec))
+        if (!SkipTile(&ptr, nBytes, i0, i1, j0, j1, iDepth, sizeof(T)))
           return false;
-      }
     }
   }
+  rowStartVec[numTilesVert] = ptr;
 
+  // each row of tiles writes its own rows of pixels, and needs its own bit stuffer for the temp buffers
+  // and its own stats for the tile counts
+  std::vector<char> rowOk(numTilesVert, 0);
+  Stats* pStats = Stats::Current();
+  std::vector<Stats> rowStatsVec(pStats ? numTilesVert : 0);
+
+  Parallel::For(numTilesVert, [&](size_t iTile)
+  {
+    Stats::TaskScope statsScope(pStats ? &rowStatsVec[iTile] : nullptr);
+    BitStuffer2 bitStuffer2;
+    std::vector<unsigned int> bufferVec;
+    const Byte* ptrRow = rowStartVec[iTile];
+    size_t nBytesRow = (size_t)(rowStartVec[iTile + 1] - ptrRow);
+
+    if (readRowOfTiles((int)iTile, &ptrRow, nBytesRow, bitStuffer2, bufferVec) && nBytesRow == 0)
+      rowOk[iTile] = 1;
+  });
+
+  for (const Stats& rowStats : rowStatsVec)
+    pStats->AddAll(rowStats);
+
+  if (std::find(rowOk.begin(), rowOk.end(), 0) != rowOk.end())
+    return false;
+
+  *ppByte = ptr;
+  nBytesRemaining = nBytes;
   return true;
 }
 
@@ -1717,6 +2224,21 @@ bool Lerc2::ReadTiles(const Byte** ppByte, size_t& nBytesRemaining, T* data) con
 template<class T>
 bool Lerc2::GetValidDataAndStats(const T* data, int i0, int i1, int j0, int j1, int iDepth,
   T* dataBuf, T& zMin, T& zMax, int& numValidPixel, bool& tryLut) const
+{
+  switch (m_headerInfo.nDepth)    // see ReadTiles()
+  {
+    case 1:  return GetValidDataAndStatsN<1>(data, i0, i1, j0, j1, iDepth, dataBuf, zMin, zMax, numValidPixel, tryLut);
+    case 3:  return GetValidDataAndStatsN<3>(data, i0, i1, j0, j1, iDepth, dataBuf, zMin, zMax, numValidPixel, tryLut);
+    case 4:  return GetValidDataAndStatsN<4>(data, i0, i1, j0, j1, iDepth, dataBuf, zMin, zMax, numValidPixel, tryLut);
+    default: return GetValidDataAndStatsN<0>(data, i0, i1, j0, j1, iDepth, dataBuf, zMin, zMax, numValidPixel, tryLut);
+  }
+}
+
+// -------------------------------------------------------------------------- ;
+
+template<int N, class T>
+bool Lerc2::GetValidDataAndStatsN(const T* data, int i0, int i1, int j0, int j1, int iDepth,
+  T* dataBuf, T& zMin, T& zMax, int& numValidPixel, bool& tryLut) const
 {
   const HeaderInfo& hd = m_headerInfo;
 
@@ -1728,7 +2250,7 @@ bool Lerc2::GetValidDataAndStats(const T* data, int i0, int i1, int j0, int j1,
 
   T prevVal = 0;
   int cnt = 0, cntSameVal = 0;
-  int nDepth = hd.nDepth;
+  const int nDepth = N > 0 ? N : hd.nDepth;
 
   if (hd.numValidPixel == hd.nCols * hd.nRows)    // all valid, no mask
   {
@@ -1763,31 +2285,38 @@ bool Lerc2::GetValidDataAndStats(const T* data, int i0, int i1, int j0, int j1,
   {
     for (int i = i0; i < i1; i++)
     {
-      int k = i * hd.nCols + j0;
-      int m = k * nDepth + iDepth;
+      int64_t k0 = (int64_t)i * hd.nCols + j0, k1 = k0 + (j1 - j0);
 
-      for (int j = j0; j < j1; j++, k++, m += nDepth)
-        if (m_bitMask.IsValid(k))
+      for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+      {
+        int k = (int)r0, m = k * nDepth + iDepth;
+
+        if (cnt == 0)    // init
+        {
+          T val = data[m];
+          dataBuf[cnt++] = val;
+          zMin = zMax = prevVal = val;
+          k++;
+          m += nDepth;
+        }
+
+        for (; k < r1; k++, m += nDepth)
         {
           T val = data[m];
           dataBuf[cnt] = val;
 
-          if (cnt > 0)
-          {
-            if (val < zMin)
-              zMin = val;
-            else if (val > zMax)
-              zMax = val;
+          if (val < zMin)
+            zMin = val;
+          else if (val > zMax)
+            zMax = val;
 
-            if (val == prevVal)
-              cntSameVal++;
-          }
-          else
-            zMin = zMax = val;    // init
+          if (val == prevVal)
+            cntSameVal++;
 
           prevVal = val;
           cnt++;
         }
+      }
     }
   }
 
@@ -1962,6 +2491,7 @@ bool Lerc2::WriteTile(const T* dataBuf, int num, Byte** ppByte, int& numBytesWri
     *ptr++ = comprFlag | 2;    // set compression flag to 2 to mark tile as constant 0
     numBytesWritten = 1;
     *ppByte = ptr;
+    Stats::Add(StatsArrOrder::numTilesConst, 1);
     return true;
   }
 
@@ -1970,6 +2500,8 @@ bool Lerc2::WriteTile(const T* dataBuf, int num, Byte** ppByte, int& numBytesWri
     if (bDiffEnc)
       return false;    // doesn't make sense, should not happen
 
+    Stats::Add(StatsArrOrder::numTilesRawBinary, 1);
+
     *ptr++ = comprFlag | 0;    // write z's binary uncompressed
 
     memcpy(ptr, dataBuf, num * sizeof(T));
@@ -1995,11 +2527,15 @@ bool Lerc2::WriteTile(const T* dataBuf, int num, Byte** ppByte, int& numBytesWri
     if (!WriteVariableDataType(&ptr, (double)zMin, dtReduced))
       return false;
 
-    if (maxElem > 0)
+    if (maxElem == 0)
+      Stats::Add(StatsArrOrder::numTilesConst, 1);
+    else
     {
       if ((int)quantVec.size() != num)
         return false;
 
+      Stats::Add(blockEncodeMode == BEM_BitStuffLUT ? StatsArrOrder::numTilesBitStuffLUT : StatsArrOrder::numTilesBitStuffSimple, 1);
+
       if (blockEncodeMode == BEM_BitStuffSimple)
       {
         if (!m_bitStuffer2.EncodeSimple(&ptr, quantVec, m_headerInfo.version))
@@ -2022,9 +2558,45 @@ bool Lerc2::WriteTile(const T* dataBuf, int num, Byte** ppByte, int& numBytesWri
 
 // -------------------------------------------------------------------------- ;
 
-template<class T>
+template<int N, class T>
+inline void Lerc2::DequantizeRun(T* data, int64_t m, int64_t mEnd, int nDepthIn, const unsigned int*& srcPtr,
+  double offset, double invScale, double zMax, bool bDiffEnc, bool bIntMath)
+{
+  const int nDepth = N > 0 ? N : nDepthIn;
+
+  if (bIntMath)
+  {
+    const int64_t offsetI = (int64_t)offset, scaleI = (int64_t)invScale, zMaxI = (int64_t)zMax;
+
+    if (!bDiffEnc)
+      for (; m < mEnd; m += nDepth)
+        data[m] = (T)std::min(offsetI + *srcPtr++ * scaleI, zMaxI);    // make sure we stay in the orig range
+    else
+      for (; m < mEnd; m += nDepth)
+        data[m] = (T)std::min(offsetI + *srcPtr++ * scaleI + (int64_t)data[m - 1], zMaxI);
+  }
+  else
+  {
+    if (!bDiffEnc)
+      for (; m < mEnd; m += nDepth)
+      {
+        double z = offset + *srcPtr++ * invScale;
+        data[m] = (T)std::min(z, zMax);    // make sure we stay in the orig range
+      }
+    else
+      for (; m < mEnd; m += nDepth)
+      {
+        double z = offset + *srcPtr++ * invScale + data[m - 1];
+        data[m] = (T)std::min(z, zMax);
+      }
+  }
+}
+
+// -------------------------------------------------------------------------- ;
+
+template<int N, class T>
 bool Lerc2::ReadTile(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data, int i0, int i1, int j0, int j1, int iDepth,
-  std::vector<unsigned int>& bufferVec) const
+  const BitStuffer2& bitStuffer2, std::vector<unsigned int>& bufferVec) const
 {
   const Byte* ptr = *ppByte;
   size_t nBytesRemaining = nBytesRemainingInOut;
@@ -2034,7 +2606,7 @@ bool Lerc2::ReadTile(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data,
 
   const HeaderInfo& hd = m_headerInfo;
   int nCols = hd.nCols;
-  int nDepth = hd.nDepth;
+  const int nDepth = N > 0 ? N : hd.nDepth;
 
   Byte comprFlag = *ptr++;
   nBytesRemaining--;
@@ -2053,14 +2625,23 @@ bool Lerc2::ReadTile(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data,
 
   if (comprFlag == 2)    // entire tile is constant 0 (all the valid pixels)
   {
+    Stats::Add(StatsArrOrder::numTilesConst, 1);
+
     for (int i = i0; i < i1; i++)
     {
-      int k = i * nCols + j0;
-      int m = k * nDepth + iDepth;
+      int64_t k0 = (int64_t)i * nCols + j0, k1 = k0 + (j1 - j0);
 
-      for (int j = j0; j < j1; j++, k++, m += nDepth)
-        if (m_bitMask.IsValid(k))
-          data[m] = bDiffEnc ? data[m - 1] : 0;
+      for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+      {
+        int64_t m = r0 * nDepth + iDepth, mEnd = r1 * nDepth;
+
+        if (!bDiffEnc)
+          for (; m < mEnd; m += nDepth)
+            data[m] = 0;
+        else
+          for (; m < mEnd; m += nDepth)
+            data[m] = data[m - 1];
+      }
     }
 
     *ppByte = ptr;
@@ -2073,25 +2654,27 @@ bool Lerc2::ReadTile(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data,
     if (bDiffEnc)
       return false;    // doesn't make sense, should not happen
 
+    Stats::Add(StatsArrOrder::numTilesRawBinary, 1);
+
     const T* srcPtr = (const T*)ptr;
     int cnt = 0;
 
     for (int i = i0; i < i1; i++)
     {
-      int k = i * nCols + j0;
-      int m = k * nDepth + iDepth;
+      int64_t k0 = (int64_t)i * nCols + j0, k1 = k0 + (j1 - j0);
 
-      for (int j = j0; j < j1; j++, k++, m += nDepth)
-        if (m_bitMask.IsValid(k))
-        {
-          if (nBytesRemaining < sizeof(T))
-            return false;
+      for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+      {
+        size_t n = (size_t)(r1 - r0);
+        if (nBytesRemaining < n * sizeof(T))
+          return false;
 
+        for (int64_t m = r0 * nDepth + iDepth, mEnd = r1 * nDepth; m < mEnd; m += nDepth)
           data[m] = *srcPtr++;
-          nBytesRemaining -= sizeof(T);
 
-          cnt++;
-        }
+        nBytesRemaining -= n * sizeof(T);
+        cnt += (int)n;
+      }
     }
 
     ptr += cnt * sizeof(T);
@@ -2113,22 +2696,23 @@ bool Lerc2::ReadTile(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data,
 
     if (comprFlag == 3)    // entire tile is constant zMin (all the valid pixels)
     {
+      Stats::Add(StatsArrOrder::numTilesConst, 1);
+
       for (int i = i0; i < i1; i++)
       {
-        int k = i * nCols + j0;
-        int m = k * nDepth + iDepth;
+        int64_t k0 = (int64_t)i * nCols + j0, k1 = k0 + (j1 - j0);
 
         if (!bDiffEnc)
         {
           T val = (T)offset;
-          for (int j = j0; j < j1; j++, k++, m += nDepth)
-            if (m_bitMask.IsValid(k))
+          for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+            for (int64_t m = r0 * nDepth + iDepth, mEnd = r1 * nDepth; m < mEnd; m += nDepth)
               data[m] = val;
         }
         else
         {
-          for (int j = j0; j < j1; j++, k++, m += nDepth)
-            if (m_bitMask.IsValid(k))
+          for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+            for (int64_t m = r0 * nDepth + iDepth, mEnd = r1 * nDepth; m < mEnd; m += nDepth)
             {
               double z = offset + data[m - 1];
               data[m] = (T)std::min(z, zMax);
@@ -2138,36 +2722,26 @@ bool Lerc2::ReadTile(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data,
     }
     else
     {
+      if (nBytesRemaining > 0)    // bit 5 of the bit stuffer header is the lut flag
+        Stats::Add((*ptr & (1 << 5)) ? StatsArrOrder::numTilesBitStuffLUT : StatsArrOrder::numTilesBitStuffSimple, 1);
+
       size_t maxElementCount = size_t(i1 - i0) * (j1 - j0);
-      if (!m_bitStuffer2.Decode(&ptr, nBytesRemaining, bufferVec, maxElementCount, hd.version))
+      if (!bitStuffer2.Decode(&ptr, nBytesRemaining, bufferVec, maxElementCount, hd.version))
         return false;
 
       double invScale = 2 * hd.maxZError;    // for int types this is int
       const unsigned int* srcPtr = bufferVec.data();
 
+      // int lossless (invScale = 1) or int lossy, all values fit into int64, also for a corrupted header
+      const bool bIntMath = hd.dt < DT_Float && invScale >= 1 && invScale <= (double)(1u << 30)
+        && invScale == floor(invScale) && std::fabs(zMax) < (double)((int64_t)1 << 53);
+
       if (bufferVec.size() == maxElementCount)    // all valid
       {
         for (int i = i0; i < i1; i++)
         {
-          int k = i * nCols + j0;
-          int m = k * nDepth + iDepth;
-
-          if (!bDiffEnc)
-          {
-            for (int j = j0; j < j1; j++, k++, m += nDepth)
-            {
-              double z = offset + *srcPtr++ * invScale;
-              data[m] = (T)std::min(z, zMax);    // make sure we stay in the orig range
-            }
-          }
-          else
-          {
-            for (int j = j0; j < j1; j++, k++, m += nDepth)
-            {
-              double z = offset + *srcPtr++ * invScale + data[m - 1];
-              data[m] = (T)std::min(z, zMax);
-            }
-          }
+          int64_t m = ((int64_t)i * nCols + j0) * nDepth + iDepth;
+          DequantizeRun<N>(data, m, m + (int64_t)(j1 - j0) * nDepth, nDepth, srcPtr, offset, invScale, zMax, bDiffEnc, bIntMath);
         }
       }
       else    // not all valid
@@ -2176,27 +2750,10 @@ bool Lerc2::ReadTile(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data,
         {
           for (int i = i0; i < i1; i++)
           {
-            int k = i * nCols + j0;
-            int m = k * nDepth + iDepth;
+            int64_t k0 = (int64_t)i * nCols + j0, k1 = k0 + (j1 - j0);
 
-            if (!bDiffEnc)
-            {
-              for (int j = j0; j < j1; j++, k++, m += nDepth)
-                if (m_bitMask.IsValid(k))
-                {
-                  double z = offset + *srcPtr++ * invScale;
-                  data[m] = (T)std::min(z, zMax);    // make sure we stay in the orig range
-                }
-            }
-            else
-            {
-              for (int j = j0; j < j1; j++, k++, m += nDepth)
-                if (m_bitMask.IsValid(k))
-                {
-                  double z = offset + *srcPtr++ * invScale + data[m - 1];
-                  data[m] = (T)std::min(z, zMax);
-                }
-            }
+            for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+              DequantizeRun<N>(data, r0 * nDepth + iDepth, r1 * nDepth, nDepth, srcPtr, offset, invScale, zMax, bDiffEnc, bIntMath);
           }
         }
         else  // fail gracefully in case of corrupted blob for old version <= 2 which had no checksum
@@ -2231,6 +2788,77 @@ bool Lerc2::ReadTile(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data,
 
 // -------------------------------------------------------------------------- ;
 
+bool Lerc2::SkipTile(const Byte** ppByte, size_t& nBytesRemaining, int i0, int i1, int j0, int j1, int iDepth,
+  size_t typeSize) const
+{
+  // same checks as ReadTile(), minus the data
+  if (nBytesRemaining < 1)
+    return false;
+
+  const HeaderInfo& hd = m_headerInfo;
+  const Byte* ptr = *ppByte;
+
+  Byte comprFlag = *ptr++;
+  nBytesRemaining--;
+
+  const bool bDiffEnc = (hd.version >= 5) ? (comprFlag & 4) : false;
+  const int pattern = (hd.version >= 5) ? 14 : 15;
+
+  if (((comprFlag >> 2) & pattern) != ((j0 >> 3) & pattern))
+    return false;
+
+  if (bDiffEnc && iDepth == 0)
+    return false;
+
+  int bits67 = comprFlag >> 6;
+  comprFlag &= 3;
+
+  if (comprFlag == 0)    // z's binary uncompressed, one per valid pixel
+  {
+    if (bDiffEnc)
+      return false;
+
+    size_t cnt = 0;
+    for (int i = i0; i < i1; i++)
+    {
+      int64_t k0 = (int64_t)i * hd.nCols + j0, k1 = k0 + (j1 - j0);
+
+      for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+        cnt += (size_t)(r1 - r0);
+    }
+
+    if (nBytesRemaining < cnt * typeSize)
+      return false;
+
+    ptr += cnt * typeSize;
+    nBytesRemaining -= cnt * typeSize;
+  }
+  else if (comprFlag != 2)
+  {
+    DataType dtUsed = GetDataTypeUsed((bDiffEnc && hd.dt < DT_Float) ? DT_Int : hd.dt, bits67);
+    if (dtUsed == DT_Undefined)
+      return false;
+    size_t n = GetDataTypeSize(dtUsed);
+    if (nBytesRemaining < n)
+      return false;
+
+    ptr += n;
+    nBytesRemaining -= n;
+
+    if (comprFlag == 1)
+    {
+      size_t maxElementCount = size_t(i1 - i0) * (j1 - j0);
+      if (!BitStuffer2::Skip(&ptr, nBytesRemaining, maxElementCount, hd.version))
+        return false;
+    }
+  }
+
+  *ppByte = ptr;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
 template<class T>
 Lerc2::DataType Lerc2::GetDataType(T z)
 {
@@ -2270,6 +2898,9 @@ void Lerc2::SortQuantArray(const vector<unsigned int>& quantVec, vector<pair<uns
 template<class T>
 void Lerc2::ComputeHuffmanCodes(const T* data, int& numBytes, ImageEncodeMode& imageEncodeMode, std::vector<std::pair<unsigned short, unsigned int> >& codes) const
 {
+  Stats::Timer timer(StatsArrOrder::msHuffman);
+  LERC_TRACE_SCOPE("Lerc2::ComputeHuffmanCodes");
+
   std::vector<int> histo, deltaHisto;
   ComputeHistoForHuffman(data, histo, deltaHisto);
 
@@ -2322,7 +2953,36 @@ void Lerc2::ComputeHistoForHuffman(const T* data, std::vector<int>& histo, std::
   int width = m_headerInfo.nCols;
   int nDepth = m_headerInfo.nDepth;
 
-  if (m_headerInfo.numValidPixel == width * height)    // all valid
+  if (m_headerInfo.numValidPixel == width * height && sizeof(T) == 1)    // all valid, Huffman case
+  {
+    // same as below, but row by row over all depths in one sweep;
+    // the first pixel of a row is predicted from the row above, all others from the left neighbor
+
+    const Byte* bytes = reinterpret_cast<const Byte*>(data);
+    const Byte flip = (Byte)offset;
+    const size_t rowLen = (size_t)width * nDepth;
+    ByteHisto byteHisto, byteDeltaHisto;
+
+    for (int i = 0; i < height; i++)
+    {
+      const Byte* row = bytes + i * rowLen;
+
+      if (i > 0)
+        byteHisto.AddWithDelta(byteDeltaHisto, row, row - rowLen, nDepth, flip);
+      else
+        for (int m = 0; m < nDepth; m++)
+        {
+          byteHisto.AddOne(row[m] ^ flip);
+          byteDeltaHisto.AddOne(row[m] ^ flip);
+        }
+
+      byteHisto.AddWithDelta(byteDeltaHisto, row + nDepth, row, rowLen - nDepth, flip);
+    }
+
+    byteHisto.GetHisto(histo);
+    byteDeltaHisto.GetHisto(deltaHisto);
+  }
+  else if (m_headerInfo.numValidPixel == width * height)    // all valid
   {
     for (int iDepth = 0; iDepth < nDepth; iDepth++)
     {
@@ -2384,6 +3044,9 @@ void Lerc2::ComputeHistoForHuffman(const T* data, std::vector<int>& histo, std::
 template<class T>
 bool Lerc2::EncodeHuffman(const T* data, Byte** ppByte) const
 {
+  Stats::Timer timer(StatsArrOrder::msHuffman);
+  LERC_TRACE_SCOPE("Lerc2::EncodeHuffman");
+
   if (!data || !ppByte)
     return false;
 
@@ -2472,6 +3135,9 @@ bool Lerc2::EncodeHuffman(const T* data, Byte** ppByte) const
 template<class T>
 bool Lerc2::DecodeHuffman(const Byte** ppByte, size_t& nBytesRemainingInOut, T* data) const
 {
+  Stats::Timer timer(StatsArrOrder::msHuffman);
+  LERC_TRACE_SCOPE("Lerc2::DecodeHuffman");
+
   if (!data || !ppByte || !(*ppByte))
     return false;
 
@@ -2548,9 +3214,12 @@ bool Lerc2::DecodeHuffman(const Byte** ppByte, size_t& nBytesRemainingInOut, T*
       for (int iDepth = 0; iDepth < nDepth; iDepth++)
       {
         T prevVal = 0;
-        for (int k = 0, m = iDepth, i = 0; i < height; i++)
-          for (int j = 0; j < width; j++, k++, m += nDepth)
-            if (m_bitMask.IsValid(k))
+        for (int i = 0; i < height; i++)
+        {
+          int64_t k0 = (int64_t)i * width, k1 = k0 + width;
+
+          for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+            for (int k = (int)r0, m = k * nDepth + iDepth; k < r1; k++, m += nDepth)
             {
               int val = 0;
               if (!huffman.DecodeOneValue(&ptr, nBytesRemaining, bitPos, numBitsLUT, val))
@@ -2558,7 +3227,7 @@ bool Lerc2::DecodeHuffman(const Byte** ppByte, size_t& nBytesRemainingInOut, T*
 
               T delta = (T)(val - offset);
 
-              if (j > 0 && m_bitMask.IsValid(k - 1))
+              if (k > r0)    // left neighbor is valid
               {
                 delta += prevVal;    // use overflow
               }
@@ -2572,22 +3241,26 @@ bool Lerc2::DecodeHuffman(const Byte** ppByte, size_t& nBytesRemainingInOut, T*
               data[m] = delta;
               prevVal = delta;
             }
+        }
       }
     }
 
     else if (m_imageEncodeMode == IEM_Huffman)
     {
-      for (int k = 0, m0 = 0, i = 0; i < height; i++)
-        for (int j = 0; j < width; j++, k++, m0 += nDepth)
-          if (m_bitMask.IsValid(k))
-            for (int m = 0; m < nDepth; m++)
-            {
-              int val = 0;
-              if (!huffman.DecodeOneValue(&ptr, nBytesRemaining, bitPos, numBitsLUT, val))
-                return false;
+      for (int i = 0; i < height; i++)
+      {
+        int64_t k0 = (int64_t)i * width, k1 = k0 + width;
 
-              data[m0 + m] = (T)(val - offset);
-            }
+        for (int64_t r0, r1, kNext = k0; m_bitMask.NextValidRun(kNext, k1, r0, r1); kNext = r1)
+          for (int64_t m = r0 * nDepth, mEnd = r1 * nDepth; m < mEnd; m++)
+          {
+            int val = 0;
+            if (!huffman.DecodeOneValue(&ptr, nBytesRemaining, bitPos, numBitsLUT, val))
+              return false;
+
+            data[m] = (T)(val - offset);
+          }
+      }
     }
 
     else
@@ -29,6 +29,7 @@ Contributors:  Thomas Maurer
 #include <climits>
 #include <algorithm>
 #include <string>
+#include <type_traits>
 #include "BitMask.h"
 #include "BitStuffer2.h"
 #include "fpl_Lerc2Ext.h"
@@ -89,6 +90,10 @@ public:
   bool SetMinMax(int nDepth, double minVal, double maxVal);    // set min / max but only for nDepth = 1
   void ClearMinMax();
 
+  bool SetMicroBlockSizeSearch(bool bSearch);    // try micro block size 8, 16, and 32, dflt = false (8, maybe 16)
+  bool SetDropNoisyBitPlanes(bool bDrop);    // int types, drop the noisy low bit planes, can raise maxZError, dflt = false
+  bool SetBitPlaneSampling(int rowStep);    // bit plane noise test on every rowStep-th row only, dflt = 1 (all rows)
+
   template<class T>
   unsigned int ComputeNumBytesNeededToWrite(const T* arr, double maxZError, bool encodeMask);
 
@@ -132,6 +137,9 @@ public:
 
   static bool GetHeaderInfo(const Byte* pByte, size_t nBytesRemaining, struct HeaderInfo& headerInfo, bool& bHasMask);
 
+  /// upper bound of the blob size Encode() writes for any data and mask of these dimensions, any codec version
+  static size_t ComputeNumBytesUpperBound(int nDepth, int nCols, int nRows, DataType dt);
+
   bool GetRanges(const Byte* pByte, size_t nBytesRemaining, double* pMins, double* pMaxs);
 
   /// dst buffer already allocated;  byte ptr is moved like a file pointer
@@ -143,17 +151,37 @@ private:
   enum ImageEncodeMode { IEM_Tiling = 0, IEM_DeltaHuffman, IEM_Huffman, IEM_DeltaDeltaHuffman };
   enum BlockEncodeMode { BEM_RawBinary = 0, BEM_BitStuffSimple, BEM_BitStuffLUT };
 
+  template<class Z>
+  struct TileStats    // per tile and depth, as returned by GetValidDataAndStats()
+  {
+    Z zMin, zMax;
+    unsigned short numValidPixel;    // micro block size <= 32
+    bool tryLut;
+  };
+
+  // min and max as float where that is exact (data types up to 16 bit and float), 12 instead of 24 bytes per tile
+  template<class T>
+  using TileStatsOf = TileStats<typename std::conditional<(sizeof(T) <= 2 || std::is_same<T, float>::value), float, double>::type>;
+
   int         m_microBlockSize,
-              m_maxValToQuantize;
+              m_maxValToQuantize,
+              m_bitPlaneRowStep;
   BitMask     m_bitMask;
   HeaderInfo  m_headerInfo;
   BitStuffer2 m_bitStuffer2;
   bool        m_encodeMask,
               m_writeDataOneSweep,
-              m_minMaxSet;
+              m_minMaxSet,
+              m_maskRLEValid,
+              m_dropNoisyBitPlanes,
+              m_microBlockSizeSearch;
   ImageEncodeMode  m_imageEncodeMode;
+  std::vector<Byte> m_maskRLE;    // m_bitMask RLE compressed, valid if m_maskRLEValid
 
   std::vector<double> m_zMinVec, m_zMaxVec;
+  std::vector<TileStats<float> >  m_tileStatsVecFlt;    // for micro block size m_tileStatsMbSize, 0 if not valid
+  std::vector<TileStats<double> > m_tileStatsVecDbl;    // "
+  int m_tileStatsMbSize;
   std::vector<std::pair<unsigned short, unsigned int> > m_huffmanCodes;    // <= 256 codes, 1.5 kB
 
   LosslessFPCompression m_lfpc;
@@ -173,8 +201,7 @@ private:
   bool DoChecksOnEncode(Byte* pBlobBegin, Byte* pBlobEnd) const;
   static unsigned int ComputeChecksumFletcher32(const Byte* pByte, int len);
 
-  static void AddUIntToCounts(int* pCounts, unsigned int val, int nBits);
-  static void AddIntToCounts(int* pCounts, int val, int nBits);
+  static void AddToBitPlaneCounts(const unsigned int* pVal, size_t num, int nBits, int* pCounts);
 
   template<class T>
   bool TryBitPlaneCompression(const T* data, double eps, double& newMaxZError) const;
@@ -192,7 +219,18 @@ private:
   bool ReadDataOneSweep(const Byte** ppByte, size_t& nBytesRemaining, T* data) const;
 
   template<class T>
-  bool ComputeMinMaxRanges(const T* data, std::vector<double>& zMinVec, std::vector<double>& zMaxVec) const;
+  bool ComputeTileStats(const T* data, int mbSize);
+
+  template<class T>
+  void MergeTileStats();    // tile stats for twice the micro block size, tryLut is only an estimate
+  template<class T>
+  bool ComputeMinMaxRanges(std::vector<double>& zMinVec, std::vector<double>& zMaxVec) const;
+
+  std::vector<TileStats<float> >&  TileStatsVec(const TileStats<float>*)         { return m_tileStatsVecFlt; }
+  std::vector<TileStats<double> >& TileStatsVec(const TileStats<double>*)        { return m_tileStatsVecDbl; }
+  const std::vector<TileStats<float> >&  TileStatsVec(const TileStats<float>*) const   { return m_tileStatsVecFlt; }
+  const std::vector<TileStats<double> >& TileStatsVec(const TileStats<double>*) const  { return m_tileStatsVecDbl; }
+  void ClearTileStats();
 
   template<class T>
   bool WriteTiles(const T* data, Byte** ppByte, int& numBytes) const;
@@ -200,10 +238,17 @@ private:
   template<class T>
   bool ReadTiles(const Byte** ppByte, size_t& nBytesRemaining, T* data) const;
 
+  template<int N, class T>
+  bool ReadTilesN(const Byte** ppByte, size_t& nBytesRemaining, T* data) const;    // N = nDepth, or 0 for any nDepth
+
   template<class T>
   bool GetValidDataAndStats(const T* data, int i0, int i1, int j0, int j1, int iDepth,
     T* dataBuf, T& zMin, T& zMax, int& numValidPixel, bool& tryLut) const;
 
+  template<int N, class T>
+  bool GetValidDataAndStatsN(const T* data, int i0, int i1, int j0, int j1, int iDepth,
+    T* dataBuf, T& zMin, T& zMax, int& numValidPixel, bool& tryLut) const;
+
   template<class T>
   static bool ComputeDiffSliceInt(const T* data, const T* prevData, int numValidPixel, bool bCheckForIntOverflow,
     double maxZError, std::vector<int>& diffDataVec, int& zMin, int& zMax, bool& tryLut);
@@ -239,9 +284,19 @@ private:
     DataType dtZ, bool bDiffEnc, const std::vector<unsigned int>& quantVec, BlockEncodeMode blockEncodeMode,
     const std::vector<std::pair<unsigned int, unsigned int> >& sortedQuantVec) const;
 
-  template<class T>
+  template<int N, class T>
   bool ReadTile(const Byte** ppByte, size_t& nBytesRemaining, T* data, int i0, int i1, int j0, int j1, int iDepth,
-                std::vector<unsigned int>& bufferVec) const;
+                const BitStuffer2& bitStuffer2, std::vector<unsigned int>& bufferVec) const;
+
+  // move the byte ptr past one tile without decoding it, to find where rows of tiles start
+  bool SkipTile(const Byte** ppByte, size_t& nBytesRemaining, int i0, int i1, int j0, int j1, int iDepth,
+                size_t typeSize) const;
+
+  // scale back the bit stuffed values of one run of valid pixels, every nDepth-th value of data from m to mEnd,
+  // nDepth = N if N > 0; bIntMath for int types, where offset and invScale are int, avoids the int to double to int per pixel
+  template<int N, class T>
+  static void DequantizeRun(T* data, int64_t m, int64_t mEnd, int nDepth, const unsigned int*& srcPtr,
+    double offset, double invScale, double zMax, bool bDiffEnc, bool bIntMath);
 
   template<class T>
   static int ReduceDataType(T z, DataType dt, DataType& dtReduced);
@@ -292,24 +347,6 @@ private:
 // -------------------------------------------------------------------------- ;
 // -------------------------------------------------------------------------- ;
 
-inline void Lerc2::AddUIntToCounts(int* pCounts, unsigned int val, int nBits)
-{
-  pCounts[0] += val & 1;
-  for (int i = 1; i < nBits; i++)
-    pCounts[i] += (val >>= 1) & 1;
-}
-
-// -------------------------------------------------------------------------- ;
-
-inline void Lerc2::AddIntToCounts(int* pCounts, int val, int nBits)
-{
-  pCounts[0] += val & 1;
-  for (int i = 1; i < nBits; i++)
-    pCounts[i] += (val >>= 1) & 1;
-}
-
-// -------------------------------------------------------------------------- ;
-
 inline bool Lerc2::NeedToCheckForIntOverflow(const HeaderInfo& hd)
 {
   return (hd.dt == DT_Int || hd.dt == DT_UInt) && (hd.zMax - hd.zMin >= 0x7FFFFFFF);
@@ -385,17 +422,23 @@ inline void Lerc2::ScaleBack(T* dataBuf, const std::vector<unsigned int>& quantV
   int num = (int)quantVec.size();
 
   if (!bClamp)
-    for (int i = 0; i < num; i++)
-    {
-      double z = zMin + quantVec[i] * invScale + (bDiff ? dataBuf[i] : 0);
-      dataBuf[i] = (T)z;
-    }
+  {
+    if (!bDiff)
+      for (int i = 0; i < num; i++)
+        dataBuf[i] = (T)(zMin + quantVec[i] * invScale);
+    else
+      for (int i = 0; i < num; i++)
+        dataBuf[i] = (T)(zMin + quantVec[i] * invScale + dataBuf[i]);
+  }
   else
-    for (int i = 0; i < num; i++)
-    {
-      double z = zMin + quantVec[i] * invScale + (bDiff ? dataBuf[i] : 0);
-      dataBuf[i] = (T)std::min(z, zMaxClamp);
-    }
+  {
+    if (!bDiff)
+      for (int i = 0; i < num; i++)
+        dataBuf[i] = (T)std::min(zMin + quantVec[i] * invScale, zMaxClamp);
+    else
+      for (int i = 0; i < num; i++)
+        dataBuf[i] = (T)std::min(zMin + quantVec[i] * invScale + dataBuf[i], zMaxClamp);
+  }
 }
 
 // -------------------------------------------------------------------------- ;
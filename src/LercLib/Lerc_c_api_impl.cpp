@@ -25,6 +25,11 @@ Contributors:  Thomas Maurer
 #include "include/Lerc_c_api.h"
 #include "include/Lerc_types.h"
 #include "Lerc.h"
+#include "Parallel.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
 
 USING_NAMESPACE_LERC
 
@@ -92,6 +97,57 @@ lerc_status lerc_encodeForVersion(const void* pData, int version, unsigned int d
 
 // -------------------------------------------------------------------------- ;
 
+lerc_status lerc_compressBound(unsigned int dataType, int nDepth, int nCols, int nRows, int nBands, unsigned int* numBytes)
+{
+  if (!numBytes)
+    return (lerc_status)ErrCode::WrongParam;
+
+  *numBytes = 0;
+
+  if (dataType >= Lerc::DT_Undefined)
+    return (lerc_status)ErrCode::WrongParam;
+
+  return (lerc_status)Lerc::ComputeCompressBound((Lerc::DataType)dataType, nDepth, nCols, nRows, nBands, *numBytes);
+}
+
+// -------------------------------------------------------------------------- ;
+
+lerc_status lerc_encodeRealloc(const void* pData, unsigned int dataType, int nDepth, int nCols, int nRows, int nBands,
+  int nMasks, const unsigned char* pValidBytes, double maxZErr, lerc_realloc_func pfnRealloc, void* pContext,
+  unsigned char** ppOutBuffer, unsigned int* outBufferSize, unsigned int* nBytesWritten,
+  const unsigned char* pUsesNoData, const double* noDataValues)
+{
+  if (!nBytesWritten)
+    return (lerc_status)ErrCode::WrongParam;
+
+  *nBytesWritten = 0;
+
+  if (!ppOutBuffer || !outBufferSize || (!*ppOutBuffer && *outBufferSize))
+    return (lerc_status)ErrCode::WrongParam;
+
+  unsigned int numBytesBound = 0;
+  lerc_status status = lerc_compressBound(dataType, nDepth, nCols, nRows, nBands, &numBytesBound);
+  if (status != (lerc_status)ErrCode::Ok)
+    return status;
+
+  if (*outBufferSize < numBytesBound)
+  {
+    unsigned char* pBuffer = pfnRealloc ? pfnRealloc(pContext, *ppOutBuffer, numBytesBound)
+      : (unsigned char*)realloc(*ppOutBuffer, numBytesBound);
+
+    if (!pBuffer)
+      return (lerc_status)ErrCode::Failed;
+
+    *ppOutBuffer = pBuffer;
+    *outBufferSize = numBytesBound;
+  }
+
+  return lerc_encode_4D(pData, dataType, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr,
+    *ppOutBuffer, *outBufferSize, nBytesWritten, pUsesNoData, noDataValues);
+}
+
+// -------------------------------------------------------------------------- ;
+
 lerc_status lerc_getBlobInfo(const unsigned char* pLercBlob, unsigned int blobSize, 
   unsigned int* infoArray, double* dataRangeArray, int infoArraySize, int dataRangeArraySize)
 {
@@ -195,6 +251,26 @@ lerc_status lerc_decodeToDouble(const unsigned char* pLercBlob, unsigned int blo
 
 lerc_status lerc_computeCompressedSize_4D(const void* pData, unsigned int dataType, int nDepth, int nCols, int nRows, int nBands,
   int nMasks, const unsigned char* pValidBytes, double maxZErr, unsigned int* numBytes, const unsigned char* pUsesNoData, const double* noDataValues)
+{
+  return lerc_computeCompressedSizeEx(pData, dataType, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr,
+    numBytes, pUsesNoData, noDataValues, nullptr, 0);
+}
+
+// -------------------------------------------------------------------------- ;
+
+lerc_status lerc_encode_4D(const void* pData, unsigned int dataType, int nDepth, int nCols, int nRows, int nBands,
+  int nMasks, const unsigned char* pValidBytes, double maxZErr, unsigned char* pOutBuffer, unsigned int outBufferSize,
+  unsigned int* nBytesWritten, const unsigned char* pUsesNoData, const double* noDataValues)
+{
+  return lerc_encodeEx(pData, dataType, nDepth, nCols, nRows, nBands, nMasks, pValidBytes, maxZErr,
+    pOutBuffer, outBufferSize, nBytesWritten, pUsesNoData, noDataValues, nullptr, 0);
+}
+
+// -------------------------------------------------------------------------- ;
+
+lerc_status lerc_computeCompressedSizeEx(const void* pData, unsigned int dataType, int nDepth, int nCols, int nRows, int nBands,
+  int nMasks, const unsigned char* pValidBytes, double maxZErr, unsigned int* numBytes, const unsigned char* pUsesNoData, const double* noDataValues,
+  const int* optionsArray, int optionsArraySize)
 {
   if (!numBytes)
     return (lerc_status)ErrCode::WrongParam;
@@ -207,16 +283,22 @@ lerc_status lerc_computeCompressedSize_4D(const void* pData, unsigned int dataTy
   if (!(nMasks == 0 || nMasks == 1 || nMasks == nBands) || (nMasks > 0 && !pValidBytes))
     return (lerc_status)ErrCode::WrongParam;
 
+  Lerc::EncodeOptions options;
+  ErrCode errCode = Lerc::GetEncodeOptions(optionsArray, optionsArraySize, options);
+  if (errCode != ErrCode::Ok)
+    return (lerc_status)errCode;
+
   Lerc::DataType dt = (Lerc::DataType)dataType;
   return (lerc_status)Lerc::ComputeCompressedSize(pData, -1, dt, nDepth, nCols, nRows, nBands, nMasks,
-    pValidBytes, maxZErr, *numBytes, pUsesNoData, noDataValues);
+    pValidBytes, maxZErr, *numBytes, pUsesNoData, noDataValues, &options);
 }
 
 // -------------------------------------------------------------------------- ;
 
-lerc_status lerc_encode_4D(const void* pData, unsigned int dataType, int nDepth, int nCols, int nRows, int nBands,
+lerc_status lerc_encodeEx(const void* pData, unsigned int dataType, int nDepth, int nCols, int nRows, int nBands,
   int nMasks, const unsigned char* pValidBytes, double maxZErr, unsigned char* pOutBuffer, unsigned int outBufferSize,
-  unsigned int* nBytesWritten, const unsigned char* pUsesNoData, const double* noDataValues)
+  unsigned int* nBytesWritten, const unsigned char* pUsesNoData, const double* noDataValues,
+  const int* optionsArray, int optionsArraySize)
 {
   if (!nBytesWritten)
     return (lerc_status)ErrCode::WrongParam;
@@ -229,9 +311,14 @@ lerc_status lerc_encode_4D(const void* pData, unsigned int dataType, int nDepth,
   if (!(nMasks == 0 || nMasks == 1 || nMasks == nBands) || (nMasks > 0 && !pValidBytes))
     return (lerc_status)ErrCode::WrongParam;
 
+  Lerc::EncodeOptions options;
+  ErrCode errCode = Lerc::GetEncodeOptions(optionsArray, optionsArraySize, options);
+  if (errCode != ErrCode::Ok)
+    return (lerc_status)errCode;
+
   Lerc::DataType dt = (Lerc::DataType)dataType;
   return (lerc_status)Lerc::Encode(pData, -1, dt, nDepth, nCols, nRows, nBands, nMasks, pValidBytes,
-    maxZErr, pOutBuffer, outBufferSize, *nBytesWritten, pUsesNoData, noDataValues);
+    maxZErr, pOutBuffer, outBufferSize, *nBytesWritten, pUsesNoData, noDataValues, &options);
 }
 
 // -------------------------------------------------------------------------- ;
@@ -305,3 +392,126 @@ lerc_status lerc_decodeToDouble_4D(const unsigned char* pLercBlob, unsigned int
 
 // -------------------------------------------------------------------------- ;
 
+lerc_status lerc_encodeBatch(int nTiles, const void* const* ppData, unsigned int dataType, int nDepth, int nCols, int nRows, int nBands,
+  int nMasks, const unsigned char* const* ppValidBytes, double maxZErr, unsigned char* const* ppOutBuffers,
+  const unsigned int* outBufferSizes, unsigned int* nBytesWritten, const unsigned char* const* ppUsesNoData,
+  const double* const* ppNoDataValues, lerc_status* tileStatus, int nThreads)
+{
+  if (nTiles < 0 || nThreads < 0 || (nTiles > 0 && (!ppData || !ppOutBuffers || !outBufferSizes || !nBytesWritten)))
+    return (lerc_status)ErrCode::WrongParam;
+
+  // each tile writes to its own slots only
+  std::vector<lerc_status> statusVec(tileStatus ? 0 : nTiles);
+  lerc_status* pStatus = tileStatus ? tileStatus : statusVec.data();
+
+  Stats::Scope statsScope;
+  Stats* pStats = Stats::Current();
+  std::vector<Stats> tileStatsVec(pStats ? nTiles : 0);
+
+  Parallel::For((size_t)nTiles, [&](size_t i)
+  {
+    Stats::TaskScope tileStatsScope(pStats ? &tileStatsVec[i] : nullptr);
+    pStatus[i] = lerc_encode_4D(ppData[i], dataType, nDepth, nCols, nRows, nBands, nMasks,
+      ppValidBytes ? ppValidBytes[i] : nullptr, maxZErr, ppOutBuffers[i], outBufferSizes[i], &nBytesWritten[i],
+      ppUsesNoData ? ppUsesNoData[i] : nullptr, ppNoDataValues ? ppNoDataValues[i] : nullptr);
+  }, nThreads > 0 ? nThreads : Parallel::AllCores);
+
+  for (const Stats& tileStats : tileStatsVec)
+    pStats->AddCall(tileStats);
+
+  for (int i = 0; i < nTiles; i++)
+    if (pStatus[i] != (lerc_status)ErrCode::Ok)
+      return pStatus[i];
+
+  return (lerc_status)ErrCode::Ok;
+}
+
+// -------------------------------------------------------------------------- ;
+
+lerc_status lerc_decodeBatch(int nTiles, const unsigned char* const* ppLercBlobs, const unsigned int* blobSizes,
+  int nMasks, unsigned char* const* ppValidBytes, int nDepth, int nCols, int nRows, int nBands, unsigned int dataType,
+  void* const* ppData, unsigned char* const* ppUsesNoData, double* const* ppNoDataValues, lerc_status* tileStatus, int nThreads)
+{
+  if (nTiles < 0 || nThreads < 0 || (nTiles > 0 && (!ppLercBlobs || !blobSizes || !ppData)))
+    return (lerc_status)ErrCode::WrongParam;
+
+  std::vector<lerc_status> statusVec(tileStatus ? 0 : nTiles);
+  lerc_status* pStatus = tileStatus ? tileStatus : statusVec.data();
+
+  Stats::Scope statsScope;
+  Stats* pStats = Stats::Current();
+  std::vector<Stats> tileStatsVec(pStats ? nTiles : 0);
+
+  Parallel::For((size_t)nTiles, [&](size_t i)
+  {
+    Stats::TaskScope tileStatsScope(pStats ? &tileStatsVec[i] : nullptr);
+
+    // a tile of another data type or size would be converted or cut by lerc_decode_4D(), fail it instead
+    Lerc::LercInfo lercInfo;
+    lerc_status status = (ppLercBlobs[i] && blobSizes[i]) ?
+      (lerc_status)Lerc::GetLercInfo(ppLercBlobs[i], blobSizes[i], lercInfo) : (lerc_status)ErrCode::WrongParam;
+
+    if (status == (lerc_status)ErrCode::Ok && (lercInfo.dt != (Lerc::DataType)dataType || lercInfo.nDepth != nDepth
+      || lercInfo.nCols != nCols || lercInfo.nRows != nRows || lercInfo.nBands != nBands || lercInfo.nMasks > nMasks))
+    {
+      status = (lerc_status)ErrCode::Failed;
+    }
+
+    if (status == (lerc_status)ErrCode::Ok)
+    {
+      status = lerc_decode_4D(ppLercBlobs[i], blobSizes[i], nMasks, ppValidBytes ? ppValidBytes[i] : nullptr,
+        nDepth, nCols, nRows, nBands, dataType, ppData[i],
+        ppUsesNoData ? ppUsesNoData[i] : nullptr, ppNoDataValues ? ppNoDataValues[i] : nullptr);
+    }
+
+    pStatus[i] = status;
+  }, nThreads > 0 ? nThreads : Parallel::AllCores);
+
+  for (const Stats& tileStats : tileStatsVec)
+    pStats->AddCall(tileStats);
+
+  for (int i = 0; i < nTiles; i++)
+    if (pStatus[i] != (lerc_status)ErrCode::Ok)
+      return pStatus[i];
+
+  return (lerc_status)ErrCode::Ok;
+}
+
+// -------------------------------------------------------------------------- ;
+
+lerc_status lerc_setNumThreads(int nThreads)
+{
+  if (nThreads < 0)
+    return (lerc_status)ErrCode::WrongParam;
+
+  Parallel::SetMaxThreads(nThreads);
+  return (lerc_status)ErrCode::Ok;
+}
+
+// -------------------------------------------------------------------------- ;
+
+lerc_status lerc_enableStats(int enable)
+{
+  Stats::Enable(enable != 0);
+  return (lerc_status)ErrCode::Ok;
+}
+
+// -------------------------------------------------------------------------- ;
+
+lerc_status lerc_getLastStats(double* statsArray, int statsArraySize)
+{
+  if (!statsArray || statsArraySize <= 0)
+    return (lerc_status)ErrCode::WrongParam;
+
+  memset(statsArray, 0, statsArraySize * sizeof(statsArray[0]));
+
+  const Stats& stats = Stats::Last();
+  int n = std::min(statsArraySize, (int)StatsArrOrder::_last);
+
+  for (int i = 0; i < n; i++)
+    statsArray[i] = stats.Get((StatsArrOrder)i);
+
+  return (lerc_status)ErrCode::Ok;
+}
+
+// -------------------------------------------------------------------------- ;
@@ -0,0 +1,290 @@
+/*
+Copyright 2015 - 2026 Esri
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+A local copy of the license and additional notices are located with the
+source distribution at:
+
+http://github.com/Esri/lerc/
+
+Contributors:  Thomas Maurer
+*/
+
+#ifndef LERC_PARALLEL_H
+#define LERC_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include "Defines.h"
+
+#ifdef LERC_USE_THREADS
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+NAMESPACE_LERC_START
+
+/** Fork / join over independent tasks, such as byte planes or tiles.
+ *
+ *  For(numTasks, func) calls func(i) for i in [0, numTasks), on a small set of worker threads that
+ *  pull the next task index until done. The calling thread works too. Results must go to per task
+ *  slots so the output does not depend on the order tasks finish. A For() nested in a task runs
+ *  on the thread of that task, so batches of tiles on threads don't start threads per tile.
+ *
+ *  The worker threads are started once, on first use, and then wait for the next For(). Only one
+ *  For() at a time gets them; a For() called from another thread meanwhile runs on its calling thread.
+ *  They are stopped and joined at exit or when the shared lib is unloaded, and by SetMaxThreads(1).
+ *  SetMaxThreads() limits the threads For() uses, incl. the calling thread: 1 (dflt) - all tasks on
+ *  the calling thread, 0 - as many as there are cores. A maxThreads != 0 passed to For() overrides it.
+ *  Without LERC_USE_THREADS (see CMake option LERC_ENABLE_THREADS) all tasks run in order on the calling thread.
+ */
+
+class Parallel
+{
+public:
+  static void SetMaxThreads(int maxThreads);
+  static int  GetMaxThreads()                { return s_maxThreads; }
+
+  static const int AllCores = -1;    // maxThreads for For() that ignores SetMaxThreads()
+
+  // max num threads For() would use, capped by numTasks and the number of cores;
+  // maxThreads = 0 means the limit set by SetMaxThreads()
+  static int NumThreads(size_t numTasks, int maxThreads = 0);
+
+  template<class F>
+  static void For(size_t numTasks, F&& func, int maxThreads = 0);
+
+private:
+  inline static std::atomic<int> s_maxThreads{ 1 };
+
+#ifdef LERC_USE_THREADS
+  inline static thread_local bool s_inTask = false;
+
+  class Pool
+  {
+  public:
+    ~Pool()  { Stop(); }
+
+    // runs work on up to nWorkers pool threads plus the calling thread, returns when all are done;
+    // false if the pool is busy with another For()
+    bool Run(const std::function<void()>& work, int nWorkers);
+
+    // waits for a running Run() to finish, then stops and joins the worker threads;
+    // the next Run() starts new ones
+    void Stop();
+
+  private:
+    void WorkerLoop();
+
+    std::mutex m_runMutex;    // one Run() or Stop() at a time
+    std::mutex m_mutex;
+    std::condition_variable m_cvWork, m_cvDone;
+    std::vector<std::thread> m_threads;
+    const std::function<void()>* m_pWork = nullptr;
+    uint64_t m_jobId = 0;
+    int m_nWanted = 0, m_nActive = 0;
+    bool m_stop = false;
+  };
+
+  // destroyed at exit or on unloading the shared lib, so the worker threads are joined
+  // before the code they run goes away
+  static Pool& GetPool()  { static Pool pool; return pool; }
+#endif
+};
+
+// -------------------------------------------------------------------------- ;
+
+inline void Parallel::SetMaxThreads(int maxThreads)
+{
+  s_maxThreads = std::max(0, maxThreads);
+
+#ifdef LERC_USE_THREADS
+  if (maxThreads == 1)    // no more use for the worker threads
+    GetPool().Stop();
+#endif
+}
+
+// -------------------------------------------------------------------------- ;
+
+inline int Parallel::NumThreads(size_t numTasks, int maxThreads)
+{
+#ifdef LERC_USE_THREADS
+  if (s_inTask)
+    return 1;
+
+  if (maxThreads == 0)
+    maxThreads = s_maxThreads;
+
+  size_t nCores = std::max(1u, std::thread::hardware_concurrency());
+  size_t n = maxThreads > 0 ? std::min((size_t)maxThreads, nCores) : nCores;
+  return (int)std::max((size_t)1, std::min(n, numTasks));
+#else
+  (void)numTasks;
+  (void)maxThreads;
+  return 1;
+#endif
+}
+
+// -------------------------------------------------------------------------- ;
+
+template<class F>
+inline void Parallel::For(size_t numTasks, F&& func, int maxThreads)
+{
+  int nThreads = NumThreads(numTasks, maxThreads);
+
+  if (nThreads <= 1)
+  {
+    for (size_t i = 0; i < numTasks; i++)
+      func(i);
+    return;
+  }
+
+#ifdef LERC_USE_THREADS
+  std::atomic<size_t> next(0);
+  std::exception_ptr firstError;
+  std::mutex errorMutex;
+
+  const std::function<void()> worker = [&]()
+  {
+    bool bInTaskPrev = s_inTask;
+    s_inTask = true;
+
+    size_t i;
+    while ((i = next++) < numTasks)
+    {
+      try
+      {
+        func(i);
+      }
+      catch (...)    // pass on to the calling thread, e.g. from lerc_assert()
+      {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!firstError)
+          firstError = std::current_exception();
+        next = numTasks;
+      }
+    }
+
+    s_inTask = bInTaskPrev;
+  };
+
+  if (!GetPool().Run(worker, nThreads - 1))
+    worker();
+
+  if (firstError)
+    std::rethrow_exception(firstError);
+#endif
+}
+
+// -------------------------------------------------------------------------- ;
+
+#ifdef LERC_USE_THREADS
+
+inline bool Parallel::Pool::Run(const std::function<void()>& work, int nWorkers)
+{
+  std::unique_lock<std::mutex> runLock(m_runMutex, std::try_to_lock);
+  if (!runLock.owns_lock())
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    try
+    {
+      while ((int)m_threads.size() < nWorkers)
+        m_threads.emplace_back([this]() { WorkerLoop(); });
+    }
+    catch (...)    // could not start all threads, the ones running and this one do the work
+    {
+    }
+
+    m_pWork = &work;
+    m_nWanted = std::min(nWorkers, (int)m_threads.size());
+    m_jobId++;
+  }
+  m_cvWork.notify_all();
+
+  work();
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_nWanted = 0;    // the work is done, workers that did not wake up yet have nothing to do
+  m_cvDone.wait(lock, [this]() { return m_nActive == 0; });
+  m_pWork = nullptr;
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+inline void Parallel::Pool::Stop()
+{
+  std::lock_guard<std::mutex> runLock(m_runMutex);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cvWork.notify_all();
+
+  for (std::thread& thread : m_threads)
+    thread.join();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_threads.clear();
+  m_stop = false;
+}
+
+// -------------------------------------------------------------------------- ;
+
+inline void Parallel::Pool::WorkerLoop()
+{
+  s_inTask = true;
+  uint64_t lastJobId = 0;
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;)
+  {
+    m_cvWork.wait(lock, [&]() { return m_stop || m_jobId != lastJobId; });
+    if (m_stop)
+      return;
+
+    lastJobId = m_jobId;
+
+    if (m_nWanted <= 0)
+      continue;
+
+    m_nWanted--;
+    m_nActive++;
+    const std::function<void()>* pWork = m_pWork;
+
+    lock.unlock();
+    (*pWork)();
+    lock.lock();
+
+    if (--m_nActive == 0)
+      m_cvDone.notify_all();
+  }
+}
+
+#endif
+
+// -------------------------------------------------------------------------- ;
+
+NAMESPACE_LERC_END
+#endif
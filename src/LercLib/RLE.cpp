@@ -23,7 +23,9 @@ Contributors:  Thomas Maurer
 
 #include "Defines.h"
 #include "RLE.h"
+#include <algorithm>
 #include <cstring>
+#include <stdint.h>
 
 USING_NAMESPACE_LERC
 
@@ -31,91 +33,17 @@ USING_NAMESPACE_LERC
 
 size_t RLE::computeNumBytesRLE(const Byte* arr, size_t numBytes) const
 {
-  if (arr == nullptr || numBytes == 0)
-    return 0;
-
-  const Byte* ptr = arr;
-  size_t sum = 0;
-  size_t cntOdd = 0;
-  size_t cntEven = 0;
-  size_t cntTotal = 0;
-  bool bOdd = true;
-
-  while (cntTotal < numBytes - 1)
-  {
-    if (*ptr != *(ptr + 1))
-    {
-      if (bOdd)
-      {
-        cntOdd++;
-      }
-      else    // switch to odd mode
-      {
-        sum += 2 + 1;
-        bOdd = true;
-        cntOdd = 0;
-        cntEven = 0;
-      }
-    }
-    else
-    {
-      if (!bOdd)
-      {
-        cntEven++;
-      }
-      else
-      {
-        // count if we have enough equal bytes so it is worth switching to even
-        bool foundEnough = false;
-        if (cntTotal + m_minNumEven < numBytes)
-        {
-          int i = 1;
-          while (i < m_minNumEven && ptr[i] == ptr[0]) i++;
-          foundEnough = i < m_minNumEven ? false : true;
-        }
-
-        if (!foundEnough)    // stay in odd mode
-        {
-          cntOdd++;
-        }
-        else    // switch to even mode
-        {
-          if (cntOdd > 0)
-            sum += 2 + cntOdd;
-          bOdd = false;
-          cntOdd = 0;
-          cntEven = 0;
-          cntEven++;
-        }
-      }
-    }
-    ptr++;
-    cntTotal++;
+  return encode(arr, numBytes, nullptr);
+}
 
-    if (cntOdd == 32767)    // prevent short counters from overflow
-    {
-      sum += 2 + 32767;
-      cntOdd = 0;
-    }
-    if (cntEven == 32767)
-    {
-      sum += 2 + 1;
-      cntEven = 0;
-    }
-  }
+// -------------------------------------------------------------------------- ;
 
-  // don't forget the last byte
-  if (bOdd)
-  {
-    cntOdd++;
-    sum += 2 + cntOdd;
-  }
-  else
-  {
-    sum += 2 + 1;
-  }
+size_t RLE::compress(const Byte* arr, size_t numBytes, Byte* arrRLE) const
+{
+  if (!arrRLE)
+    return 0;
 
-  return sum + 2;    // EOF short
+  return encode(arr, numBytes, arrRLE);
 }
 
 // -------------------------------------------------------------------------- ;
@@ -132,123 +60,123 @@ bool RLE::compress(const Byte* arr, size_t numBytes,
   if (!*arrRLE)
     return false;
 
-  const Byte* srcPtr = arr;
-  Byte* cntPtr = *arrRLE;
-  Byte* dstPtr = cntPtr + 2;
-  //size_t sum = 0;
-  size_t cntOdd = 0;
-  size_t cntEven = 0;
-  size_t cntTotal = 0;
-  bool bOdd = true;
+  if (compress(arr, numBytes, *arrRLE) != numBytesRLE)
+    return false;
 
-  while (cntTotal < numBytes - 1)
+  if (verify)
   {
-    if (*srcPtr != *(srcPtr + 1))
+    Byte* arr2 = nullptr;
+    size_t numBytes2 = 0;
+    if (!decompress(*arrRLE, numBytesRLE, &arr2, numBytes2) || numBytes2 != numBytes)
     {
-      *dstPtr++ = *srcPtr;
-      if (bOdd)
-      {
-        cntOdd++;
-      }
-      else    // switch to odd mode
-      {
-        cntEven++;
-        writeCount(-(short)cntEven, &cntPtr, &dstPtr);    // - sign for even cnts
-        //sum += 2 + 1;
-        bOdd = true;
-        cntOdd = 0;
-        cntEven = 0;
-      }
+      delete[] arr2;
+      return false;
     }
-    else
+    int nCheck = memcmp(arr, arr2, numBytes);
+    delete[] arr2;
+    if (nCheck != 0)
+      return false;
+  }
+
+  return true;
+}
+
+// -------------------------------------------------------------------------- ;
+
+size_t RLE::encode(const Byte* arr, size_t numBytes, Byte* arrRLE) const
+{
+  if (arr == nullptr || numBytes == 0)
+    return 0;
+
+  // The stream is a sequence of odd (+cnt, cnt literal bytes) and even (-cnt, 1 byte) segments,
+  // cnt <= 32767. A run of equal bytes goes into an even segment if it has at least m_minNumEven
+  // bytes and does not start within the last m_minNumEven bytes, else into the odd ones.
+
+  const size_t maxCnt = 32767;
+  const size_t minNumEven = (size_t)std::max(m_minNumEven, 2);
+
+  Byte* cntPtr = arrRLE;
+  Byte* dstPtr = arrRLE ? arrRLE + 2 : nullptr;
+  size_t sum = 0;
+  size_t i = 0;
+
+  while (i < numBytes)
+  {
+    // find the next run long enough to switch to even
+    size_t k = i, runStart = numBytes;
+    while (k + minNumEven < numBytes)
     {
-      if (!bOdd)
-      {
-        cntEven++;
-      }
-      else
+      size_t kEnd = k + 1;
+      while (kEnd < k + minNumEven && arr[kEnd] == arr[k])
+        kEnd++;
+
+      if (kEnd == k + minNumEven)
       {
-        // count if we have enough equal bytes so it is worth switching to even
-        bool foundEnough = false;
-        if (cntTotal + m_minNumEven < numBytes)
-        {
-          int i = 1;
-          while (i < m_minNumEven && srcPtr[i] == srcPtr[0]) i++;
-          foundEnough = i < m_minNumEven ? false : true;
-        }
-
-        if (!foundEnough)    // stay in odd mode
-        {
-          *dstPtr++ = *srcPtr;
-          cntOdd++;
-        }
-        else    // switch to even mode
-        {
-          if (cntOdd > 0)
-          {
-            writeCount((short)cntOdd, &cntPtr, &dstPtr);    // + sign for odd cnts
-            //sum += 2 + cntOdd;
-          }
-          bOdd = false;
-          cntOdd = 0;
-          cntEven = 0;
-          cntEven++;
-        }
+        runStart = k;
+        break;
       }
+      k = kEnd;    // no run of minNumEven can start in between
     }
 
-    if (cntOdd == 32767)    // prevent short counters from overflow
+    // odd segments up to there
+    for (size_t cnt; i < runStart; i += cnt)
     {
-      writeCount((short)cntOdd, &cntPtr, &dstPtr);
-      //sum += 2 + 32767;
-      cntOdd = 0;
+      cnt = std::min(maxCnt, runStart - i);
+      sum += 2 + cnt;
+      if (arrRLE)
+      {
+        memcpy(dstPtr, arr + i, cnt);
+        dstPtr += cnt;
+        writeCount((short)cnt, &cntPtr, &dstPtr);    // + sign for odd cnts
+      }
     }
-    if (cntEven == 32767)
+
+    if (runStart == numBytes)
+      break;
+
+    // even segments for the entire run
+    size_t runEnd = findRunEnd(arr, runStart, numBytes);
+
+    for (size_t cnt; i < runEnd; i += cnt)
     {
-      *dstPtr++ = *srcPtr;
-      writeCount(-(short)cntEven, &cntPtr, &dstPtr);
-      //sum += 2 + 1;
-      cntEven = 0;
+      cnt = std::min(maxCnt, runEnd - i);
+      sum += 2 + 1;
+      if (arrRLE)
+      {
+        *dstPtr++ = arr[i];
+        writeCount(-(short)cnt, &cntPtr, &dstPtr);    // - sign for even cnts
+      }
     }
-
-    srcPtr++;
-    cntTotal++;
   }
 
-  // don't forget the last byte
-  *dstPtr++ = *srcPtr;
-  if (bOdd)
-  {
-    cntOdd++;
-    writeCount((short)cntOdd, &cntPtr, &dstPtr);
-    //sum += 2 + cntOdd;
-  }
-  else
-  {
-    cntEven++;
-    writeCount(-(short)cntEven, &cntPtr, &dstPtr);
-    //sum += 2 + 1;
-  }
+  if (arrRLE)
+    writeCount(-32768, &cntPtr, &dstPtr);    // write end of stream symbol
 
-  writeCount(-32768, &cntPtr, &dstPtr);    // write end of stream symbol
-  //sum += 2;
+  return sum + 2;    // EOF short
+}
 
-  if (verify)
+// -------------------------------------------------------------------------- ;
+
+size_t RLE::findRunEnd(const Byte* arr, size_t i, size_t numBytes)
+{
+  // first index > i with arr[index] != arr[i], or numBytes; mask runs are long, compare 8 bytes at a time
+
+  const Byte b = arr[i];
+  uint64_t word;
+  memset(&word, b, sizeof(word));
+
+  for (i++; i + 8 <= numBytes; i += 8)
   {
-    Byte* arr2 = nullptr;
-    size_t numBytes2 = 0;
-    if (!decompress(*arrRLE, numBytesRLE, &arr2, numBytes2) || numBytes2 != numBytes)
-    {
-      delete[] arr2;
-      return false;
-    }
-    int nCheck = memcmp(arr, arr2, numBytes);
-    delete[] arr2;
-    if (nCheck != 0)
-      return false;
+    uint64_t val;
+    memcpy(&val, arr + i, sizeof(val));
+    if (val != word)
+      break;
   }
 
-  return true;
+  while (i < numBytes && arr[i] == b)
+    i++;
+
+  return i;
 }
 
 // -------------------------------------------------------------------------- ;
@@ -314,14 +242,12 @@ bool RLE::decompress(const Byte* arrRLE, size_t nBytesRemaining, Byte* arr, size
       return false;
 
     if (cnt > 0)
-    {
-      while (i--) arr[arrIdx++] = *srcPtr++;
-    }
+      memcpy(arr + arrIdx, srcPtr, i);
     else
-    {
-      Byte b = *srcPtr++;
-      while (i--) arr[arrIdx++] = b;
-    }
+      memset(arr + arrIdx, *srcPtr, i);
+
+    arrIdx += i;
+    srcPtr += m;
 
     nBytesRemaining -= m + 2;
     cnt = readCount(&srcPtr);
@@ -47,6 +47,9 @@ public:
 
   size_t computeNumBytesRLE(const Byte* arr, size_t numBytes) const;
 
+  // arrRLE already allocated to computeNumBytesRLE() bytes, just fill; returns num bytes written, 0 on error
+  size_t compress(const Byte* arr, size_t numBytes, Byte* arrRLE) const;
+
   // when done, call
   // delete[] *arrRLE;
   bool compress(const Byte* arr, size_t numBytes,
@@ -62,6 +65,10 @@ public:
 protected:
   int m_minNumEven;
 
+  // one pass for both size and compress, only counts if arrRLE == nullptr
+  size_t encode(const Byte* arr, size_t numBytes, Byte* arrRLE) const;
+
+  static size_t findRunEnd(const Byte* arr, size_t i, size_t numBytes);
   static void writeCount(short cnt, Byte** ppCnt, Byte** ppDst);
   static short readCount(const Byte** ppCnt);
 
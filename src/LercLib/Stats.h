@@ -0,0 +1,168 @@
+/*
+Copyright 2015 - 2026 Esri
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+A local copy of the license and additional notices are located with the
+source distribution at:
+
+http://github.com/Esri/lerc/
+
+Contributors:  Thomas Maurer
+*/
+
+#ifndef LERC_STATS_H
+#define LERC_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include "Defines.h"
+#include "include/Lerc_types.h"
+
+NAMESPACE_LERC_START
+
+/** Opt in per stage timing and counters of one encode or decode call, see lerc_getLastStats().
+ *
+ *  The top level Lerc functions open a Scope. If stats are enabled, the Scope clears the stats of
+ *  the calling thread and makes them current, and the codec adds to them along the way.
+ *  Otherwise Current() is nullptr and a Timer or Add() costs one thread local load.
+ *  A Parallel::For() task that adds opens a TaskScope on its own Stats, which the caller adds up after the join.
+ *  The batch functions do the same per tile, a whole encode or decode call each.
+ */
+
+class Stats
+{
+public:
+  static void Enable(bool bEnable)  { s_enabled = bEnable; }
+  static Stats* Current()           { return s_pCurrent; }
+  static const Stats& Last()        { return s_last; }
+
+  static void Add(StatsArrOrder item, double val)  { if (s_pCurrent) s_pCurrent->m_arr[(int)item] += val; }
+  static void Set(StatsArrOrder item, double val)  { if (s_pCurrent) s_pCurrent->m_arr[(int)item] = val; }
+
+  double Get(StatsArrOrder item) const  { return m_arr[(int)item]; }
+
+  // for the stats of tasks, which only Add()
+  void AddAll(const Stats& other)  { for (int i = 0; i < (int)StatsArrOrder::_last; i++) m_arr[i] += other.m_arr[i]; }
+
+  // for the stats of whole calls run as tasks, in order; the items of the last band are taken from other
+  void AddCall(const Stats& other)
+  {
+    AddAll(other);
+    for (StatsArrOrder item : { StatsArrOrder::imageEncodeMode, StatsArrOrder::microBlockSize })
+      m_arr[(int)item] = other.m_arr[(int)item];
+  }
+
+  class Scope;
+  class TaskScope;
+  class Timer;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  static double Ms(Clock::time_point t0)  { return std::chrono::duration<double, std::milli>(Clock::now() - t0).count(); }
+
+  double m_arr[(int)StatsArrOrder::_last] = {};
+
+  inline static std::atomic<bool> s_enabled{ false };
+  inline static thread_local Stats* s_pCurrent = nullptr;
+  static thread_local Stats s_last;
+};
+
+inline thread_local Stats Stats::s_last;
+
+// -------------------------------------------------------------------------- ;
+
+// one encode or decode call, nested calls add to the outer one
+
+class Stats::Scope
+{
+public:
+  Scope() : m_pStats(nullptr)
+  {
+    if (s_enabled && !s_pCurrent)
+    {
+      memset(s_last.m_arr, 0, sizeof(s_last.m_arr));
+      s_pCurrent = m_pStats = &s_last;
+      m_t0 = Clock::now();
+    }
+  }
+
+  ~Scope()
+  {
+    if (m_pStats)
+    {
+      m_pStats->m_arr[(int)StatsArrOrder::msTotal] += Ms(m_t0);
+      s_pCurrent = nullptr;
+    }
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  Stats* m_pStats;
+  Clock::time_point m_t0;
+};
+
+// -------------------------------------------------------------------------- ;
+
+// makes pStats current on this thread until it goes out of scope, for a Parallel::For() task;
+// pStats is nullptr if stats are off
+
+class Stats::TaskScope
+{
+public:
+  explicit TaskScope(Stats* pStats) : m_pPrev(s_pCurrent)  { s_pCurrent = pStats; }
+  ~TaskScope()  { s_pCurrent = m_pPrev; }
+
+  TaskScope(const TaskScope&) = delete;
+  TaskScope& operator=(const TaskScope&) = delete;
+
+private:
+  Stats* m_pPrev;
+};
+
+// -------------------------------------------------------------------------- ;
+
+// adds the time until it goes out of scope to a stage
+
+class Stats::Timer
+{
+public:
+  explicit Timer(StatsArrOrder item) : m_pStats(s_pCurrent), m_item(item)
+  {
+    if (m_pStats)
+      m_t0 = Clock::now();
+  }
+
+  ~Timer()
+  {
+    if (m_pStats)
+      m_pStats->m_arr[(int)m_item] += Ms(m_t0);
+  }
+
+  Timer(const Timer&) = delete;
+  Timer& operator=(const Timer&) = delete;
+
+private:
+  Stats* m_pStats;
+  StatsArrOrder m_item;
+  Clock::time_point m_t0;
+};
+
+// -------------------------------------------------------------------------- ;
+
+NAMESPACE_LERC_END
+#endif
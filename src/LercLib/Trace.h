@@ -0,0 +1,163 @@
+/*
+Copyright 2015 - 2026 Esri
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+A local copy of the license and additional notices are located with the
+source distribution at:
+
+http://github.com/Esri/lerc/
+
+Contributors:  Thomas Maurer
+*/
+
+#ifndef LERC_TRACE_H
+#define LERC_TRACE_H
+
+#include "Defines.h"
+
+/** Scope markers for a Chrome trace / Perfetto timeline of the codec stages.
+ *
+ *  LERC_TRACE_SCOPE(name) marks the rest of the enclosing block, LERC_TRACE_SCOPE_ARG(name, argName, arg)
+ *  adds an int such as the band or byte plane. Both compile to nothing unless LERC_USE_TRACING is defined
+ *  (see CMake option LERC_ENABLE_TRACING). Then each thread keeps its events in its own buffer, and at exit
+ *  all are written as JSON to the file named by env var LERC_TRACE_FILE, default lerc_trace.json.
+ *  Open it in chrome://tracing or ui.perfetto.dev.
+ *  Names and argNames must be string literals.
+ */
+
+#ifdef LERC_USE_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+NAMESPACE_LERC_START
+
+class Trace
+{
+public:
+  class Scope
+  {
+  public:
+    explicit Scope(const char* name, const char* argName = nullptr, int arg = 0)
+      : m_name(name), m_argName(argName), m_arg(arg), m_t0(Now()) {}
+
+    ~Scope()  { Local().events.push_back({ m_name, m_argName, m_arg, m_t0, Now() }); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    const char* m_name;
+    const char* m_argName;
+    int m_arg;
+    double m_t0;
+  };
+
+private:
+  struct Event
+  {
+    const char* name;
+    const char* argName;
+    int arg;
+    double t0, t1;    // micro sec since start
+  };
+
+  struct ThreadEvents
+  {
+    int tid = 0;
+    std::vector<Event> events;
+  };
+
+  // per thread buffer, hands its events to the global list when the thread ends
+  struct LocalBuffer : ThreadEvents
+  {
+    LocalBuffer()  { tid = ++Global().numThreads; }
+    ~LocalBuffer()
+    {
+      Sink& g = Global();
+      std::lock_guard<std::mutex> lock(g.mutex);
+      g.done.push_back(*this);
+    }
+  };
+
+  // writes all events at exit, after the thread local buffers of the main thread are gone
+  struct Sink
+  {
+    std::mutex mutex;
+    std::vector<ThreadEvents> done;
+    std::atomic<int> numThreads{ 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    ~Sink()  { Write(); }
+    void Write();
+  };
+
+  static double Now()
+  {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Global().start).count();
+  }
+
+  static Sink& Global()          { static Sink sink; return sink; }
+  static LocalBuffer& Local()    { thread_local LocalBuffer buffer; return buffer; }
+};
+
+// -------------------------------------------------------------------------- ;
+
+inline void Trace::Sink::Write()
+{
+  const char* fn = getenv("LERC_TRACE_FILE");
+  FILE* fp = fopen(fn && *fn ? fn : "lerc_trace.json", "w");
+  if (!fp)
+    return;
+
+  fprintf(fp, "{\"traceEvents\":[\n");
+  bool bFirst = true;
+
+  for (const ThreadEvents& te : done)
+    for (const Event& e : te.events)
+    {
+      fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"lerc\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+        bFirst ? "" : ",\n", e.name, te.tid, e.t0, e.t1 - e.t0);
+
+      if (e.argName)
+        fprintf(fp, ",\"args\":{\"%s\":%d}", e.argName, e.arg);
+
+      fprintf(fp, "}");
+      bFirst = false;
+    }
+
+  fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  fclose(fp);
+}
+
+// -------------------------------------------------------------------------- ;
+
+NAMESPACE_LERC_END
+
+#define LERC_TRACE_CAT2(a, b) a##b
+#define LERC_TRACE_CAT(a, b) LERC_TRACE_CAT2(a, b)
+#define LERC_TRACE_SCOPE(name) LercNS::Trace::Scope LERC_TRACE_CAT(lercTraceScope, __LINE__)(name)
+#define LERC_TRACE_SCOPE_ARG(name, argName, arg) LercNS::Trace::Scope LERC_TRACE_CAT(lercTraceScope, __LINE__)(name, argName, (int)(arg))
+
+#else
+
+#define LERC_TRACE_SCOPE(name)
+#define LERC_TRACE_SCOPE_ARG(name, argName, arg)
+
+#endif
+#endif
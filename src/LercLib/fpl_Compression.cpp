@@ -24,6 +24,7 @@ Original coding 2021 Yuriy Yakimenko
 
 #include "fpl_Compression.h"
 #include "fpl_EsriHuffman.h"
+#include "Huffman.h"
 #include <assert.h>
 #include <cmath>
 #include <cstring>
@@ -84,29 +85,27 @@ size_t fpl_Compression::compress_buffer(const char* data, size_t size, char** ou
 
 long fpl_Compression::getEntropySize(const unsigned char* ptr, const size_t size)
 {
-  unsigned long table[256];
+  ByteHisto byteHisto;
+  byteHisto.Add(ptr, size, PRIME_MULT);
 
-  memset(table, 0, sizeof(table));
-
-  int total_count = 0;
-
-  for (size_t i = 0; i < size; i += PRIME_MULT)
-  {
-    table[ptr[i]]++;
-    total_count++;
-  }
+  return getEntropySize(byteHisto, (size + PRIME_MULT - 1) / PRIME_MULT);
+}
 
+long fpl_Compression::getEntropySize(const ByteHisto& byteHisto, const size_t total_count)
+{
   double total_bits = 0;
 
-  for (size_t i = 0; i < 256; i++)
+  for (int i = 0; i < 256; i++)
   {
-    if (table[i] == 0) continue;
+    unsigned long cnt = byteHisto.GetCount(i);
+
+    if (cnt == 0) continue;
 
-    double p = (double)total_count / table[i];
+    double p = (double)total_count / cnt;
 
     double bits = log2(p);
 
-    total_bits += (bits * table[i]);
+    total_bits += (bits * cnt);
   }
 
   return (long)((total_bits + 7) / 8);
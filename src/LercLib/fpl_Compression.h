@@ -32,12 +32,17 @@ NAMESPACE_LERC_START
 
 #define PRIME_MULT  7
 
+class ByteHisto;
+
 class fpl_Compression
 {
 public:
   static size_t compress_buffer(const char* data, size_t size, char** output, bool fast = false);
   static size_t extract_buffer(const char* data, const size_t size, size_t uncompressed_size, char** output = 0);
 
+  // same estimate as compress_buffer(.., NULL, true), from a histogram of every PRIME_MULT'th byte
+  static long getEntropySize(const ByteHisto& histo, const size_t total_count);
+
 private:
   static long getEntropySize(const unsigned char* ptr, const size_t size);
 };
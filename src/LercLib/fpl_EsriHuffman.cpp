@@ -244,16 +244,9 @@ enum HuffmanFirstByte { HUFFMAN_NORMAL = 0, HUFFMAN_RLE = 1, HUFFMAN_NO_ENCODING
 
 bool ComputeHistoForHuffman(const unsigned char* data, size_t len, std::vector<int>& histo)
 {
-    histo.resize(256);
-
-    memset (&histo[0], 0, histo.size() * sizeof(int));
-
-    for (size_t i = 0; i < len; i++)
-    {
-        unsigned char val = data[i];
-
-        histo[val]++;
-    }
+    ByteHisto byteHisto;
+    byteHisto.Add(data, len);
+    byteHisto.GetHisto(histo);
 
     int cnt = 0;
     for (size_t i = 0; i < 256; i++)
@@ -440,8 +433,11 @@ int fpl_EsriHuffman::EncodeHuffman (const char *input, size_t input_len, unsigne
         }
     }
 
-    size_t numUInts = (bitPos > 0 ? 1 : 0) + 1;    // add one more as the decode LUT can read ahead
-    *ppByte += numUInts * sizeof(unsigned int);
+    if (bitPos > 0)    // the last uint is partly filled
+        *ppByte += sizeof(unsigned int);
+
+    memset(*ppByte, 0, sizeof(unsigned int));    // add one more as the decode LUT can read ahead
+    *ppByte += sizeof(unsigned int);
 
     int ret = (int)(*ppByte - originalPtr);
 
@@ -24,6 +24,9 @@ Original coding 2021 Yuriy Yakimenko
 
 #include "fpl_Lerc2Ext.h"
 #include "fpl_Compression.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include "Huffman.h"
 #include <assert.h>
 #include <cmath>
 #include <cstring>
@@ -100,21 +103,6 @@ static void generateListOfTestBlocks(const int width, const int height, std::vec
   }
 }
 
-static void setDerivativePrime(unsigned char* data, size_t size)
-{
-  int off = (int)size - 1;
-
-  off = PRIME_MULT * (off / PRIME_MULT);
-
-  unsigned char* ptr = data + off;
-  //for (int i = (int)off; i >= 1; i -= PRIME_MULT)
-  while (ptr >= data + 1)
-  {
-    *ptr -= *(ptr - 1);
-    ptr -= PRIME_MULT;
-  }
-}
-
 static void setDerivative(unsigned char* data, size_t size, const int level)
 {
   if (level == 0) return;
@@ -168,6 +156,20 @@ unsigned char* restoreSequence(unsigned char* data, size_t size, const int level
   return copy;
 }
 
+// copy count values, move the float bits same as the full slice gets it
+
+static void copyTransformed(const UnitType unit_type, const void* pSrc, void* pDst, const size_t count)
+{
+  if (unit_type == UNIT_TYPE_FLOAT)
+    UnitTypes::doFloatTransform((const uint32_t*)pSrc, (uint32_t*)pDst, count);
+  else
+    memcpy(pDst, pSrc, count * UnitTypes::size(unit_type));
+}
+
+// estimated compressed size of the test blocks, per byte plane. the byte planes are sampled
+// straight from the values, same as getEntropySize() on the gathered plane, and on its
+// first delta at the sampled positions.
+
 static size_t testBlocksSize(std::vector <TestBlock>& blocks, const UnitType unit_type, const void* _data, const long raster_width, bool test_first_byte_delta)
 {
   size_t ret = 0;
@@ -183,36 +185,31 @@ static size_t testBlocksSize(std::vector <TestBlock>& blocks, const UnitType uni
     size_t start = unit_size * tb.top * raster_width;
     size_t length = tb.height * raster_width;
 
-   // input_len += length * unit_size; //sizeof(uint32_t);
-
-    char* plane_buffer = (char*)malloc(length);
+    if (length == 0)
+      continue;
 
-    assert(plane_buffer);
+    const size_t num_samples = (length + PRIME_MULT - 1) / PRIME_MULT;
 
     for (int byte = 0; byte < (int)unit_size; byte++)
     {
-      char* ptr = (char*)(data + start);
-
-      ptr += byte;
-
-      for (size_t i = 0; i < length; i++)
-      {
-        plane_buffer[i] = *ptr;
+      const uint8_t* ptr = data + start + byte;
 
-        ptr += unit_size;
-      }
+      ByteHisto histo;
+      histo.Add(ptr, (length - 1) * unit_size + 1, PRIME_MULT * unit_size);
 
-      size_t plane_encoded = fpl_Compression::compress_buffer((const char*)plane_buffer, length, NULL, true);
+      size_t plane_encoded = fpl_Compression::getEntropySize(histo, num_samples);
 
       // test with delta 1:
 
       if (test_first_byte_delta)
       {
-        //  setDerivative ((unsigned char *)plane_buffer, length, 1);
+        ByteHisto delta_histo;
+        delta_histo.AddOne(ptr[0]);
 
-        setDerivativePrime((unsigned char*)plane_buffer, length);
+        for (size_t i = PRIME_MULT; i < length; i += PRIME_MULT)
+          delta_histo.AddOne((uint8_t)(ptr[i * unit_size] - ptr[(i - 1) * unit_size]));
 
-        size_t plane_encoded2 = fpl_Compression::compress_buffer((const char*)plane_buffer, length, NULL, true);
+        size_t plane_encoded2 = fpl_Compression::getEntropySize(delta_histo, num_samples);
 
         ret += (std::min)(plane_encoded, plane_encoded2);
       }
@@ -221,14 +218,11 @@ static size_t testBlocksSize(std::vector <TestBlock>& blocks, const UnitType uni
         ret += plane_encoded;
       }
     }
-
-    free(plane_buffer);
   }
 
   return ret;
 }
 
-
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -265,12 +259,24 @@ int getBestLevel2(const unsigned char* ptr, size_t size, const int max_delta_ord
       snippets.push_back(std::make_pair(start, len));
   }
 
-  unsigned char* copy = (unsigned char*)malloc(size);
+  // work on a copy of the snippets only, packed one after the other
+
+  size_t copy_size = 0;
+
+  for (size_t s = 0; s < snippets.size(); s++)
+    copy_size += snippets[s].second;
+
+  unsigned char* copy = (unsigned char*)malloc((std::max)(copy_size, (size_t)1));
 
   if (!copy)
     return 0; // return 0 as fall-back "default" delta.
 
-  memcpy(copy, ptr, size);
+  for (size_t s = 0, pos = 0; s < snippets.size(); s++)
+  {
+    memcpy(copy + pos, ptr + snippets[s].first, snippets[s].second);
+    snippets[s].first = pos;
+    pos += snippets[s].second;
+  }
 
   size_t best_comp = 0;
 
@@ -335,7 +341,7 @@ LosslessFPCompression::~LosslessFPCompression()
   delete m_data_slice;
 }
 
-void LosslessFPCompression::selectInitialLinearOrCrossDelta(const UnitType unit_type, void* pData, const int iWidth,
+bool LosslessFPCompression::selectInitialLinearOrCrossDelta(const UnitType unit_type, const void* pInput, const int iWidth,
   const int iHeight, int& initial_delta, bool& use_cross, bool test_first_byte_delta, size_t* stats)
 {
   std::vector <TestBlock> blocks;
@@ -349,26 +355,54 @@ void LosslessFPCompression::selectInitialLinearOrCrossDelta(const UnitType unit_
 
   generateListOfTestBlocks(iWidth, iHeight, blocks);
 
-  size_t est = 0;
+  // run the trial predictors on a copy of the test blocks only. each block gets the row above
+  // as context, so the deltas in the block are the same as for the whole slice.
+
+  const size_t unit_size = UnitTypes::size(unit_type);
+
+  std::vector<uint8_t> block_copy;
 
-  // unchanged block:
-  est = testBlocksSize(blocks, unit_type, pData, iWidth, test_first_byte_delta);
+  for (size_t blk = 0; blk < blocks.size(); blk++)
+  {
+    const TestBlock& tb = blocks[blk];
 
-  if (stats) { stats[0] += est; }
+    long top = (tb.top > 0) ? tb.top - 1 : 0;
+    long nRows = tb.top + tb.height - top;
 
-  // linear part:
+    std::vector <TestBlock> local_block(1);
+    local_block[0].top = tb.top - top;
+    local_block[0].height = tb.height;
 
-  UnitTypes::setBlockDerivative(unit_type, pData, iWidth, iHeight, 1, 1);
+    try
+    {
+      block_copy.resize((size_t)nRows * iWidth * unit_size);
+    }
+    catch (...)
+    {
+      return false;
+    }
 
-  est = testBlocksSize(blocks, unit_type, pData, iWidth, test_first_byte_delta);
+    copyTransformed(unit_type, (const uint8_t*)pInput + (size_t)top * iWidth * unit_size, &block_copy[0], (size_t)nRows * iWidth);
 
-  if (stats) { stats[1] += est; }
+    // unchanged block:
+    size_t est = testBlocksSize(local_block, unit_type, &block_copy[0], iWidth, test_first_byte_delta);
 
-  UnitTypes::setCrossDerivative(unit_type, pData, iWidth, iHeight, 2, 2);
+    if (stats) { stats[0] += est; }
 
-  est = testBlocksSize(blocks, unit_type, pData, iWidth, test_first_byte_delta);
+    // linear part:
 
-  if (stats) { stats[2] += est; }
+    UnitTypes::setBlockDerivative(unit_type, &block_copy[0], iWidth, nRows, 1, 1);
+
+    est = testBlocksSize(local_block, unit_type, &block_copy[0], iWidth, test_first_byte_delta);
+
+    if (stats) { stats[1] += est; }
+
+    UnitTypes::setCrossDerivative(unit_type, &block_copy[0], iWidth, nRows, 2, 2);
+
+    est = testBlocksSize(local_block, unit_type, &block_copy[0], iWidth, test_first_byte_delta);
+
+    if (stats) { stats[2] += est; }
+  }
 
   size_t min_index = getMinIndex<size_t>(stats, 3);
 
@@ -387,6 +421,8 @@ void LosslessFPCompression::selectInitialLinearOrCrossDelta(const UnitType unit_
     use_cross = false;
     initial_delta = 0;
   }
+
+  return true;
 }
 
 int LosslessFPCompression::compressedLength() const
@@ -404,6 +440,8 @@ int LosslessFPCompression::compressedLength() const
 
 bool LosslessFPCompression::EncodeHuffmanFlt(unsigned char ** ppByte)
 {
+  LERC_TRACE_SCOPE("LosslessFPCompression::EncodeHuffmanFlt");
+
   memcpy(*ppByte, &(m_data_slice->m_predictor_code), sizeof(m_data_slice->m_predictor_code));
   *ppByte += sizeof(m_data_slice->m_predictor_code);
 
@@ -432,6 +470,8 @@ bool LosslessFPCompression::EncodeHuffmanFlt(unsigned char ** ppByte)
 bool LosslessFPCompression::ComputeHuffmanCodesFlt(const void* input, bool bIsDouble,
                 int iCols, int iRows, int iDepth)
 {
+  LERC_TRACE_SCOPE("LosslessFPCompression::ComputeHuffmanCodesFlt");
+
   if (iDepth == 1)
   {
     if (m_data_slice && !m_data_slice->m_buffers.empty())
@@ -455,13 +495,11 @@ bool LosslessFPCompression::ComputeHuffmanCodesFlt(const void* input, bool bIsDo
 
 bool LosslessFPCompression::ComputeHuffmanCodesFltSlice (const void* pInput, bool bIsDouble, int iCols, int iRows)
 {
-  // 1. copy input; when input is 32-bit floats, move bits of copied input values.
-  // 2. copy to temp buffer.
-  // 3. perform selectInitialLinearOrCrossDelta on temp copy; deallocate temp copy.
-  // 4. apply best predictor.
-  // 5. compress individual byte planes while applying additional dynamic delta (bestLevel).
-  // 6. save compessed byte planes in m_buffers and predictor in m_predictor_code.
-  // 7. deallocate copied input.
+  // 1. select the predictor on a few test blocks of rows, copied from the input
+  //    (when input is 32-bit floats, move bits of copied input values).
+  // 2. apply best predictor and split into byte planes, a chunk of rows at a time.
+  // 3. compress individual byte planes while applying additional dynamic delta (bestLevel).
+  // 4. save compessed byte planes in m_buffers and predictor in m_predictor_code.
 
   UnitType unit_type = bIsDouble ? UNIT_TYPE_DOUBLE : UNIT_TYPE_FLOAT;
 
@@ -474,13 +512,6 @@ bool LosslessFPCompression::ComputeHuffmanCodesFltSlice (const void* pInput, boo
   size_t unit_size = UnitTypes::size(unit_type);
   size_t block_size = size;
 
-  uint8_t* block_values = (uint8_t*)malloc(block_size * unit_size);
-
-  memcpy(block_values, pInput, block_size * unit_size);
-
-  if (unit_type == UNIT_TYPE_FLOAT)
-    UnitTypes::doFloatTransform((uint32_t*)block_values, size);
-
   size_t stats1[3] = { 0 };
 
   int block_width = iCols, block_height = iRows;
@@ -489,20 +520,8 @@ bool LosslessFPCompression::ComputeHuffmanCodesFltSlice (const void* pInput, boo
   bool dummy_cross = false;
   bool test_first_byte_delta = true;
 
-  uint8_t* copy = (uint8_t*)malloc(block_size * unit_size);
-
-  if (!copy)
-  {
-    //perror("Out of memory.");
-    free(block_values);
+  if (!selectInitialLinearOrCrossDelta(unit_type, pInput, block_width, block_height, dummy_delta, dummy_cross, test_first_byte_delta, stats1))
     return false;
-  }
-
-  memcpy(copy, block_values, unit_size * block_size);
-
-  selectInitialLinearOrCrossDelta(unit_type, copy, block_width, block_height, dummy_delta, dummy_cross, test_first_byte_delta, stats1);
-
-  free(copy);
 
   size_t min_index = getMinIndex<size_t>(stats1, 3);
 
@@ -517,58 +536,88 @@ bool LosslessFPCompression::ComputeHuffmanCodesFltSlice (const void* pInput, boo
     if (min_index == 2) predictor = PREDICTOR_ROWS_COLS;
   }
 
-  int w = block_width, h = block_height;
-
-  if (predictor == PREDICTOR_ROWS_COLS)
-  {
-    if (predictor == PREDICTOR_ROWS_COLS)
-      UnitTypes::setCrossDerivative(unit_type, block_values, w, h, 2);
-  }
-  else
-  {
-    int delta = 0;
-
-    if (predictor == PREDICTOR_DELTA1) delta = 1;
-
-    UnitTypes::setBlockDerivative(unit_type, block_values, w, h, delta);
-  }
-
   int max_delta = Predictor::getMaxByteDelta(predictor);
 
   if (max_byte_delta >= 0 && max_byte_delta < max_delta)
     max_delta = max_byte_delta;
 
-  unsigned char* block_buff = (unsigned char*)malloc(block_size); // size is the same for all byte planes
+  if (!m_data_slice)
+    m_data_slice = new compressedDataSlice();
+
+  m_data_slice->m_predictor_code = Predictor::getCode(predictor);
+
+  uint8_t* block_planes = (uint8_t*)malloc(block_size * unit_size);
 
-  if (!block_buff)
+  if (!block_planes)
   {
     //perror("Out of memory.");
-    free(block_values);
     return false;
   }
 
-  if (!m_data_slice)
-    m_data_slice = new compressedDataSlice();
+  // apply the predictor and split into byte planes, a chunk of rows at a time, so there is
+  // no full size copy of the input next to the byte planes.
+  // the cross predictor needs the row above, it is copied along as context row.
+
+  const size_t w = block_width, h = block_height;
+  const size_t chunk_rows = (std::max)((size_t)1, (size_t)(256 * 1024) / w);
+  const bool use_cross = (predictor == PREDICTOR_ROWS_COLS);
 
-  for (int byte = 0; byte < (int)unit_size; byte++)
+  uint8_t* chunk = (uint8_t*)malloc(((std::min)(chunk_rows, h) + 1) * w * unit_size);
+
+  if (!chunk)
   {
-    size_t block_index = 0;
+    free(block_planes);
+    return false;
+  }
 
-    size_t block_shift = 0;
+  std::vector<uint8_t*> plane_ptrs(unit_size);
 
-    block_index = byte;
+  for (size_t r0 = 0; r0 < h; r0 += chunk_rows)
+  {
+    size_t r1 = (std::min)(h, r0 + chunk_rows);
+    size_t top = (use_cross && r0 > 0) ? r0 - 1 : r0;
+    size_t nRows = r1 - top;
 
-    size_t len = (size_t)h * w;
+    copyTransformed(unit_type, (const uint8_t*)pInput + top * w * unit_size, chunk, nRows * w);
 
-    while (block_shift < len)
+    if (use_cross)
     {
-      block_buff[block_shift] = block_values[block_index];
+      UnitTypes::setCrossDerivative(unit_type, chunk, w, nRows, 2);
+    }
+    else
+    {
+      int delta = 0;
 
-      block_index += unit_size;
+      if (predictor == PREDICTOR_DELTA1) delta = 1;
 
-      block_shift++;
+      UnitTypes::setBlockDerivative(unit_type, chunk, w, nRows, delta);
     }
 
+    for (size_t byte = 0; byte < unit_size; byte++)
+      plane_ptrs[byte] = block_planes + byte * block_size + r0 * w;
+
+    UnitTypes::gatherBytePlanes(chunk + (r0 - top) * w * unit_size, (r1 - r0) * w, unit_size, &plane_ptrs[0]);
+  }
+
+  free(chunk);
+
+  for (size_t byte = 0; byte < unit_size; byte++)
+    plane_ptrs[byte] = block_planes + byte * block_size;
+
+  // the byte planes are independent of each other, compress them in parallel;
+  // each plane gets its own slot, so the order in the blob stays the same
+
+  std::vector<outBlockBuffer*> planes(unit_size, nullptr);
+  std::vector<char> planeOk(unit_size, 0);
+
+  const size_t minPlaneSizeForThreads = 64 * 1024;
+  int maxThreads = (block_size < minPlaneSizeForThreads) ? 1 : 0;
+
+  Parallel::For(unit_size, [&](size_t byte)
+  {
+    LERC_TRACE_SCOPE_ARG("fpl compress byte plane", "byte", byte);
+    unsigned char* block_buff = plane_ptrs[byte]; // size is the same for all byte planes
+
     int bestLevel = getBestLevel(block_buff, block_size, max_delta);
 
     setDerivative(block_buff, block_size, bestLevel);
@@ -579,42 +628,47 @@ bool LosslessFPCompression::ComputeHuffmanCodesFltSlice (const void* pInput, boo
 
     if (ret > UINT32_MAX) // cannot store compressed size in 32 bits. should not happen.
     {
-      free(block_buff);
-      free(block_values);
-
-      return false;
+      free(compressed);
+      return;
     }
 
     // Down the road, we also can store compression method code (other than default Huffman)
     // in upper top 6 bits, since max predicor value is 2.
 
-    m_data_slice->m_predictor_code = Predictor::getCode(predictor);
+    outBlockBuffer* ob = new outBlockBuffer;
+    ob->compressed = compressed;
+    ob->compressed_size = (uint32_t)ret;
+    ob->byte_index = (unsigned char)byte;
+    ob->best_level = (unsigned char)bestLevel;
 
-    {
-      outBlockBuffer* ob = new outBlockBuffer;
-      ob->compressed = compressed;
-      ob->compressed_size = (uint32_t)ret;
-      ob->byte_index = (unsigned char)byte;
-      ob->best_level = (unsigned char)bestLevel;
+    planes[byte] = ob;
+    planeOk[byte] = 1;
+  }, maxThreads);
+
+  free(block_planes);
+
+  bool ok = std::find(planeOk.begin(), planeOk.end(), 0) == planeOk.end();
 
+  for (auto ob : planes)
+  {
+    if (ok)
       m_data_slice->m_buffers.push_back(ob);
-    }
+    else
+      delete ob;
   }
 
-  free(block_buff);
-  free(block_values);
-
-  return true;
+  return ok;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool restoreCrossBytes(std::vector<std::pair<int, char*> >& output_buffers, const size_t input_in_bytes,
+// interleave the byte planes back into pOutput, restore the predictor delta, undo the float transform
+
+static bool restoreBytePlanes(std::vector<std::pair<int, char*> >& output_buffers,
   const size_t cols, const size_t rows, const PredictorType predictor,
-  //FILE* output,
-  const UnitType unit_type, uint8_t** output_block)
+  const UnitType unit_type, uint8_t* pOutput)
 {
-  lerc_assert(predictor == PREDICTOR_NONE || predictor == PREDICTOR_ROWS_COLS);
+  lerc_assert(predictor == PREDICTOR_NONE || predictor == PREDICTOR_DELTA1 || predictor == PREDICTOR_ROWS_COLS);
 
   size_t unit_size = output_buffers.size();
 
@@ -622,99 +676,30 @@ bool restoreCrossBytes(std::vector<std::pair<int, char*> >& output_buffers, cons
 
   const int delta = Predictor::getIntDelta(predictor);
 
-  size_t block_size = cols * rows;
-
-  assert(input_in_bytes == block_size);
+  const size_t block_size = cols * rows;
 
-  uint8_t* data_buffer = (uint8_t*)malloc(block_size * unit_size);
+  std::vector<const uint8_t*> plane_ptrs(unit_size, (const uint8_t*)NULL);
 
-  if (NULL == data_buffer)
+  for (size_t byte = 0; byte < unit_size; byte++)
   {
-    //perror("Out of memory.");
-    return false;
-  }
-
-  size_t offset = 0;
+    int idx = output_buffers[byte].first;
 
-  for (size_t i = 0; i < block_size; i++)
-  {
-    for (size_t byte = 0; byte < unit_size; byte++)
-    {
-      int idx = output_buffers[byte].first;
-      data_buffer[idx + offset] = output_buffers[byte].second[i];
-    }
+    if (plane_ptrs[idx])    // each byte index must come exactly once
+      return false;
 
-    offset += unit_size;
+    plane_ptrs[idx] = (const uint8_t*)output_buffers[byte].second;
   }
 
-  UnitTypes::restoreCrossBytes(delta, data_buffer, cols, rows, unit_type);
+  UnitTypes::scatterBytePlanes(&plane_ptrs[0], block_size, unit_size, pOutput);
 
-  if (unit_type == UNIT_TYPE_FLOAT)
-  {
-    UnitTypes::undoFloatTransform((uint32_t*)data_buffer, block_size);
-  }
-
-  if (output_block)
-  {
-    *output_block = data_buffer;
-  }
+  if (predictor == PREDICTOR_ROWS_COLS)
+    UnitTypes::restoreCrossBytes(delta, pOutput, cols, rows, unit_type);
   else
-  {
-    free(data_buffer); // Coverity warning fix. Currently, execution never gets here.
-  }
-
-  return true;
-}
-
-bool restoreByteOrder(std::vector<std::pair<int, char*> >& output_buffers,
-  const size_t cols, const size_t rows, const PredictorType predictor, //FILE* output,
-  const UnitType unit_type, uint8_t** output_block)
-{
-  lerc_assert(predictor == PREDICTOR_NONE || predictor == PREDICTOR_DELTA1);
-
-  size_t unit_size = output_buffers.size();
-
-  lerc_assert(unit_size == UnitTypes::size(unit_type));
-
-  const int delta = Predictor::getIntDelta(predictor);
-
-  const size_t block_size = cols * rows;
-
-  uint8_t* data_buffer = (uint8_t*)malloc(block_size * unit_size);
-
-  if (NULL == data_buffer)
-  {
-    //perror("Out of memory.");
-    return false;
-  }
-
-  size_t offset = 0;
-
-  for (size_t i = 0; i < block_size; i++)
-  {
-    for (size_t byte = 0; byte < unit_size; byte++)
-    {
-      int idx = output_buffers[byte].first;
-      data_buffer[idx + offset] = output_buffers[byte].second[i];
-    }
-
-    offset += unit_size;
-  }
-
-  UnitTypes::restoreBlockSequence(delta, data_buffer, cols, rows, unit_type);
+    UnitTypes::restoreBlockSequence(delta, pOutput, cols, rows, unit_type);
 
   if (unit_type == UNIT_TYPE_FLOAT)
   {
-    UnitTypes::undoFloatTransform((uint32_t*)data_buffer, block_size);
-  }
-
-  if (output_block)
-  {
-    *output_block = data_buffer;
-  }
-  else
-  {
-    free(data_buffer); // Coverity warning fix. Currently, execution never gets here.
+    UnitTypes::undoFloatTransform((uint32_t*)pOutput, block_size);
   }
 
   return true;
@@ -725,6 +710,8 @@ bool restoreByteOrder(std::vector<std::pair<int, char*> >& output_buffers,
 bool LosslessFPCompression::DecodeHuffmanFlt(const unsigned char** ppByte, size_t& nBytesRemainingInOut,
   void* pData, bool bIsDouble, int iWidth, int iHeight, int iDepth)
 {
+  LERC_TRACE_SCOPE("LosslessFPCompression::DecodeHuffmanFlt");
+
   if (iDepth == 1)
   {
     return DecodeHuffmanFltSlice (ppByte, nBytesRemainingInOut, pData, bIsDouble, iWidth, iHeight);
@@ -762,6 +749,16 @@ bool LosslessFPCompression::DecodeHuffmanFltSlice (const unsigned char** ppByte,
 
   nBytesRemainingInOut -= sizeof(pred_code);
 
+  struct PlaneInfo
+  {
+    const unsigned char* compressed;
+    uint32_t compressed_size;
+    unsigned char byte_index, best_level;
+    char* restored;
+  };
+
+  std::vector<PlaneInfo> planes(bytes);
+
   for (size_t byte = 0; byte < bytes; byte++)
   {
     unsigned char byte_index = 0, best_level = 0;
@@ -793,30 +790,49 @@ bool LosslessFPCompression::DecodeHuffmanFltSlice (const unsigned char** ppByte,
     if (nBytesRemainingInOut < compressed_size)
       return false;
 
-    unsigned char* compressed = (unsigned char *)malloc(compressed_size);
-
-    if (!compressed)
-      return false;
+    planes[byte].compressed = ptr;
+    planes[byte].compressed_size = compressed_size;
+    planes[byte].byte_index = byte_index;
+    planes[byte].best_level = best_level;
+    planes[byte].restored = NULL;
 
-    memcpy(compressed, ptr, compressed_size);
     ptr += compressed_size;
 
     nBytesRemainingInOut -= compressed_size;
+  }
+
+  // all plane offsets are known now, decode the byte planes in parallel
+
+  const size_t minPlaneSizeForThreads = 64 * 1024;
+  int maxThreads = (expected_size < minPlaneSizeForThreads) ? 1 : 0;
+
+  Parallel::For(bytes, [&](size_t byte)
+  {
+    LERC_TRACE_SCOPE_ARG("fpl decompress byte plane", "byte", byte);
+    PlaneInfo& plane = planes[byte];
 
     char* uncompressed = NULL;
 
-    size_t extracted_size = fpl_Compression::extract_buffer((const char *)compressed, compressed_size, expected_size, &uncompressed);
+    size_t extracted_size = fpl_Compression::extract_buffer((const char *)plane.compressed, plane.compressed_size, expected_size, &uncompressed);
 
     lerc_assert(expected_size == extracted_size);
 
-    free(compressed);
-    compressed = NULL;
+    if (!uncompressed)
+      return;
+
+    int byte_delta = plane.best_level;
 
-    int byte_delta = best_level;
+    plane.restored = (char*)restoreSequence((unsigned char*)uncompressed, extracted_size, byte_delta, false);
+  }, maxThreads);
 
-    unsigned char* restored = restoreSequence((unsigned char*)uncompressed, extracted_size, byte_delta, false);
+  bool planesOk = true;
+
+  for (size_t byte = 0; byte < bytes; byte++)
+  {
+    output_buffers.push_back(std::make_pair(planes[byte].byte_index, planes[byte].restored));
 
-    output_buffers.push_back(std::make_pair(byte_index, (char*)restored));
+    if (!planes[byte].restored)
+      planesOk = false;
   }
 
  // nBytesRemainingInOut -= (ptr - *ppByte); => done above.
@@ -824,28 +840,11 @@ bool LosslessFPCompression::DecodeHuffmanFltSlice (const unsigned char** ppByte,
 
   PredictorType predictor = Predictor::getType(pred_code);
 
-  const bool use_cross_delta = (predictor == PREDICTOR_ROWS_COLS);
-
-  uint8_t* output_block_data = NULL;
-
-  bool ret = (predictor != PREDICTOR_UNKNOWN);
+  bool ret = planesOk && (predictor != PREDICTOR_UNKNOWN);
 
   if (ret)
   {
-    if (use_cross_delta)
-    {
-      ret = restoreCrossBytes(output_buffers, expected_size, iWidth, iHeight, predictor,
-        //NULL,
-        unit_type,
-        &output_block_data);
-    }
-    else
-    {
-      ret = restoreByteOrder(output_buffers, iWidth, iHeight, predictor,
-        //NULL,
-        unit_type,
-        &output_block_data);
-    }
+    ret = restoreBytePlanes(output_buffers, iWidth, iHeight, predictor, unit_type, (uint8_t*)pData);
   }
 
   for (size_t i = 0; i < output_buffers.size(); i++)
@@ -855,12 +854,5 @@ bool LosslessFPCompression::DecodeHuffmanFltSlice (const unsigned char** ppByte,
 
   output_buffers.clear();
 
-  if (output_block_data) // ret is already set to false if memory was not allocated.
-  {
-    memcpy(pData, output_block_data, bytes * iWidth * iHeight);
-
-    free(output_block_data);
-  }
-
   return (ret);
 }
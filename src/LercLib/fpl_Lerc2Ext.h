@@ -89,7 +89,7 @@ private:
 
   compressedDataSlice * m_data_slice;
 
-  void selectInitialLinearOrCrossDelta(const UnitType type, void* pData, const int iWidth, const int iHeight, int& initial_delta, bool& use_cross, bool test_first_byte_delta, size_t* stats = NULL);
+  bool selectInitialLinearOrCrossDelta(const UnitType type, const void* pInput, const int iWidth, const int iHeight, int& initial_delta, bool& use_cross, bool test_first_byte_delta, size_t* stats = NULL);
 
   bool ComputeHuffmanCodesFltSlice (const void* pInput, bool bIsDouble, int iCols, int iRows);
 
@@ -23,9 +23,16 @@ Original coding 2021 Yuriy Yakimenko
 */
 
 #include "fpl_UnitTypes.h"
+#include "Parallel.h"
 #include <assert.h>
+#include <algorithm>
 #include <cstring>
 #include <stdint.h>
+#include <vector>
+
+#ifdef LERC_HAVE_SSE2
+#include <emmintrin.h>
+#endif
 
 USING_NAMESPACE_LERC
 
@@ -36,122 +43,416 @@ static const uint32_t FLT_9BIT_MASK = 0xFF800000U;
 
 #define FLT_BIT_23    (1 << 22) //0x00400000U
 
-uint32_t moveBits2Front(const uint32_t a)
-{
-  uint32_t ret = a & FLT_MANT_MASK;
+// move the float sign bit behind the exponent, so the top byte holds the exponent only
 
-  uint32_t ae = ((a & FLT_9BIT_MASK) >> 23) & 0xFF;
+static inline uint32_t moveBits2Front(const uint32_t a)
+{
+  return (a & FLT_MANT_MASK) | ((a << 1) & 0xFF000000U) | ((a >> 8) & 0x00800000U);
+}
 
-  uint32_t as = ((a & 0x80000000) >> 31) & 0x01;
+static inline uint32_t undo_moveBits2Front(const uint32_t a)
+{
+  return (a & FLT_MANT_MASK) | ((a >> 1) & 0x7F800000U) | ((a << 8) & 0x80000000U);
+}
 
-  ret |= (ae << 24);
-  ret |= (as << 23);
+void UnitTypes::doFloatTransform(uint32_t* pData, const size_t iCnt)
+{
+  doFloatTransform(pData, pData, iCnt);
+}
 
-  return ret;
+void UnitTypes::undoFloatTransform(uint32_t* pData, const size_t iCnt)
+{
+  undoFloatTransform(pData, pData, iCnt);
 }
 
-uint32_t undo_moveBits2Front(const uint32_t a)
+void UnitTypes::doFloatTransform(const uint32_t* pSrc, uint32_t* pDst, const size_t iCnt)
 {
-  uint32_t ret = a & FLT_MANT_MASK;
+  for (size_t i = 0; i < iCnt; i++)
+  {
+    pDst[i] = moveBits2Front(pSrc[i]);
+  }
+}
 
-  uint32_t ae = ((a & FLT_9BIT_MASK) >> 24) & 0xFF;
+void UnitTypes::undoFloatTransform(const uint32_t* pSrc, uint32_t* pDst, const size_t iCnt)
+{
+  for (size_t i = 0; i < iCnt; i++)
+  {
+    pDst[i] = undo_moveBits2Front(pSrc[i]);
+  }
+}
 
-  uint32_t as = (a >> 23) & 0x01;
+/////////////////////////////////////////////////////////////////////////////////////////
 
-  ret |= (ae << 23);
-  ret |= (as << 31);
+// Byte plane transpose. With SSE2, 16 units at a time: 4 (8) registers hold 64 (128) bytes;
+// unpacking the first half against the second half moves the byte at index i to rotl(i, 1),
+// seen as a 6 (7) bit index. Gather needs rotl(i, 4) for 4 and 8 byte units,
+// scatter the inverse, which is rotl(i, 2) for 4 byte units and rotl(i, 3) for 8 byte units.
 
-  return ret;
-}
+#ifdef LERC_HAVE_SSE2
 
-void UnitTypes::doFloatTransform(uint32_t* pData, const size_t iCnt)
+template<int N>
+static inline void unpackHalves(__m128i* x)
 {
-  for (size_t i = 0; i < iCnt; i++)
+  __m128i t[N];
+
+  for (int k = 0; k < N / 2; k++)
   {
-    pData[i] = moveBits2Front(pData[i]);
+    t[2 * k    ] = _mm_unpacklo_epi8(x[k], x[k + N / 2]);
+    t[2 * k + 1] = _mm_unpackhi_epi8(x[k], x[k + N / 2]);
   }
+
+  for (int k = 0; k < N; k++)
+    x[k] = t[k];
 }
 
-void UnitTypes::undoFloatTransform(uint32_t* pData, const size_t iCnt)
+template<int N>
+static size_t gatherBytePlanesSSE2(const uint8_t* pData, const size_t iCnt, uint8_t* const* ppPlanes)
 {
-  for (size_t i = 0; i < iCnt; i++)
+  size_t i = 0;
+
+  for (; i + 16 <= iCnt; i += 16)
   {
-    pData[i] = undo_moveBits2Front(pData[i]);
+    __m128i x[N];
+
+    for (int k = 0; k < N; k++)
+      x[k] = _mm_loadu_si128((const __m128i*)(pData + i * N + 16 * k));
+
+    for (int r = 0; r < 4; r++)
+      unpackHalves<N>(x);
+
+    for (int k = 0; k < N; k++)
+      _mm_storeu_si128((__m128i*)(ppPlanes[k] + i), x[k]);
   }
+
+  return i;
 }
 
-uint32_t SUB32_BIT_FLT(const uint32_t& a, const uint32_t& b)
+template<int N>
+static size_t scatterBytePlanesSSE2(const uint8_t* const* ppPlanes, const size_t iCnt, uint8_t* pData)
 {
-  uint32_t ret = 0;
+  const int nRounds = (N == 4) ? 2 : 3;
+  size_t i = 0;
 
-  const bool no_exp_delta = false;
+  for (; i + 16 <= iCnt; i += 16)
+  {
+    __m128i x[N];
 
-  ret = ((a - b) & FLT_MANT_MASK);
+    for (int k = 0; k < N; k++)
+      x[k] = _mm_loadu_si128((const __m128i*)(ppPlanes[k] + i));
 
-  uint32_t ae = ((a & FLT_9BIT_MASK) >> 23) & 0x1FF;
-  uint32_t be = no_exp_delta ? 0 : ((b & FLT_9BIT_MASK) >> 23) & 0x1FF;
+    for (int r = 0; r < nRounds; r++)
+      unpackHalves<N>(x);
 
-  ret |= (((ae - be) & 0x1FF) << 23);
+    for (int k = 0; k < N; k++)
+      _mm_storeu_si128((__m128i*)(pData + i * N + 16 * k), x[k]);
+  }
 
-  return ret;
+  return i;
 }
 
-uint32_t ADD32_BIT_FLT(const uint32_t& a, const uint32_t& b)
+#endif
+
+void UnitTypes::gatherBytePlanes(const uint8_t* pData, const size_t iCnt, const size_t unit_size, uint8_t* const* ppPlanes)
 {
-  uint32_t ret = 0;
+  size_t i = 0;
+
+#ifdef LERC_HAVE_SSE2
+  if (unit_size == 4)
+    i = gatherBytePlanesSSE2<4>(pData, iCnt, ppPlanes);
+  else if (unit_size == 8)
+    i = gatherBytePlanesSSE2<8>(pData, iCnt, ppPlanes);
+#endif
+
+  const uint8_t* src = pData + i * unit_size;
 
-  const bool no_exp_delta = false;
+  for (; i < iCnt; i++)
+  {
+    for (size_t k = 0; k < unit_size; k++)
+      ppPlanes[k][i] = *src++;
+  }
+}
 
-  ret = ((a + b) & FLT_MANT_MASK);
+void UnitTypes::scatterBytePlanes(const uint8_t* const* ppPlanes, const size_t iCnt, const size_t unit_size, uint8_t* pData)
+{
+  size_t i = 0;
 
-  uint32_t ae = ((a & FLT_9BIT_MASK) >> 23) & 0x1FF;
-  uint32_t be = no_exp_delta ? 0 : ((b & FLT_9BIT_MASK) >> 23) & 0x1FF;
+#ifdef LERC_HAVE_SSE2
+  if (unit_size == 4)
+    i = scatterBytePlanesSSE2<4>(ppPlanes, iCnt, pData);
+  else if (unit_size == 8)
+    i = scatterBytePlanesSSE2<8>(ppPlanes, iCnt, pData);
+#endif
 
-  ret |= (((ae + be) & 0x1FF) << 23);
+  uint8_t* dst = pData + i * unit_size;
 
-  return ret;
+  for (; i < iCnt; i++)
+  {
+    for (size_t k = 0; k < unit_size; k++)
+      *dst++ = ppPlanes[k][i];
+  }
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+
 static const uint64_t DBL_MANT_MASK = 0x000FFFFFFFFFFFFFULL;
 static const uint64_t DBL_12BIT_MASK = 0xFFF0000000000000ULL;
 
+/////////////////////////////////////////////////////////////////////////////////////////
+
+// Kernels for the float and double transforms below. Deltas are taken on the mantissa and on the upper
+// 9 (12) bits as separate fields, mod 2^n each. Masking the upper bits before the add / sub does that
+// without shifts. It is also associative, so the restore (a prefix sum) can run in blocks and still
+// give the same bits as the sequential loop.
+
+struct FltFields
+{
+  typedef uint32_t T;
+  static T sub(T a, T b)  { return ((a - b) & FLT_MANT_MASK) | ((a & FLT_9BIT_MASK) - (b & FLT_9BIT_MASK)); }
+  static T add(T a, T b)  { return ((a + b) & FLT_MANT_MASK) | ((a & FLT_9BIT_MASK) + (b & FLT_9BIT_MASK)); }
+
+#ifdef LERC_HAVE_SSE2
+  static const int nLanes = 4;
+  static __m128i mantMask()  { return _mm_set1_epi32((int)FLT_MANT_MASK); }
+  static __m128i subV(__m128i a, __m128i b)
+  {
+    const __m128i m = mantMask();
+    return _mm_or_si128(_mm_and_si128(_mm_sub_epi32(a, b), m), _mm_sub_epi32(_mm_andnot_si128(m, a), _mm_andnot_si128(m, b)));
+  }
+  static __m128i addV(__m128i a, __m128i b)
+  {
+    const __m128i m = mantMask();
+    return _mm_or_si128(_mm_and_si128(_mm_add_epi32(a, b), m), _mm_add_epi32(_mm_andnot_si128(m, a), _mm_andnot_si128(m, b)));
+  }
+  static __m128i scanV(__m128i x)    // inclusive prefix sum over the lanes
+  {
+    x = addV(x, _mm_slli_si128(x, 4));
+    return addV(x, _mm_slli_si128(x, 8));
+  }
+  static __m128i lastV(__m128i x)  { return _mm_shuffle_epi32(x, 0xFF); }
+  static __m128i set1(T c)  { return _mm_set1_epi32((int)c); }
+#endif
+};
+
+struct DblFields
+{
+  typedef uint64_t T;
+  static T sub(T a, T b)  { return ((a - b) & DBL_MANT_MASK) | ((a & DBL_12BIT_MASK) - (b & DBL_12BIT_MASK)); }
+  static T add(T a, T b)  { return ((a + b) & DBL_MANT_MASK) | ((a & DBL_12BIT_MASK) + (b & DBL_12BIT_MASK)); }
+
+#ifdef LERC_HAVE_SSE2
+  static const int nLanes = 2;
+  static __m128i mantMask()  { return _mm_set1_epi64x((long long)DBL_MANT_MASK); }
+  static __m128i subV(__m128i a, __m128i b)
+  {
+    const __m128i m = mantMask();
+    return _mm_or_si128(_mm_and_si128(_mm_sub_epi64(a, b), m), _mm_sub_epi64(_mm_andnot_si128(m, a), _mm_andnot_si128(m, b)));
+  }
+  static __m128i addV(__m128i a, __m128i b)
+  {
+    const __m128i m = mantMask();
+    return _mm_or_si128(_mm_and_si128(_mm_add_epi64(a, b), m), _mm_add_epi64(_mm_andnot_si128(m, a), _mm_andnot_si128(m, b)));
+  }
+  static __m128i scanV(__m128i x)  { return addV(x, _mm_slli_si128(x, 8)); }
+  static __m128i lastV(__m128i x)  { return _mm_unpackhi_epi64(x, x); }
+  static __m128i set1(T c)  { return _mm_set1_epi64x((long long)c); }
+#endif
+};
+
+// dst[i] = a[i] - b[i], from the end down, so it works in place for dst == a, b == a - k (k > 0)
 
-uint64_t SUB64_BIT_DBL(const uint64_t& a, const uint64_t& b)
+template<class F>
+static void subArrays(typename F::T* dst, const typename F::T* a, const typename F::T* b, size_t n)
 {
-  uint64_t ret = 0;
+#ifdef LERC_HAVE_SSE2
+  const size_t nl = F::nLanes;
+  for (; n >= nl; n -= nl)
+  {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + n - nl));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + n - nl));
+    _mm_storeu_si128((__m128i*)(dst + n - nl), F::subV(va, vb));
+  }
+#endif
+  while (n-- > 0)
+    dst[n] = F::sub(a[n], b[n]);
+}
 
-  const bool no_exp_delta = false;
+// dst[i] = a[i] + b[i], dst must not overlap b
 
-  uint64_t am = a & DBL_MANT_MASK;
-  uint64_t bm = b & DBL_MANT_MASK;
+template<class F>
+static void addArrays(typename F::T* dst, const typename F::T* a, const typename F::T* b, size_t n)
+{
+  size_t i = 0;
+#ifdef LERC_HAVE_SSE2
+  const size_t nl = F::nLanes;
+  for (; i + nl <= n; i += nl)
+  {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    _mm_storeu_si128((__m128i*)(dst + i), F::addV(va, vb));
+  }
+#endif
+  for (; i < n; i++)
+    dst[i] = F::add(a[i], b[i]);
+}
 
-  ret = ((am - bm) & DBL_MANT_MASK);
+// p[i] = p[i] + p[i - 1] for i = 1 .. n - 1, in place
 
-  uint64_t ae = ((a & DBL_12BIT_MASK) >> 52) & 0xFFF;
-  uint64_t be = no_exp_delta ? 0 : ((b & DBL_12BIT_MASK) >> 52) & 0xFFF;
+template<class F>
+static void prefixSum(typename F::T* p, size_t n)
+{
+  if (n < 2)
+    return;
 
-  ret |= (((ae - be) & 0xFFF) << 52);
+  size_t i = 0;
+#ifdef LERC_HAVE_SSE2
+  const size_t nl = F::nLanes;
+  __m128i carry = _mm_setzero_si128();    // 0 is neutral for add()
 
-  return ret;
+  for (; i + nl <= n; i += nl)
+  {
+    __m128i x = F::addV(F::scanV(_mm_loadu_si128((const __m128i*)(p + i))), carry);
+    _mm_storeu_si128((__m128i*)(p + i), x);
+    carry = F::lastV(x);
+  }
+#endif
+  if (i == 0)
+    i = 1;
+  for (; i < n; i++)
+    p[i] = F::add(p[i], p[i - 1]);
 }
 
-uint64_t ADD64_BIT_DBL(const uint64_t& a, const uint64_t& b)
+// p[i] = p[i] + c for i = 0 .. n - 1
+
+template<class F>
+static void addConst(typename F::T* p, size_t n, const typename F::T c)
 {
-  uint64_t ret = 0;
+  size_t i = 0;
+#ifdef LERC_HAVE_SSE2
+  const size_t nl = F::nLanes;
+  const __m128i vc = F::set1(c);
+  for (; i + nl <= n; i += nl)
+    _mm_storeu_si128((__m128i*)(p + i), F::addV(_mm_loadu_si128((const __m128i*)(p + i)), vc));
+#endif
+  for (; i < n; i++)
+    p[i] = F::add(p[i], c);
+}
+
+static const size_t kMinParallelCount = 1 << 16;    // below this, threads cost more than they save
+
+// prefixSum() for a long 1D array, as local scans per block in parallel, then a serial pass over
+// the block ends, then adding the carries in parallel
+
+template<class F>
+static void prefixSumBlocked(typename F::T* p, size_t n)
+{
+  typedef typename F::T T;
+
+  const int nThreads = n < kMinParallelCount ? 1 : Parallel::NumThreads(n / (kMinParallelCount / 4));
+  if (nThreads <= 1)
+  {
+    prefixSum<F>(p, n);
+    return;
+  }
+
+  const size_t nBlocks = (size_t)nThreads * 4;
+  const size_t blockSize = (n + nBlocks - 1) / nBlocks;
+
+  Parallel::For(nBlocks, [&](size_t b)
+  {
+    size_t i0 = b * blockSize;
+    if (i0 < n)
+      prefixSum<F>(p + i0, std::min(blockSize, n - i0));
+  });
+
+  std::vector<T> carry(nBlocks, 0);
+  for (size_t b = 1; b < nBlocks && b * blockSize < n; b++)
+    carry[b] = F::add(carry[b - 1], p[b * blockSize - 1]);
+
+  Parallel::For(nBlocks, [&](size_t b)
+  {
+    size_t i0 = b * blockSize;
+    if (b > 0 && i0 < n)
+      addConst<F>(p + i0, std::min(blockSize, n - i0), carry[b]);
+  });
+}
+
+// row[i] = row[i] + row[i - 1] for i = i0 .. nCols - 1 (i0 >= 1), on each row of a grid
+
+template<class F>
+static void prefixSumRows(typename F::T* pData, const size_t nCols, const size_t nRows, const size_t i0)
+{
+  if (nCols <= i0)
+    return;
+
+  const size_t k0 = i0 - 1;
 
-  const bool no_exp_delta = false;
+  if (nRows == 1)
+  {
+    prefixSumBlocked<F>(pData + k0, nCols - k0);
+    return;
+  }
+
+  const size_t nTotal = nCols * nRows;
+  const size_t rowsPerTask = std::max((size_t)1, std::min(nRows, kMinParallelCount / 4 / nCols));
+  const size_t nTasks = (nRows + rowsPerTask - 1) / rowsPerTask;
+
+  Parallel::For(nTasks, [&](size_t t)
+  {
+    size_t r1 = std::min(nRows, (t + 1) * rowsPerTask);
+    for (size_t r = t * rowsPerTask; r < r1; r++)
+      prefixSum<F>(pData + r * nCols + k0, nCols - k0);
+  }, nTotal < kMinParallelCount ? 1 : 0);
+}
+
+// row[r] = row[r] + row[r - 1] for r = 1 .. nRows - 1, in strips of columns
 
-  uint64_t am = a & DBL_MANT_MASK;
-  uint64_t bm = b & DBL_MANT_MASK;
+template<class F>
+static void prefixSumCols(typename F::T* pData, const size_t nCols, const size_t nRows)
+{
+  if (nRows < 2)
+    return;
 
-  ret = ((am + bm) & DBL_MANT_MASK);
+  const size_t nTotal = nCols * nRows;
+  const int nThreads = nTotal < kMinParallelCount ? 1 : Parallel::NumThreads(nCols / 64);
+  const size_t stripWidth = nThreads <= 1 ? nCols : ((nCols + nThreads - 1) / nThreads + 15) & ~(size_t)15;
+  const size_t nStrips = (nCols + stripWidth - 1) / stripWidth;
 
-  uint64_t ae = ((a & DBL_12BIT_MASK) >> 52) & 0xFFF;
-  uint64_t be = no_exp_delta ? 0 : ((b & DBL_12BIT_MASK) >> 52) & 0xFFF;
+  Parallel::For(nStrips, [&](size_t k)
+  {
+    size_t c0 = k * stripWidth, w = std::min(stripWidth, nCols - c0);
+    typename F::T* row = pData + c0;
+    for (size_t r = 1; r < nRows; r++, row += nCols)
+      addArrays<F>(row + nCols, row + nCols, row, w);
+  }, nThreads);
+}
 
-  ret |= (((ae + be) & 0xFFF) << 52);
+// forward transforms, the inverse of the above
 
-  return ret;
+template<class F>
+static void derivative(typename F::T* p, const size_t count, const int start_level, const int end_level)
+{
+  for (int l = start_level; l <= end_level; l++)
+    if (count > (size_t)l)
+      subArrays<F>(p + l, p + l, p + l - 1, count - l);
+}
+
+template<class F>
+static void crossDerivative(typename F::T* pData, const size_t nCols, const size_t nRows, int phase)
+{
+  if (phase == 0 || phase == 1)
+  {
+    for (size_t iRow = 0; iRow < nRows; iRow++)
+      derivative<F>(pData + iRow * nCols, nCols, 1, 1);
+  }
+
+  if (phase == 0 || phase == 2)
+  {
+    for (size_t iRow = nRows - 1; iRow >= 1; iRow--)    // bottom up, row by row
+    {
+      typename F::T* row = pData + iRow * nCols;
+      subArrays<F>(row, row, row - nCols, nCols);
+    }
+  }
 }
 
 size_t UnitTypes::size (const UnitType type)
@@ -224,24 +525,12 @@ unsigned char UnitTypes::unitCode (const UnitType type)
 ///////////////////////////////////////////////////////////////////////////////////////////////
 void setDerivativeFloat (uint32_t * pData, const size_t count, const int level, const int start_level)
 {
-    for (int l = start_level; l <= level; l++)
-    {
-        for (int i = (int)count - 1; i >= l; i--)
-        {
-            pData[i] = SUB32_BIT_FLT (pData[i], pData[i - 1]);
-        }
-    }
+    derivative<FltFields> (pData, count, start_level, level);
 }
 
 void setDerivativeDouble (uint64_t * pData, const size_t count, const int nLevel, const int start_level)
 {
-    for (int l = start_level; l <= nLevel; l++)
-    {
-        for (int i = (int)count - 1; i >= l; i--)
-        {
-            pData[i] = SUB64_BIT_DBL (pData[i], pData[i - 1]);
-        }
-    }
+    derivative<DblFields> (pData, count, start_level, nLevel);
 }
 
 template <typename T>
@@ -305,8 +594,6 @@ void setRowsDerivativeFloat (uint32_t *pData, const size_t nCols, const size_t n
 
     assert (nLevel >= 2) ;
 
-    uint32_t * row_data = pData;
-
     int start_level = 1;
     int end_level = nLevel;
 
@@ -315,15 +602,7 @@ void setRowsDerivativeFloat (uint32_t *pData, const size_t nCols, const size_t n
 
     for (size_t iRow = 0; iRow < nRows; iRow++)
     {
-        for (int l = start_level; l <= end_level; l++)
-        {
-            for (int i = (int)nCols - 1; i >= l; i--)
-            {
-                row_data [i] = SUB32_BIT_FLT (row_data[i], row_data[i - 1]);
-            }
-        }
-
-        row_data += nCols;
+        derivative<FltFields> (pData + iRow * nCols, nCols, start_level, end_level);
     }
 }
 
@@ -333,8 +612,6 @@ void setRowsDerivativeDouble (uint64_t *pData, const size_t nCols, const size_t
 
     assert (nLevel >= 2) ;
 
-    uint64_t * row_data = pData;
-
     int start_level = 1;
     int end_level = nLevel;
 
@@ -343,15 +620,7 @@ void setRowsDerivativeDouble (uint64_t *pData, const size_t nCols, const size_t
 
     for (size_t iRow = 0; iRow < nRows; iRow++)
     {
-        for (int l = start_level; l <= end_level; l++)
-        {
-            for (int i = (int)nCols - 1; i >= l; i--)
-            {
-                row_data [i] = SUB64_BIT_DBL (row_data[i], row_data[i - 1]);
-            }
-        }
-
-        row_data += nCols;
+        derivative<DblFields> (pData + iRow * nCols, nCols, start_level, end_level);
     }
 }
 
@@ -439,39 +708,7 @@ void setCrossDerivativeFloat (uint32_t *pData, const size_t nCols, const size_t
 
     assert (nLevel >= 2) ;
 
-    uint32_t * row_data = pData;
-
-    if (phase == 0 || phase == 1)
-    {
-        for (size_t iRow = 0; iRow < nRows; iRow++)
-        {
-            for (int i = (int)nCols - 1; i >= 1; i--)
-            {
-                row_data[i] = SUB32_BIT_FLT (row_data[i], row_data[i - 1]);
-            }
-
-            row_data += nCols;
-        }
-    }
-
-    row_data = pData;
-
-    if (phase == 0 || phase == 2)
-    {
-        for (size_t iCol = 0; iCol < nCols; iCol++)
-        {
-            size_t iShift = (nRows - 1) * nCols;
-
-            for (int i = (int)nRows - 1; i >= 1; i--)
-            {
-                row_data[iShift] = SUB32_BIT_FLT (row_data[iShift], row_data[iShift - nCols]);
-
-                iShift -= nCols;
-            }
-
-            row_data += 1;
-        }
-    }
+    crossDerivative<FltFields> (pData, nCols, nRows, phase);
 }
 
 void setCrossDerivativeDouble (uint64_t *pData, const size_t nCols, const size_t nRows, const int nLevel, int phase)
@@ -480,39 +717,7 @@ void setCrossDerivativeDouble (uint64_t *pData, const size_t nCols, const size_t
 
     assert (nLevel >= 2) ;
 
-    uint64_t * row_data = pData;
-
-    if (phase == 0 || phase == 1)
-    {
-        for (size_t iRow = 0; iRow < nRows; iRow++)
-        {
-            for (int i = (int)nCols - 1; i >= 1; i--)
-            {
-                row_data[i] = SUB64_BIT_DBL (row_data[i], row_data[i - 1]);
-            }
-
-            row_data += nCols;
-        }
-    }
-
-    row_data = pData;
-
-    if (phase == 0 || phase == 2)
-    {
-        for (size_t iCol = 0; iCol < nCols; iCol++)
-        {
-            size_t iShift = (nRows - 1) * nCols;
-
-            for (int i = (int)nRows - 1; i >= 1; i--)
-            {
-                row_data[iShift] = SUB64_BIT_DBL (row_data[iShift], row_data[iShift - nCols]);
-
-                iShift -= nCols;
-            }
-
-            row_data += 1;
-        }
-    }
+    crossDerivative<DblFields> (pData, nCols, nRows, phase);
 }
 
 
@@ -625,73 +830,27 @@ void UnitTypes::setBlockDerivative (const UnitType type, void *pData, const size
 
 void restoreBlockSequenceFloat (const int nDelta, uint32_t *pData, const size_t nCols, const size_t nRows)
 {
-    uint32_t * row_data = pData;
-
-    if (true)
+    if (nDelta == 2)
     {
-        if (nDelta == 2)
-        {
-            for (size_t iRow = 0; iRow < nRows; iRow++)
-            {
-                for (size_t i = 2; i < nCols; i++)
-                {
-                    row_data [i] = ADD32_BIT_FLT (row_data [i], row_data [i - 1] );
-                }
-
-                row_data += nCols;
-            }
-        }
-
-        if (nDelta > 0)
-        {
-            row_data = pData;
-
-            for (size_t iRow = 0; iRow < nRows; iRow++)
-            {
-                for (size_t i = 1; i < nCols; i++)
-                {
-                    row_data [i] = ADD32_BIT_FLT (row_data [i], row_data [i - 1] );
-                }
+        prefixSumRows<FltFields> (pData, nCols, nRows, 2);
+    }
 
-                row_data += nCols;
-            }
-        }
+    if (nDelta > 0)
+    {
+        prefixSumRows<FltFields> (pData, nCols, nRows, 1);
     }
 }
 
 void restoreBlockSequenceDouble (const int nDelta, uint64_t *pData, const size_t nCols, const size_t nRows)
 {
-    uint64_t * row_data = pData;
-
-    if (true)
+    if (nDelta == 2)
     {
-        if (nDelta == 2)
-        {
-            for (size_t iRow = 0; iRow < nRows; iRow++)
-            {
-                for (size_t i = 2; i < nCols; i++)
-                {
-                    row_data [i] = ADD64_BIT_DBL (row_data [i], row_data [i - 1] );
-                }
-
-                row_data += nCols;
-            }
-        }
-
-        if (nDelta > 0)
-        {
-            row_data = pData;
-
-            for (size_t iRow = 0; iRow < nRows; iRow++)
-            {
-                for (size_t i = 1; i < nCols; i++)
-                {
-                    row_data [i] = ADD64_BIT_DBL (row_data [i], row_data [i - 1] );
-                }
+        prefixSumRows<DblFields> (pData, nCols, nRows, 2);
+    }
 
-                row_data += nCols;
-            }
-        }
+    if (nDelta > 0)
+    {
+        prefixSumRows<DblFields> (pData, nCols, nRows, 1);
     }
 }
 
@@ -774,77 +933,22 @@ void UnitTypes::restoreBlockSequence (const int delta, void *pData, const size_t
 
 void restoreCrossBytesFloat (const int delta, uint32_t *pData, const size_t nCols, const size_t nRows)
 {
-    uint32_t * row_data = pData;
-
-    if (true)
+    if (delta == 2)
     {
-        if (delta == 2)
-        {
-            for (size_t iCol = 0; iCol < nCols; iCol++)
-            {
-                size_t iShift = nCols;
-
-                for (size_t i = 1; i < nRows; i++)
-                {
-                    row_data [iShift] = ADD32_BIT_FLT (row_data [iShift], row_data [iShift - nCols] );
-
-                    iShift += nCols;
-                }
-
-                row_data += 1;
-            }
-        }
-
-        row_data = pData;
-
-        for (size_t iRow = 0; iRow < nRows; iRow++)
-        {
-            for (size_t i = 1; i < nCols; i++)
-            {
-                row_data [i] = ADD32_BIT_FLT (row_data [i], row_data [i - 1] );
-            }
-
-            row_data += nCols;
-        }
+        prefixSumCols<FltFields> (pData, nCols, nRows);
     }
 
+    prefixSumRows<FltFields> (pData, nCols, nRows, 1);
 }
 
 void restoreCrossBytesDouble (const int delta, uint64_t *pData, const size_t nCols, const size_t nRows)
 {
-    uint64_t * row_data = pData;
-
-    if (true)
+    if (delta == 2)
     {
-        if (delta == 2)
-        {
-            for (size_t col = 0; col < nCols; col++)
-            {
-                size_t iShift = nCols;
-
-                for (size_t i = 1; i < nRows; i++)
-                {
-                    row_data [iShift] = ADD64_BIT_DBL (row_data [iShift], row_data [iShift - nCols] );
-
-                    iShift += nCols;
-                }
-
-                row_data += 1;
-            }
-        }
-
-        row_data = pData;
-
-        for (size_t iRow = 0; iRow < nRows; iRow++)
-        {
-            for (size_t i = 1; i < nCols; i++)
-            {
-                row_data [i] = ADD64_BIT_DBL (row_data [i], row_data [i - 1] );
-            }
-
-            row_data += nCols;
-        }
+        prefixSumCols<DblFields> (pData, nCols, nRows);
     }
+
+    prefixSumRows<DblFields> (pData, nCols, nRows, 1);
 }
 
 
@@ -55,6 +55,18 @@ struct UnitTypes
 
     static void doFloatTransform(uint32_t* pData, const size_t iCnt);
     static void undoFloatTransform(uint32_t* pData, const size_t iCnt);
+
+    // same, out of place, so the transform happens in the same pass as the copy. pSrc == pDst is ok.
+    static void doFloatTransform(const uint32_t* pSrc, uint32_t* pDst, const size_t iCnt);
+    static void undoFloatTransform(const uint32_t* pSrc, uint32_t* pDst, const size_t iCnt);
+
+    // BYTE PLANES:
+
+    // byte transpose of iCnt units of unit_size (4 or 8) bytes each;
+    // ppPlanes[k] holds iCnt bytes, byte k of each unit, in the same order as the units.
+
+    static void gatherBytePlanes (const uint8_t* pData, const size_t iCnt, const size_t unit_size, uint8_t* const* ppPlanes);
+    static void scatterBytePlanes (const uint8_t* const* ppPlanes, const size_t iCnt, const size_t unit_size, uint8_t* pData);
 } ;
 
 NAMESPACE_LERC_END
@@ -187,6 +187,52 @@ extern "C" {
       unsigned int* nBytesWritten);      // number of bytes written to output buffer
 
 
+  //! Upper bound of the Lerc blob size for any data, mask, and maxZErr of the given data type and dimensions.
+  //! Cheap, it only uses the dimensions. An output buffer of this size never makes lerc_encode() or any other
+  //! encode function fail with BufferTooSmall, so you can allocate it and encode in one pass, without calling
+  //! lerc_computeCompressedSize() first. It is about the raw data size plus some header and mask bytes per band.
+
+  LERCDLL_API
+    lerc_status lerc_compressBound(
+      unsigned int dataType,             // char = 0, uchar = 1, short = 2, ushort = 3, int = 4, uint = 5, float = 6, double = 7
+      int nDepth,                        // number of values per pixel (e.g., 3 for RGB, data is stored as [RGB, RGB, ...])
+      int nCols,                         // number of columns
+      int nRows,                         // number of rows
+      int nBands,                        // number of bands (e.g., 3 for [RRRR ..., GGGG ..., BBBB ...])
+      unsigned int* numBytes);           // max size of outgoing Lerc blob
+
+  //! Encode into an output buffer that the function grows as needed, using the realloc style callback passed.
+  //! The buffer passed in (or nullptr) is grown to lerc_compressBound() if it is smaller, then the data is encoded
+  //! in one pass. The buffer is not shrunk afterwards, so it can be reused for the next tile; realloc it to
+  //! nBytesWritten yourself if you want to keep the blob only. The buffer belongs to the caller, also if the
+  //! function fails. If pfnRealloc is nullptr, realloc() of the C runtime the Lerc lib is linked to is used.
+  //! Data, masks, and the optional noData arrays are as for lerc_encode_4D() below.
+
+  typedef unsigned char* (*lerc_realloc_func)(
+      void* pContext,                    // passed through
+      unsigned char* pBuffer,            // buffer to grow, or nullptr
+      unsigned int newSize);             // new size in bytes, return nullptr on failure and leave pBuffer as is
+
+  LERCDLL_API
+    lerc_status lerc_encodeRealloc(
+      const void* pData,                 // raw image data, row by row, band by band
+      unsigned int dataType,             // char = 0, uchar = 1, short = 2, ushort = 3, int = 4, uint = 5, float = 6, double = 7
+      int nDepth,                        // number of values per pixel (e.g., 3 for RGB, data is stored as [RGB, RGB, ...])
+      int nCols,                         // number of columns
+      int nRows,                         // number of rows
+      int nBands,                        // number of bands (e.g., 3 for [RRRR ..., GGGG ..., BBBB ...])
+      int nMasks,                        // 0 - all valid, 1 - same mask for all bands, nBands - masks can differ between bands
+      const unsigned char* pValidBytes,  // nullptr if all pixels are valid; otherwise 1 byte per pixel (1 = valid, 0 = invalid)
+      double maxZErr,                    // max coding error per pixel, defines the precision
+      lerc_realloc_func pfnRealloc,      // grows the output buffer, or nullptr for realloc()
+      void* pContext,                    // passed to pfnRealloc
+      unsigned char** ppOutBuffer,       // in: buffer to write to, or nullptr; out: buffer written to, maybe moved
+      unsigned int* outBufferSize,       // in: size of *ppOutBuffer; out: its size after growing, if it had to
+      unsigned int* nBytesWritten,       // number of bytes written to output buffer
+      const unsigned char* pUsesNoData,  // nullptr, or nBands flags, 1 - band uses noData value, 0 - not
+      const double* noDataValues);       // nullptr, or nBands noData values
+
+
   //! Call this to get info about the compressed Lerc blob. Optional.
   //! Info returned in infoArray is
   //! { version, dataType, nDepth, nCols, nRows, nBands, nValidPixels, blobSize, nMasks, nDepth, nUsesNoDataValue }, see Lerc_types.h .
@@ -380,6 +426,136 @@ extern "C" {
       double* noDataValues);             // same, pass an array of size nBands to get the noData value per band, if any
 
 
+  //! Encode functions with options:
+  //!
+  //! Same as the _4D encode functions above, plus optional encoder tuning for this call only. 
+  //! See EncodeOptionsArrOrder in Lerc_types.h for the array layout and the defaults. 
+  //! Only the first optionsArraySize options are set, the others keep their defaults. 
+  //! Pass the same options to both functions, so the size computed fits the blob encoded. 
+  //! If an option is out of range, the function fails with WrongParam. 
+  //! If dropNoisyBitPlanes is set, the encoder can raise maxZErr for int types, lerc_getBlobInfo() returns the one used. 
+
+  LERCDLL_API
+    lerc_status lerc_computeCompressedSizeEx(
+      const void* pData,                 // raw image data, row by row, band by band
+      unsigned int dataType,             // char = 0, uchar = 1, short = 2, ushort = 3, int = 4, uint = 5, float = 6, double = 7
+      int nDepth,                        // number of values per pixel (e.g., 3 for RGB, data is stored as [RGB, RGB, ...])
+      int nCols,                         // number of columns
+      int nRows,                         // number of rows
+      int nBands,                        // number of bands (e.g., 3 for [RRRR ..., GGGG ..., BBBB ...])
+      int nMasks,                        // 0 - all valid, 1 - same mask for all bands, nBands - masks can differ between bands
+      const unsigned char* pValidBytes,  // nullptr if all pixels are valid; otherwise 1 byte per pixel (1 = valid, 0 = invalid)
+      double maxZErr,                    // max coding error per pixel, defines the precision
+      unsigned int* numBytes,            // size of outgoing Lerc blob
+      const unsigned char* pUsesNoData,  // if there are invalid values not marked by the mask, pass an array of size nBands, 1 - uses noData, 0 - not
+      const double* noDataValues,        // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const int* optionsArray,           // see EncodeOptionsArrOrder in Lerc_types.h, or nullptr for the defaults
+      int optionsArraySize);             // number of elements of optionsArray
+
+  LERCDLL_API
+    lerc_status lerc_encodeEx(
+      const void* pData,                 // raw image data, row by row, band by band
+      unsigned int dataType,             // char = 0, uchar = 1, short = 2, ushort = 3, int = 4, uint = 5, float = 6, double = 7
+      int nDepth,                        // number of values per pixel (e.g., 3 for RGB, data is stored as [RGB, RGB, ...])
+      int nCols,                         // number of columns
+      int nRows,                         // number of rows
+      int nBands,                        // number of bands (e.g., 3 for [RRRR ..., GGGG ..., BBBB ...])
+      int nMasks,                        // 0 - all valid, 1 - same mask for all bands, nBands - masks can differ between bands
+      const unsigned char* pValidBytes,  // nullptr if all pixels are valid; otherwise 1 byte per pixel (1 = valid, 0 = invalid)
+      double maxZErr,                    // max coding error per pixel, defines the precision
+      unsigned char* pOutBuffer,         // buffer to write to, function fails if buffer too small
+      unsigned int outBufferSize,        // size of output buffer
+      unsigned int* nBytesWritten,       // number of bytes written to output buffer
+      const unsigned char* pUsesNoData,  // if there are invalid values not marked by the mask, pass an array of size nBands, 1 - uses noData, 0 - not
+      const double* noDataValues,        // same, pass an array of size nBands with noData value per band, or pass nullptr
+      const int* optionsArray,           // see EncodeOptionsArrOrder in Lerc_types.h, or nullptr for the defaults
+      int optionsArraySize);             // number of elements of optionsArray
+
+
+  //! Batch functions:
+  //!
+  //! Encode or decode many tiles of the same data type and size in one call, such as all tiles of one
+  //! tile server request. These are a convenience loop over lerc_encode_4D() or lerc_decode_4D(), one call
+  //! per tile, spread over up to nThreads threads (0 - as many as there are cores, 1 - all on the calling thread).
+  //! No codec state is shared between the tiles, so the per tile cost is the same as for single calls.
+  //! Each tile gets its own status and size. The return value is ok if all tiles are ok, else WrongParam for
+  //! wrong arguments, or the status of the first tile that failed.
+  //! lerc_decodeBatch() reads the header of each blob first. A blob of another data type, nDepth, nCols, nRows,
+  //! or nBands than passed, or with more masks than nMasks, fails with status Failed and is not decoded.
+  //! If stats are enabled, lerc_getLastStats() afterwards returns the sum over all tiles, with msTotal the time
+  //! of the whole batch, and imageEncodeMode and microBlockSize of the last tile.
+
+  LERCDLL_API
+    lerc_status lerc_encodeBatch(
+      int nTiles,                        // number of tiles
+      const void* const* ppData,         // nTiles pointers to raw image data, row by row, band by band
+      unsigned int dataType,             // char = 0, uchar = 1, short = 2, ushort = 3, int = 4, uint = 5, float = 6, double = 7
+      int nDepth,                        // number of values per pixel (e.g., 3 for RGB, data is stored as [RGB, RGB, ...])
+      int nCols,                         // number of columns
+      int nRows,                         // number of rows
+      int nBands,                        // number of bands (e.g., 3 for [RRRR ..., GGGG ..., BBBB ...])
+      int nMasks,                        // 0 - all valid, 1 - same mask for all bands, nBands - masks can differ between bands
+      const unsigned char* const* ppValidBytes,  // nullptr if all valid; otherwise nTiles pointers to masks as for lerc_encode()
+      double maxZErr,                    // max coding error per pixel, defines the precision
+      unsigned char* const* ppOutBuffers,  // nTiles buffers to write to
+      const unsigned int* outBufferSizes,  // nTiles sizes of the output buffers
+      unsigned int* nBytesWritten,       // nTiles, number of bytes written per tile
+      const unsigned char* const* ppUsesNoData,  // nullptr, or nTiles pointers to pUsesNoData as for lerc_encode_4D() (nullptr for a tile is ok)
+      const double* const* ppNoDataValues,  // nullptr, or nTiles pointers to noDataValues as for lerc_encode_4D()
+      lerc_status* tileStatus,           // nTiles, status per tile, or nullptr
+      int nThreads);                     // max number of threads, 0 - no limit
+
+  LERCDLL_API
+    lerc_status lerc_decodeBatch(
+      int nTiles,                        // number of tiles
+      const unsigned char* const* ppLercBlobs,  // nTiles Lerc blobs to decode
+      const unsigned int* blobSizes,     // nTiles blob sizes in bytes
+      int nMasks,                        // 0, 1, or nBands; return as many masks in the next array
+      unsigned char* const* ppValidBytes,  // nullptr, or nTiles pointers to masks as for lerc_decode() (nullptr for a tile is ok)
+      int nDepth,                        // number of values per pixel (e.g., 3 for RGB, data is stored as [RGB, RGB, ...])
+      int nCols,                         // number of columns
+      int nRows,                         // number of rows
+      int nBands,                        // number of bands (e.g., 3 for [RRRR ..., GGGG ..., BBBB ...])
+      unsigned int dataType,             // char = 0, uchar = 1, short = 2, ushort = 3, int = 4, uint = 5, float = 6, double = 7
+      void* const* ppData,               // nTiles outgoing data arrays
+      unsigned char* const* ppUsesNoData,  // nullptr, or nTiles pointers to pUsesNoData as for lerc_decode_4D() (nullptr for a tile is ok)
+      double* const* ppNoDataValues,     // nullptr, or nTiles pointers to noDataValues as for lerc_decode_4D()
+      lerc_status* tileStatus,           // nTiles, status per tile, or nullptr
+      int nThreads);                     // max number of threads, 0 - no limit
+
+
+  //! Threads:
+  //!
+  //! Large lossless float or double blobs can be encoded and decoded on more than one thread, such as
+  //! one per byte plane. Off by default, all on the calling thread. The worker threads are started on first
+  //! use and kept for the next calls, until lerc_setNumThreads(1), exit, or unloading the lib stops them.
+  //! Only one call at a time gets them, others run on their calling thread.
+  //! Does not apply to the batch functions above, which take their own nThreads.
+
+  LERCDLL_API
+    lerc_status lerc_setNumThreads(
+      int nThreads);                     // max number of threads per call, 1 - calling thread only (default), 0 - as many as there are cores
+
+
+  //! Per stage timing and counters, to find out where the encode or decode time goes. Optional.
+  //!
+  //! Off by default. If turned on, each encode, compute size, or decode call collects time in ms and bytes
+  //! per stage, number of tiles per block encode mode, the image encode mode and micro block size chosen,
+  //! and the number of WriteTiles() passes, see StatsArrOrder in Lerc_types.h .
+  //! The stats are kept per calling thread. lerc_getLastStats() returns the ones of the last call on the same thread.
+  //! Bytes, tile counts, and modes are of the data written or read, so they stay 0 for lerc_computeCompressedSize().
+  //! Same as for lerc_getBlobInfo(), the stats array is filled only up to its allocated size.
+
+  LERCDLL_API
+    lerc_status lerc_enableStats(
+      int enable);                       // 1 - collect stats, 0 - don't (default)
+
+  LERCDLL_API
+    lerc_status lerc_getLastStats(
+      double* statsArray,                // outgoing stats, see StatsArrOrder in Lerc_types.h
+      int statsArraySize);               // number of elements of statsArray
+
+
 #ifdef __cplusplus
 }
 #endif
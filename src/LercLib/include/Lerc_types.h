@@ -55,5 +55,42 @@ namespace LercNS
     _last
   };
 
+  enum class EncodeOptionsArrOrder : int
+  {
+    dropNoisyBitPlanes = 0,  // int types only: 1 - drop the noisy low bit planes, can raise maxZErr, 0 - don't (default)
+    bitPlaneRowStep,    // for dropNoisyBitPlanes: run the bit plane noise test on every n-th row only, 1 - all rows (default)
+    microBlockSizeSearch,    // 1 - try micro block size 8, 16, and 32, take the one with the smallest blob, 0 - don't (default)
+    _last
+  };
+
+  enum class StatsArrOrder : int
+  {
+    msTotal = 0,    // time in ms of the last encode or decode call
+    msCheckForNaN,
+    msFilterNoData,    // FilterNoData() or FilterNoDataAndNaN()
+    msTryRaiseMaxZError,    // float types, lossy
+    msTryBitPlaneCompression,    // int types, option dropNoisyBitPlanes
+    msComputeMinMaxRanges,    // incl the per tile stats they are taken from
+    msMask,    // RLE compress or decompress the mask
+    msTiles,    // all WriteTiles() passes, or ReadTiles()
+    msHuffman,    // int types, Huffman codes and encode, or decode
+    msFpl,    // float types lossless, byte planes encode or decode
+    bytesHeader,    // bytes written or read, header, min max ranges, and flags
+    bytesMask,
+    bytesTiles,
+    bytesHuffman,
+    bytesFpl,
+    bytesOneSweep,    // data stored uncompressed
+    numTilesRawBinary,    // tiles written or read, per depth, by block encode mode
+    numTilesBitStuffSimple,
+    numTilesBitStuffLUT,
+    numTilesConst,    // const or all invalid, no data stored
+    numWriteTilesPasses,    // incl the passes that only count bytes
+    imageEncodeMode,    // of the last band: 0 - tiling, 1 - delta Huffman, 2 - Huffman, 3 - fp byte planes, -1 - one sweep, -2 - const
+    microBlockSize,    // of the last band, if tiling
+    nBands,    // Lerc2 bands written or read
+    _last
+  };
+
 }    // namespace
 
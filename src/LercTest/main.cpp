@@ -599,6 +599,364 @@ int main(int argc, char* arcv[])
     delete[] pLercBlob;
   }
 
+  //---------------------------------------------------------------------------
+
+  // Sample 5: int image with noisy low bits, maxZError = 0.5 (lossless), but with the option to drop the noisy bit planes,
+  // bit plane test on all rows, then on every 4th row only, then without options
+
+  {
+    int h = 512;
+    int w = 512;
+
+    int* iImg = new int[w * h];
+    int* iImg2 = new int[w * h];
+
+    for (int k = 0, i = 0; i < h; i++)
+      for (int j = 0; j < w; j++, k++)
+        iImg[k] = 16 * (i + 2 * j) + rand() % 16;    // smooth surface plus 4 bits of noise
+
+    const int nOptions = (int)LercNS::EncodeOptionsArrOrder::_last;
+    int options[nOptions] = { 1, 0, 0 };    // row step out of range, must fail
+
+    uint32 numBytesBlob = 0;
+    if (lerc_computeCompressedSizeEx((void*)iImg, (uint32)dt_int, 1, w, h, 1, 0, nullptr, 0.5, &numBytesBlob,
+      nullptr, nullptr, options, nOptions) != (lerc_status)LercNS::ErrCode::WrongParam)
+    {
+      Failed("lerc_computeCompressedSizeEx(...)", cntFailures);
+    }
+
+    if ((hr = lerc_computeCompressedSize((void*)iImg, (uint32)dt_int, 1, w, h, 1, 0, nullptr, 0.5, &numBytesBlob)))
+      Failed("lerc_computeCompressedSize(...)", cntFailures);
+
+    Byte* pLercBlob = new Byte[numBytesBlob];
+
+    for (int rowStep : { 1, 4, 0 })
+    {
+      options[(int)LercNS::EncodeOptionsArrOrder::bitPlaneRowStep] = rowStep;
+      int nOpt = rowStep > 0 ? nOptions : 0;    // 0 - no options, encode lossless
+
+      uint32 numBytesNeeded = 0;
+      if ((hr = lerc_computeCompressedSizeEx((void*)iImg, (uint32)dt_int, 1, w, h, 1, 0, nullptr, 0.5, &numBytesNeeded,
+        nullptr, nullptr, options, nOpt)))
+      {
+        Failed("lerc_computeCompressedSizeEx(...)", cntFailures);
+      }
+
+      uint32 numBytesWritten = 0;
+      if ((hr = lerc_encodeEx((void*)iImg, (uint32)dt_int, 1, w, h, 1, 0, nullptr, 0.5, pLercBlob, numBytesBlob, &numBytesWritten,
+        nullptr, nullptr, options, nOpt)))
+      {
+        Failed("lerc_encodeEx(...)", cntFailures);
+      }
+
+      if ((hr = lerc_getBlobInfo(pLercBlob, numBytesWritten, infoArr, dataRangeArr, infoArrSize, dataRangeArrSize)))
+        Failed("lerc_getBlobInfo(...)", cntFailures);
+
+      double maxZErrUsed = dataRangeArr[(int)LercNS::DataRangeArrOrder::maxZErrUsed];
+
+      if ((hr = lerc_decode(pLercBlob, numBytesWritten, 0, nullptr, 1, w, h, 1, (uint32)dt_int, (void*)iImg2)))
+        Failed("lerc_decode(...)", cntFailures);
+
+      int maxDelta = 0;
+      for (int k = 0; k < w * h; k++)
+        maxDelta = max(maxDelta, abs(iImg2[k] - iImg[k]));
+
+      std::cout << "sample 5 row step = " << rowStep << ", compression ratio = " << 4 * w * h / (double)numBytesWritten
+        << ", max z error used = " << maxZErrUsed << ", max z error per pixel = " << maxDelta << endl;
+
+      if (numBytesNeeded != numBytesWritten
+        || (nOpt > 0 && maxZErrUsed < 1)    // should have dropped some noisy bit planes
+        || (nOpt == 0 && maxZErrUsed != 0.5)    // options are per call, this one is lossless
+        || maxDelta > maxZErrUsed)
+      {
+        std::cout << "Error: bit plane compression failed!" << endl;
+        cntFailures++;
+      }
+    }
+    std::cout << endl;
+
+    delete[] iImg;
+    delete[] iImg2;
+    delete[] pLercBlob;
+  }
+
+  //---------------------------------------------------------------------------
+
+  // Sample 6: float image, maxZError = 0.1, encode without and with micro block size search,
+  // the search must not make the blob larger
+
+  {
+    int h = 600;
+    int w = 400;
+
+    float* fImg = new float[w * h];
+    float* fImg2 = new float[w * h];
+
+    for (int k = 0, i = 0; i < h; i++)
+      for (int j = 0; j < w; j++, k++)
+        fImg[k] = (float)(10 * sin(0.003 * i) + 0.06 * ((i * 7 + j * 13) % 5));    // smooth surface plus a small pattern
+
+    double maxZErrorWanted = 0.1;
+    double eps = 0.0001;    // safety margin, as in sample 1
+    double maxZError = maxZErrorWanted - eps;
+
+    uint32 numBytesBlob = 0;
+    if ((hr = lerc_computeCompressedSize((void*)fImg, (uint32)dt_float, 1, w, h, 1, 0, nullptr, maxZError, &numBytesBlob)))
+      Failed("lerc_computeCompressedSize(...)", cntFailures);
+
+    Byte* pLercBlob = new Byte[numBytesBlob];
+    const int nOptions = (int)LercNS::EncodeOptionsArrOrder::_last;
+    int options[nOptions] = { 0, 1, 0 };    // dropNoisyBitPlanes, bitPlaneRowStep, microBlockSizeSearch
+    uint32 numBytesNoSearch = 0;
+
+    for (int search : { 0, 1 })
+    {
+      options[(int)LercNS::EncodeOptionsArrOrder::microBlockSizeSearch] = search;
+
+      uint32 numBytesNeeded = 0, numBytesWritten = 0;
+      if ((hr = lerc_computeCompressedSizeEx((void*)fImg, (uint32)dt_float, 1, w, h, 1, 0, nullptr, maxZError, &numBytesNeeded,
+        nullptr, nullptr, options, nOptions)))
+      {
+        Failed("lerc_computeCompressedSizeEx(...)", cntFailures);
+      }
+
+      if ((hr = lerc_encodeEx((void*)fImg, (uint32)dt_float, 1, w, h, 1, 0, nullptr, maxZError, pLercBlob, numBytesBlob, &numBytesWritten,
+        nullptr, nullptr, options, nOptions)))
+      {
+        Failed("lerc_encodeEx(...)", cntFailures);
+      }
+
+      if ((hr = lerc_decode(pLercBlob, numBytesWritten, 0, nullptr, 1, w, h, 1, (uint32)dt_float, (void*)fImg2)))
+        Failed("lerc_decode(...)", cntFailures);
+
+      double maxDelta = 0;
+      for (int k = 0; k < w * h; k++)
+        maxDelta = max(maxDelta, fabs((double)fImg2[k] - (double)fImg[k]));
+
+      std::cout << "sample 6 search = " << search << ", compression ratio = " << 4 * w * h / (double)numBytesWritten
+        << ", max z error per pixel = " << maxDelta << endl;
+
+      if (!search)
+        numBytesNoSearch = numBytesWritten;
+
+      if (numBytesWritten != numBytesNeeded || maxDelta > maxZErrorWanted || numBytesWritten > numBytesNoSearch)
+      {
+        std::cout << "Error: micro block size search failed!" << endl;
+        cntFailures++;
+      }
+    }
+    std::cout << endl;
+
+    delete[] fImg;
+    delete[] fImg2;
+    delete[] pLercBlob;
+  }
+
+  //---------------------------------------------------------------------------
+
+  // Sample 7: float image, maxZError = 0 (lossless), encode and decode on the calling thread only (default),
+  // then on 4 threads and on all cores, then again after the threads were released, the blob must not change
+
+  {
+    int h = 512;
+    int w = 512;
+
+    float* fImg = new float[w * h];
+    float* fImg2 = new float[w * h];
+
+    for (int k = 0, i = 0; i < h; i++)
+      for (int j = 0; j < w; j++, k++)
+        fImg[k] = (float)(100 * sin(0.01 * i) * cos(0.02 * j)) + (rand() % 1000) / 1000.0f;    // smooth surface plus noise
+
+    uint32 numBytesBlob = 0;
+    if ((hr = lerc_computeCompressedSize((void*)fImg, (uint32)dt_float, 1, w, h, 1, 0, nullptr, 0, &numBytesBlob)))
+      Failed("lerc_computeCompressedSize(...)", cntFailures);
+
+    if (lerc_setNumThreads(-1) != (lerc_status)LercNS::ErrCode::WrongParam)
+      Failed("lerc_setNumThreads(...)", cntFailures);
+
+    Byte* pLercBlob = new Byte[numBytesBlob];
+    Byte* pLercBlob1 = new Byte[numBytesBlob];
+    uint32 numBytesWritten1 = 0;
+
+    for (int nThreads : { 1, 4, 0, 1, 0 })
+    {
+      if ((hr = lerc_setNumThreads(nThreads)))
+        Failed("lerc_setNumThreads(...)", cntFailures);
+
+      Byte* pBlob = nThreads == 1 ? pLercBlob1 : pLercBlob;
+      uint32 numBytesWritten = 0;
+      if ((hr = lerc_encode((void*)fImg, (uint32)dt_float, 1, w, h, 1, 0, nullptr, 0, pBlob, numBytesBlob, &numBytesWritten)))
+        Failed("lerc_encode(...)", cntFailures);
+
+      if (nThreads == 1)
+        numBytesWritten1 = numBytesWritten;
+
+      memset(fImg2, 0, w * h * sizeof(float));
+      if ((hr = lerc_decode(pBlob, numBytesWritten, 0, nullptr, 1, w, h, 1, (uint32)dt_float, (void*)fImg2)))
+        Failed("lerc_decode(...)", cntFailures);
+
+      std::cout << "sample 7 num threads = " << nThreads << ", compression ratio = " << 4 * w * h / (double)numBytesWritten << endl;
+
+      if (numBytesWritten != numBytesWritten1 || memcmp(pBlob, pLercBlob1, numBytesWritten) != 0
+        || memcmp(fImg, fImg2, w * h * sizeof(float)) != 0)
+      {
+        std::cout << "Error: encode or decode on threads differs!" << endl;
+        cntFailures++;
+      }
+    }
+    std::cout << endl;
+
+    lerc_setNumThreads(1);
+
+    delete[] fImg;
+    delete[] fImg2;
+    delete[] pLercBlob;
+    delete[] pLercBlob1;
+  }
+
+  //---------------------------------------------------------------------------
+
+  // Sample 8: int image, maxZError = 1, decode with stats on the calling thread only, then on all cores,
+  // the tile counts must not change
+
+  {
+    int h = 1024;
+    int w = 512;
+
+    int* iImg = new int[w * h];
+    int* iImg2 = new int[w * h];
+
+    for (int k = 0, i = 0; i < h; i++)
+      for (int j = 0; j < w; j++, k++)
+        iImg[k] = (i * j) % 1000 + rand() % 50;
+
+    uint32 numBytesBlob = 0;
+    if ((hr = lerc_computeCompressedSize((void*)iImg, (uint32)dt_int, 1, w, h, 1, 0, nullptr, 1, &numBytesBlob)))
+      Failed("lerc_computeCompressedSize(...)", cntFailures);
+
+    Byte* pLercBlob = new Byte[numBytesBlob];
+    uint32 numBytesWritten = 0;
+    if ((hr = lerc_encode((void*)iImg, (uint32)dt_int, 1, w, h, 1, 0, nullptr, 1, pLercBlob, numBytesBlob, &numBytesWritten)))
+      Failed("lerc_encode(...)", cntFailures);
+
+    lerc_enableStats(1);
+
+    const int nStats = (int)LercNS::StatsArrOrder::_last;
+    double statsArr[nStats], statsArr1[nStats];
+
+    for (int nThreads : { 1, 0 })
+    {
+      lerc_setNumThreads(nThreads);
+
+      if ((hr = lerc_decode(pLercBlob, numBytesWritten, 0, nullptr, 1, w, h, 1, (uint32)dt_int, (void*)iImg2)))
+        Failed("lerc_decode(...)", cntFailures);
+
+      if ((hr = lerc_getLastStats(nThreads == 1 ? statsArr1 : statsArr, nStats)))
+        Failed("lerc_getLastStats(...)", cntFailures);
+    }
+
+    lerc_setNumThreads(1);
+    lerc_enableStats(0);
+
+    double numTiles = 0;
+    bool bCountsEqual = true;
+    for (LercNS::StatsArrOrder item : { LercNS::StatsArrOrder::numTilesRawBinary, LercNS::StatsArrOrder::numTilesBitStuffSimple,
+      LercNS::StatsArrOrder::numTilesBitStuffLUT, LercNS::StatsArrOrder::numTilesConst })
+    {
+      numTiles += statsArr[(int)item];
+      bCountsEqual = bCountsEqual && statsArr[(int)item] == statsArr1[(int)item];
+    }
+
+    int mbSize = (int)statsArr[(int)LercNS::StatsArrOrder::microBlockSize];
+    std::cout << "sample 8 num tiles = " << numTiles << ", micro block size = " << mbSize << endl << endl;
+
+    if (!bCountsEqual || mbSize <= 0 || numTiles != (double)((w + mbSize - 1) / mbSize) * ((h + mbSize - 1) / mbSize))
+    {
+      std::cout << "Error: tile counts of the decode on threads are wrong!" << endl;
+      cntFailures++;
+    }
+
+    delete[] iImg;
+    delete[] iImg2;
+    delete[] pLercBlob;
+  }
+
+  // Sample 9: many small float tiles of nDepth = 2 with a noData value, encode and decode in one batch call each,
+  // on all cores, with stats; the stats must add up over all tiles
+
+  {
+    const int nTiles = 16, nDepth = 2, w = 64, h = 64, nValues = nDepth * w * h;
+    const double noData = -9999;
+
+    std::vector<float> dataVec(nTiles * nValues), dataVec2(nTiles * nValues, 0);
+    std::vector<Byte> blobVec(nTiles * nValues * sizeof(float) * 2);
+    std::vector<const void*> dataPtrs(nTiles);
+    std::vector<void*> dataPtrs2(nTiles);
+    std::vector<Byte*> blobPtrs(nTiles);
+    std::vector<uint32> blobSizes(nTiles, nValues * sizeof(float) * 2), numBytesWritten(nTiles, 0);
+    std::vector<Byte> usesNoData(nTiles, 1), usesNoData2(nTiles, 0);
+    std::vector<double> noDataVec2(nTiles, 0);
+    std::vector<const Byte*> usesNoDataPtrs(nTiles);
+    std::vector<Byte*> usesNoDataPtrs2(nTiles);
+    std::vector<const double*> noDataPtrs(nTiles, &noData);
+    std::vector<double*> noDataPtrs2(nTiles);
+    std::vector<lerc_status> tileStatus(nTiles, 1);
+
+    for (int t = 0; t < nTiles; t++)
+    {
+      float* p = &dataVec[t * nValues];
+      for (int k = 0; k < w * h; k++)
+      {
+        p[k * nDepth] = (float)(t * 100 + k % 77);
+        p[k * nDepth + 1] = (k % 13 == 0) ? (float)noData : (float)(k % 55);    // valid pixels with some noData values
+      }
+
+      dataPtrs[t] = p;
+      dataPtrs2[t] = &dataVec2[t * nValues];
+      blobPtrs[t] = &blobVec[t * blobSizes[t]];
+      usesNoDataPtrs[t] = &usesNoData[t];
+      usesNoDataPtrs2[t] = &usesNoData2[t];
+      noDataPtrs2[t] = &noDataVec2[t];
+    }
+
+    lerc_enableStats(1);
+
+    if ((hr = lerc_encodeBatch(nTiles, dataPtrs.data(), (uint32)dt_float, nDepth, w, h, 1, 0, nullptr, 0, blobPtrs.data(),
+      blobSizes.data(), numBytesWritten.data(), usesNoDataPtrs.data(), noDataPtrs.data(), tileStatus.data(), 0)))
+      Failed("lerc_encodeBatch(...)", cntFailures);
+
+    const int nStats = (int)LercNS::StatsArrOrder::_last;
+    double statsArr[nStats];
+    if ((hr = lerc_getLastStats(statsArr, nStats)))
+      Failed("lerc_getLastStats(...)", cntFailures);
+
+    double nBandsEncoded = statsArr[(int)LercNS::StatsArrOrder::nBands];
+
+    std::vector<const Byte*> blobPtrsConst(blobPtrs.begin(), blobPtrs.end());
+    if ((hr = lerc_decodeBatch(nTiles, blobPtrsConst.data(), numBytesWritten.data(), 0, nullptr, nDepth, w, h, 1, (uint32)dt_float,
+      dataPtrs2.data(), usesNoDataPtrs2.data(), noDataPtrs2.data(), tileStatus.data(), 0)))
+      Failed("lerc_decodeBatch(...)", cntFailures);
+
+    if ((hr = lerc_getLastStats(statsArr, nStats)))
+      Failed("lerc_getLastStats(...)", cntFailures);
+
+    lerc_enableStats(0);
+
+    double nBandsDecoded = statsArr[(int)LercNS::StatsArrOrder::nBands];
+    std::cout << "sample 9 num tiles = " << nTiles << ", bands encoded = " << nBandsEncoded << ", bands decoded = " << nBandsDecoded << endl << endl;
+
+    bool bNoDataOk = true;
+    for (int t = 0; t < nTiles; t++)
+      bNoDataOk = bNoDataOk && usesNoData2[t] == 1 && noDataVec2[t] == noData;
+
+    if (dataVec != dataVec2 || !bNoDataOk || nBandsEncoded != nTiles || nBandsDecoded != nTiles)
+    {
+      std::cout << "Error: batch encode or decode with noData is wrong!" << endl;
+      cntFailures++;
+    }
+  }
+
   //---------------------------------------------------------------------------
   //---------------------------------------------------------------------------
 